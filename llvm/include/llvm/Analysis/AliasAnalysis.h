@@ -58,6 +58,7 @@ namespace llvm {
 class AnalysisUsage;
 class BasicAAResult;
 class BasicBlock;
+class CaptureInfo;
 class DominatorTree;
 class OrderedBasicBlock;
 class Value;
@@ -302,8 +303,11 @@ public:
 
   using IsCapturedCacheT = SmallDenseMap<const Value *, bool, 8>;
   IsCapturedCacheT IsCapturedCache;
+  /// Same as IsCapturedCache, but with stores into non-escaping local memory
+  /// looked through.
+  IsCapturedCacheT IsStoreCapturedCache;
 
-  AAQueryInfo() : AliasCache(), IsCapturedCache() {}
+  AAQueryInfo() : AliasCache(), IsCapturedCache(), IsStoreCapturedCache() {}
 };
 
 class BatchAAResults;
@@ -331,6 +335,9 @@ public:
   /// analyses become invalid.
   void addAADependencyID(AnalysisKey *ID) { AADeps.push_back(ID); }
 
+  /// Answer callCapturesBefore from the capture points cached in \p CI.
+  void setCaptureInfo(CaptureInfo *CI) { CapInfo = CI; }
+
   /// Handle invalidation events in the new pass manager.
   ///
   /// The aggregation is invalidated if any of the underlying analyses is
@@ -765,6 +772,8 @@ private:
 
   std::vector<AnalysisKey *> AADeps;
 
+  CaptureInfo *CapInfo = nullptr;
+
   friend class BatchAAResults;
 };
 
@@ -1110,12 +1119,7 @@ public:
     ResultGetters.push_back(&getModuleAAResultImpl<AnalysisT>);
   }
 
-  Result run(Function &F, FunctionAnalysisManager &AM) {
-    Result R(AM.getResult<TargetLibraryAnalysis>(F));
-    for (auto &Getter : ResultGetters)
-      (*Getter)(F, AM, R);
-    return R;
-  }
+  Result run(Function &F, FunctionAnalysisManager &AM);
 
 private:
   friend AnalysisInfoMixin<AAManager>;
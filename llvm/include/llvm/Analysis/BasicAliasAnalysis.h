@@ -43,6 +43,7 @@ class PHINode;
 class SelectInst;
 class TargetLibraryInfo;
 class PhiValues;
+class CaptureInfo;
 class Value;
 
 /// This is the AA result object for the basic, local, and stateless alias
@@ -61,21 +62,22 @@ class BasicAAResult : public AAResultBase<BasicAAResult> {
   DominatorTree *DT;
   LoopInfo *LI;
   PhiValues *PV;
+  CaptureInfo *CapInfo;
 
 public:
   BasicAAResult(const DataLayout &DL, const Function &F,
                 const TargetLibraryInfo &TLI, AssumptionCache &AC,
                 DominatorTree *DT = nullptr, LoopInfo *LI = nullptr,
-                PhiValues *PV = nullptr)
-      : AAResultBase(), DL(DL), F(F), TLI(TLI), AC(AC), DT(DT), LI(LI), PV(PV)
-        {}
+                PhiValues *PV = nullptr, CaptureInfo *CapInfo = nullptr)
+      : AAResultBase(), DL(DL), F(F), TLI(TLI), AC(AC), DT(DT), LI(LI), PV(PV),
+        CapInfo(CapInfo) {}
 
   BasicAAResult(const BasicAAResult &Arg)
       : AAResultBase(Arg), DL(Arg.DL), F(Arg.F), TLI(Arg.TLI), AC(Arg.AC),
-        DT(Arg.DT),  LI(Arg.LI), PV(Arg.PV) {}
+        DT(Arg.DT),  LI(Arg.LI), PV(Arg.PV), CapInfo(Arg.CapInfo) {}
   BasicAAResult(BasicAAResult &&Arg)
       : AAResultBase(std::move(Arg)), DL(Arg.DL), F(Arg.F), TLI(Arg.TLI),
-        AC(Arg.AC), DT(Arg.DT), LI(Arg.LI), PV(Arg.PV) {}
+        AC(Arg.AC), DT(Arg.DT), LI(Arg.LI), PV(Arg.PV), CapInfo(Arg.CapInfo) {}
 
   /// Handle invalidation events in the new pass manager.
   bool invalidate(Function &Fn, const PreservedAnalyses &PA,
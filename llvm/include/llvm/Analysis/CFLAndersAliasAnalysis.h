@@ -39,6 +39,7 @@ class CFLAndersAAResult : public AAResultBase<CFLAndersAAResult> {
   friend AAResultBase<CFLAndersAAResult>;
 
   class FunctionInfo;
+  class LazyFunctionInfo;
 
 public:
   explicit CFLAndersAAResult(const TargetLibraryInfo &TLI);
@@ -74,6 +75,9 @@ private:
   /// Build summary for a given function
   FunctionInfo buildInfoFrom(const Function &);
 
+  /// Build the graph of a given function for on-demand queries
+  std::unique_ptr<LazyFunctionInfo> buildLazyInfoFrom(const Function &);
+
   const TargetLibraryInfo &TLI;
 
   /// Cached mapping of Functions to their StratifiedSets.
@@ -83,6 +87,10 @@ private:
   /// that simply has empty sets.
   DenseMap<const Function *, Optional<FunctionInfo>> Cache;
 
+  /// Functions that haven't been scanned yet but have been queried, along with
+  /// the alias pairs computed for those queries.
+  DenseMap<const Function *, std::unique_ptr<LazyFunctionInfo>> LazyCache;
+
   std::forward_list<cflaa::FunctionHandle<CFLAndersAAResult>> Handles;
 };
 
@@ -28,6 +28,7 @@
 namespace llvm {
 
 class Function;
+class Module;
 class TargetLibraryInfo;
 
 namespace cflaa {
@@ -138,6 +139,91 @@ public:
 // alias analysis.
 ImmutablePass *createCFLSteensAAWrapperPass();
 
+/// Whole-module variant of CFLSteensAA.
+///
+/// Rather than summarizing each function and instantiating the summaries at
+/// call sites, this result unifies the sets of every defined function in the
+/// module: at each direct call to a defined function, the actual arguments are
+/// unified with the formals and the call with the callee's returned values.
+/// Internal functions whose callers are all known additionally drop the
+/// caller and argument attributes of their formals, so values flowing through
+/// them stay local. Aggregate formals, such as slices and interfaces, are
+/// unified field by field with the insertvalues that built the actuals. Values
+/// from different functions may be queried.
+///
+/// Values deleted or replaced after the analysis ran, and the values replacing
+/// them, are MayAlias with everything. Other changes to the IR are not seen;
+/// the pass managers drop the result after passes that don't preserve it.
+class CFLSteensModuleAAResult : public AAResultBase<CFLSteensModuleAAResult> {
+  friend AAResultBase<CFLSteensModuleAAResult>;
+
+  class ModuleInfo;
+
+public:
+  CFLSteensModuleAAResult(CFLSteensModuleAAResult &&Arg);
+  ~CFLSteensModuleAAResult();
+
+  static CFLSteensModuleAAResult analyzeModule(Module &M,
+                                               const TargetLibraryInfo &TLI);
+
+  AliasResult query(const MemoryLocation &LocA, const MemoryLocation &LocB);
+
+  AliasResult alias(const MemoryLocation &LocA, const MemoryLocation &LocB,
+                    AAQueryInfo &AAQI) {
+    if (LocA.Ptr == LocB.Ptr)
+      return MustAlias;
+
+    // Comparisons between global variables and other constants should be
+    // handled by BasicAA.
+    if (isa<Constant>(LocA.Ptr) && isa<Constant>(LocB.Ptr))
+      return AAResultBase::alias(LocA, LocB, AAQI);
+
+    AliasResult QueryResult = query(LocA, LocB);
+    if (QueryResult == MayAlias)
+      return AAResultBase::alias(LocA, LocB, AAQI);
+
+    return QueryResult;
+  }
+
+private:
+  explicit CFLSteensModuleAAResult(std::unique_ptr<ModuleInfo> Info);
+
+  std::unique_ptr<ModuleInfo> Info;
+};
+
+/// Analysis pass providing the module-wide CFLSteensAA result.
+class CFLSteensModuleAA : public AnalysisInfoMixin<CFLSteensModuleAA> {
+  friend AnalysisInfoMixin<CFLSteensModuleAA>;
+
+  static AnalysisKey Key;
+
+public:
+  using Result = CFLSteensModuleAAResult;
+
+  CFLSteensModuleAAResult run(Module &M, ModuleAnalysisManager &AM);
+};
+
+/// Legacy wrapper pass to provide the CFLSteensModuleAAResult object.
+class CFLSteensModuleAAWrapperPass : public ModulePass {
+  std::unique_ptr<CFLSteensModuleAAResult> Result;
+
+public:
+  static char ID;
+
+  CFLSteensModuleAAWrapperPass();
+
+  CFLSteensModuleAAResult &getResult() { return *Result; }
+  const CFLSteensModuleAAResult &getResult() const { return *Result; }
+
+  bool runOnModule(Module &M) override;
+  bool doFinalization(Module &M) override;
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+};
+
+// createCFLSteensModuleAAWrapperPass - This pass unifies the points-to sets of
+// all functions in a module.
+ModulePass *createCFLSteensModuleAAWrapperPass();
+
 } // end namespace llvm
 
 #endif // LLVM_ANALYSIS_CFLSTEENSALIASANALYSIS_H
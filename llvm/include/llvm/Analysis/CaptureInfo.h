@@ -0,0 +1,174 @@
+//===- CaptureInfo.h - Cached Capture Information ---------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the CaptureInfo class, and associated passes, which cache
+// the results of capture tracking for the pointers of a function. The uses of
+// each pointer are walked once, recording every instruction that may capture
+// it, and later queries about whether the pointer is captured, or captured
+// before a given instruction, are answered from that record.
+//
+// This information is computed lazily and cached. A cached walk is done again
+// if a use has been added to one of the values it looked at since, or if one
+// of those values or capture points has been deleted or replaced. The pass
+// managers invalidate the whole cache after any pass that does not preserve
+// it. Changing an instruction in place so that an existing use becomes a
+// capture, for example by dropping a nocapture attribute, is not noticed;
+// transforms doing that within a pass have to call invalidateValue.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_CAPTUREINFO_H
+#define LLVM_ANALYSIS_CAPTUREINFO_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PointerIntPair.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+
+class DominatorTree;
+class Function;
+class Instruction;
+class OrderedBasicBlock;
+class Use;
+class Value;
+
+/// Class for calculating and caching the capture points of the pointers of a
+/// function.
+///
+/// Initially the CaptureInfo is empty, and gets incrementally populated
+/// whenever it is queried.
+class CaptureInfo {
+public:
+  /// Construct an empty CaptureInfo.
+  CaptureInfo(const Function &) {}
+
+  /// Return true if the pointer V may be captured by the function, like
+  /// PointerMayBeCaptured. The uses of V are walked once for each value of
+  /// StoreCaptures, and the walk explores up to -capture-info-max-uses uses
+  /// instead of the per-query default, so a pointer with many uses may be
+  /// found not captured where PointerMayBeCaptured gives up.
+  bool isCaptured(const Value *V, bool ReturnCaptures, bool StoreCaptures);
+
+  /// Return true if the pointer V may be captured before instruction I, like
+  /// PointerMayBeCapturedBefore, from the same walk as isCaptured. Each
+  /// capture point is checked on its own. PointerMayBeCapturedBefore also
+  /// skips the captures it can only reach through uses that run after I, so
+  /// apart from the higher use limit this is at least as conservative.
+  bool isCapturedBefore(const Value *V, bool ReturnCaptures,
+                        bool StoreCaptures, const Instruction *I,
+                        const DominatorTree *DT, bool IncludeI = false,
+                        OrderedBasicBlock *OBB = nullptr);
+
+  /// Notify CaptureInfo that the cached information using V is no longer
+  /// valid.
+  ///
+  /// Added uses, and deleted and replaced values, are handled automatically.
+  /// This is only needed when an instruction is changed in place so that one
+  /// of its uses captures a pointer it did not capture before.
+  void invalidateValue(const Value *V);
+
+  /// In the legacy pass manager, only use the cache while \p P, the pass that
+  /// owns it, is still available, that is until a pass that does not preserve
+  /// it has run. Queries made after that fall back to CaptureTracking.
+  void setLegacyPass(const Pass *P) { LegacyPass = P; }
+
+  /// Free the memory used by this class.
+  void releaseMemory();
+
+  /// Handle invalidation events in the new pass manager.
+  bool invalidate(Function &, const PreservedAnalyses &,
+                  FunctionAnalysisManager::Invalidator &);
+
+private:
+  /// Cache key: the pointer and whether stores count as captures.
+  using ObjectKey = PointerIntPair<const Value *, 1, bool>;
+
+  struct ObjectInfo {
+    /// The use walk gave up, so the pointer has to be treated as captured
+    /// everywhere.
+    bool TooManyUses = false;
+    /// The instructions that may capture the pointer, returns included.
+    SmallVector<const Instruction *, 4> CapturePoints;
+    /// The values whose uses the walk looked at, each with the first use it
+    /// saw. A new use goes to the front of the use list, so a different first
+    /// use means the walk has to be done again.
+    SmallVector<std::pair<const Value *, const Use *>, 4> WalkedValues;
+  };
+
+  DenseMap<ObjectKey, ObjectInfo> Objects;
+
+  /// The cached objects whose information depends on each value: those
+  /// captured by it, and those whose walk looked at its uses.
+  DenseMap<const Value *, SmallVector<const Value *, 2>> DependentObjects;
+
+  const Pass *LegacyPass = nullptr;
+
+  /// A CallbackVH to notify CaptureInfo when a value is deleted or replaced,
+  /// so that the cached information for that value can be cleared to avoid
+  /// dangling pointers to invalid values.
+  class CaptureInfoCallbackVH final : public CallbackVH {
+    CaptureInfo *CI;
+    void deleted() override;
+    void allUsesReplacedWith(Value *New) override;
+
+  public:
+    CaptureInfoCallbackVH(Value *V, CaptureInfo *CI = nullptr)
+        : CallbackVH(V), CI(CI) {}
+  };
+
+  /// A set of callbacks to the objects and capture points seen so far.
+  DenseSet<CaptureInfoCallbackVH, DenseMapInfo<Value *>> TrackedValues;
+
+  /// Walk the uses of V, unless an up to date walk is cached, and return the
+  /// result.
+  const ObjectInfo &getObjectInfo(const Value *V, bool StoreCaptures);
+
+  /// Return false if the pass manager has invalidated the cache.
+  bool isAvailable() const;
+
+  /// Record that the information cached for Object depends on V.
+  void addDependency(const Value *V, const Value *Object);
+};
+
+/// The analysis pass which yields a CaptureInfo
+///
+/// The analysis does nothing by itself, and just returns an empty CaptureInfo
+/// which will get filled in as it's used.
+class CaptureInfoAnalysis : public AnalysisInfoMixin<CaptureInfoAnalysis> {
+  friend AnalysisInfoMixin<CaptureInfoAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = CaptureInfo;
+  CaptureInfo run(Function &F, FunctionAnalysisManager &);
+};
+
+/// Wrapper pass for the legacy pass manager
+class CaptureInfoWrapperPass : public FunctionPass {
+  std::unique_ptr<CaptureInfo> Result;
+
+public:
+  static char ID;
+  CaptureInfoWrapperPass();
+
+  CaptureInfo &getResult() { return *Result; }
+  const CaptureInfo &getResult() const { return *Result; }
+
+  bool runOnFunction(Function &F) override;
+  void releaseMemory() override;
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+};
+
+} // namespace llvm
+
+#endif
@@ -29,13 +29,20 @@ namespace llvm {
   /// don't have this cap at all.
   unsigned constexpr DefaultMaxUsesToExplore = 20;
 
+  /// isNoEscapeAllocation - Return true if V is a call or invoke annotated
+  /// with !noescape metadata, i.e. an allocation that is known never to be
+  /// captured.
+  bool isNoEscapeAllocation(const Value *V);
+
   /// PointerMayBeCaptured - Return true if this pointer value may be captured
   /// by the enclosing function (which is required to exist).  This routine can
   /// be expensive, so consider caching the results.  The boolean ReturnCaptures
   /// specifies whether returning the value (or part of it) from the function
   /// counts as capturing it or not.  The boolean StoreCaptures specified
   /// whether storing the value (or part of it) into memory anywhere
-  /// automatically counts as capturing it or not.
+  /// automatically counts as capturing it or not.  If it is false, stores into
+  /// function-local memory that doesn't escape are looked through, and the
+  /// values loaded back out of that memory are tracked instead.
   /// MaxUsesToExplore specifies how many uses should the analysis explore for
   /// one value before giving up due too "too many uses".
   bool PointerMayBeCaptured(const Value *V,
@@ -62,6 +69,15 @@ namespace llvm {
                                   OrderedBasicBlock *OBB = nullptr,
                                   unsigned MaxUsesToExplore = DefaultMaxUsesToExplore);
 
+  /// mayCaptureBefore - Return true if a capture by CapturePoint may happen
+  /// before instruction I, the way PointerMayBeCapturedBefore decides it for
+  /// each capturing use. A capture by I itself counts if IncludeI is true. An
+  /// ordered basic block for the block of I is needed if CapturePoint is in
+  /// that block.
+  bool mayCaptureBefore(const Instruction *CapturePoint, const Instruction *I,
+                        const DominatorTree *DT, bool IncludeI,
+                        OrderedBasicBlock *OBB);
+
   /// This callback is used in conjunction with PointerMayBeCaptured. In
   /// addition to the interface here, you'll need to provide your own getters
   /// to see whether anything was captured.
@@ -83,6 +99,17 @@ namespace llvm {
     /// use U. Return true to stop the traversal or false to continue looking
     /// for more capturing instructions.
     virtual bool captured(const Use *U) = 0;
+
+    /// followStores - Return true if storing the pointer into function-local
+    /// memory whose address is itself never captured should not count as a
+    /// capture. The loads of that memory are then explored as values derived
+    /// from the pointer.
+    virtual bool followStores();
+
+    /// exploreUses - The uses of V are about to be looked at, either because V
+    /// is derived from the pointer or because it is local memory the pointer
+    /// was stored into.
+    virtual void exploreUses(const Value *V);
   };
 
   /// PointerMayBeCaptured - Visit the value and the values derived from it and
@@ -829,6 +829,10 @@ protected:
   MemoryUseOrDef *createDefinedAccess(Instruction *, MemoryAccess *,
                                       const MemoryUseOrDef *Template = nullptr);
 
+  // Drop the clobber queries remembered by the walkers. Used whenever the
+  // def-use chains change in a way the walker cache cannot see.
+  void invalidateClobberCache();
+
 private:
   template <class AliasAnalysisType> class ClobberWalkerBase;
   template <class AliasAnalysisType> class CachingWalker;
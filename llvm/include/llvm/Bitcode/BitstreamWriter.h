@@ -196,6 +196,26 @@ public:
     return nullptr;
   }
 
+  /// copyBlockInfo - Use the BLOCKINFO abbreviations of \p Other, so that
+  /// blocks written here can be spliced into it with EmitEncodedSubblock.
+  void copyBlockInfo(const BitstreamWriter &Other) {
+    BlockInfoRecords = Other.BlockInfoRecords;
+  }
+
+  /// EmitEncodedSubblock - Emit a block whose contents were written by
+  /// another stream: everything after its size word, through its END_BLOCK,
+  /// encoded with \p CodeLen bit abbrev IDs.
+  void EmitEncodedSubblock(unsigned BlockID, unsigned CodeLen,
+                           ArrayRef<char> Contents) {
+    assert((Contents.size() & 3) == 0 && "Block contents not 32-bit aligned");
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    WriteWord(Contents.size() / 4);
+    Out.append(Contents.begin(), Contents.end());
+  }
+
   void EnterSubblock(unsigned BlockID, unsigned CodeLen) {
     // Block header:
     //    [ENTER_SUBBLOCK, blockid, newcodelen, <align4bytes>, blocklen]
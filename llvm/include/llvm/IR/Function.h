@@ -49,6 +49,7 @@ enum ID : unsigned;
 class AssemblyAnnotationWriter;
 class Constant;
 class DISubprogram;
+class InstructionArena;
 class LLVMContext;
 class Module;
 template <typename T> class Optional;
@@ -75,6 +76,7 @@ private:
   std::unique_ptr<ValueSymbolTable>
       SymTab;                             ///< Symbol table of args/instructions
   AttributeList AttributeSets;            ///< Parameter attributes
+  InstructionArena *Arena = nullptr;      ///< Instruction storage, if any
 
   /*
    * Value::SubclassData
@@ -652,6 +654,13 @@ public:
     return SymTab.get();
   }
 
+  /// Allocate the instructions created for this function under an
+  /// InstructionArena::Scope from a per-function arena rather than the heap.
+  void enableInstructionArena();
+
+  /// Return the arena enabled by enableInstructionArena, or null.
+  InstructionArena *getInstructionArena() const { return Arena; }
+
   //===--------------------------------------------------------------------===//
   // BasicBlock iterator forwarding functions
   //
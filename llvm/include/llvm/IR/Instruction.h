@@ -54,7 +54,18 @@ class Instruction : public User,
 protected:
   ~Instruction(); // Use deleteValue() to delete a generic Instruction.
 
+  /// Allocate an instruction as User does, from the InstructionArena that is
+  /// current on this thread if there is one.
+  void *operator new(size_t Size);
+  void *operator new(size_t Size, unsigned Us);
+  void *operator new(size_t Size, unsigned Us, unsigned DescBytes);
+
 public:
+  /// Free an instruction as User does, handing storage taken from an
+  /// InstructionArena back to it.
+  void operator delete(void *Ptr) { User::operator delete(Ptr); }
+  using User::operator delete;
+
   Instruction(const Instruction &) = delete;
   Instruction &operator=(const Instruction &) = delete;
 
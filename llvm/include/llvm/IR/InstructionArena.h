@@ -0,0 +1,104 @@
+//===- llvm/IR/InstructionArena.h - Instruction storage ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares InstructionArena, a slab that the instructions of one
+// function and their operand lists can be allocated from instead of the heap.
+//
+// A function opts in with Function::enableInstructionArena (or every function
+// does, with -instruction-arenas). Instructions created while an
+// InstructionArena::Scope for that function is active on the current thread
+// are then bump-allocated next to each other, and deleting them costs nothing
+// beyond their destructors. The slab itself is freed in one go once the
+// function is gone and the last instruction allocated from it has been
+// deleted, so instructions moved to another function stay valid.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_INSTRUCTIONARENA_H
+#define LLVM_IR_INSTRUCTIONARENA_H
+
+#include "llvm/Support/Allocator.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace llvm {
+
+class Function;
+
+class InstructionArena {
+  BumpPtrAllocator Allocator;
+  /// The number of objects allocated from this arena that are still alive.
+  unsigned NumLiveObjects = 0;
+  /// Set once the owning function no longer needs the arena.
+  bool Released = false;
+
+  InstructionArena() = default;
+  ~InstructionArena() = default;
+
+public:
+  InstructionArena(const InstructionArena &) = delete;
+  InstructionArena &operator=(const InstructionArena &) = delete;
+
+  static InstructionArena *create() { return new InstructionArena(); }
+
+  /// Allocate storage for one User, operands included. The arena stays alive
+  /// until a matching deallocateObject call.
+  void *allocateObject(size_t Size) {
+    ++NumLiveObjects;
+    return Allocator.Allocate(Size, alignof(uint64_t));
+  }
+
+  /// Allocate a hung off operand list for a User that lives in this arena.
+  /// The list is reclaimed together with the arena. This includes the lists
+  /// that growHungoffUses replaces when a PHI or switch outgrows them: their
+  /// bytes are not reused, and stay allocated until the function is gone and
+  /// its last instruction has been deleted.
+  void *allocateOperands(size_t Size) {
+    return Allocator.Allocate(Size, alignof(uint64_t));
+  }
+
+  void deallocateObject() {
+    assert(NumLiveObjects && "Deallocating more objects than allocated!");
+    if (--NumLiveObjects == 0 && Released)
+      delete this;
+  }
+
+  /// Called by the owning function when it is destroyed. The arena is freed
+  /// now if it is empty, or else when its last object is deallocated.
+  void release() {
+    assert(!Released && "Arena released twice!");
+    Released = true;
+    if (NumLiveObjects == 0)
+      delete this;
+  }
+
+  size_t getBytesAllocated() const { return Allocator.getBytesAllocated(); }
+
+  /// Return the arena instructions created on this thread are allocated
+  /// from, or null if they come from the heap.
+  static InstructionArena *getCurrent();
+
+  /// Allocates instructions created on this thread from the arena of a
+  /// function while the scope is alive. Functions that have not opted in are
+  /// enabled here when -instruction-arenas is given; otherwise the heap is
+  /// used as usual.
+  class Scope {
+    InstructionArena *Saved;
+
+  public:
+    explicit Scope(Function &F);
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    ~Scope();
+  };
+};
+
+} // end namespace llvm
+
+#endif // LLVM_IR_INSTRUCTIONARENA_H
@@ -346,7 +346,7 @@ public:
 
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   /// Return true if this is a store to a volatile memory location.
@@ -471,7 +471,7 @@ public:
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s, 0);
+    return Instruction::operator new(s, 0);
   }
 
   /// Returns the ordering constraint of this fence instruction.
@@ -548,7 +548,7 @@ public:
 
   // allocate space for exactly three operands
   void *operator new(size_t s) {
-    return User::operator new(s, 3);
+    return Instruction::operator new(s, 3);
   }
 
   /// Return true if this is a cmpxchg from a volatile memory
@@ -744,7 +744,7 @@ public:
 
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   BinOp getOperation() const {
@@ -2040,7 +2040,7 @@ public:
 
   // allocate space for exactly three operands
   void *operator new(size_t s) {
-    return User::operator new(s, 3);
+    return Instruction::operator new(s, 3);
   }
 
   /// Swap the first 2 operands and adjust the mask to preserve the semantics
@@ -2487,7 +2487,7 @@ protected:
 public:
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   static InsertValueInst *Create(Value *Agg, Value *Val,
@@ -2835,7 +2835,7 @@ private:
 
   // Allocate space for exactly zero operands.
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void growOperands(unsigned Size);
@@ -3170,7 +3170,7 @@ class SwitchInst : public Instruction {
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void init(Value *Value, BasicBlock *Default, unsigned NumReserved);
@@ -3523,7 +3523,7 @@ class IndirectBrInst : public Instruction {
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void init(Value *Address, unsigned NumDests);
@@ -4224,7 +4224,7 @@ class CatchSwitchInst : public Instruction {
                   BasicBlock *InsertAtEnd);
 
   // allocate space for exactly zero operands
-  void *operator new(size_t s) { return User::operator new(s); }
+  void *operator new(size_t s) { return Instruction::operator new(s); }
 
   void init(Value *ParentPad, BasicBlock *UnwindDest, unsigned NumReserved);
   void growOperands(unsigned Size);
@@ -4662,7 +4662,7 @@ public:
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s, 0);
+    return Instruction::operator new(s, 0);
   }
 
   unsigned getNumSuccessors() const { return 0; }
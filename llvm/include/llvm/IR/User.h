@@ -38,6 +38,8 @@ template <typename T> class MutableArrayRef;
 /// Compile-time customization of User operands.
 ///
 /// Customizes operand-related allocators and accessors.
+class InstructionArena;
+
 template <class>
 struct OperandTraits;
 
@@ -46,7 +48,9 @@ class User : public Value {
   friend struct HungoffOperandTraits;
 
   LLVM_ATTRIBUTE_ALWAYS_INLINE inline static void *
-  allocateFixedOperandUser(size_t, unsigned, unsigned);
+  allocateFixedOperandUser(size_t, unsigned, unsigned, InstructionArena *);
+  LLVM_ATTRIBUTE_ALWAYS_INLINE inline static void *
+  allocateHungOffOperandUser(size_t, InstructionArena *);
 
 protected:
   /// Allocate a User with an operand pointer co-allocated.
@@ -70,6 +74,12 @@ protected:
   /// This is used for subclasses which have a fixed number of operands.
   void *operator new(size_t Size, unsigned Us, unsigned DescBytes);
 
+  /// Allocate a User like the operator new overloads above, but take the
+  /// storage from \p Arena if it is non-null. operator delete hands it back.
+  static void *allocateUser(size_t Size, unsigned Us, unsigned DescBytes,
+                            InstructionArena *Arena);
+  static void *allocateUser(size_t Size, InstructionArena *Arena);
+
   User(Type *ty, unsigned vty, Use *, unsigned NumOps)
       : Value(ty, vty) {
     assert(NumOps < (1u << NumUserOperandsBits) && "Too many operands");
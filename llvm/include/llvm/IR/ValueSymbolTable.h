@@ -80,6 +80,12 @@ public:
   /// The number of name/type pairs is returned.
   inline unsigned size() const { return unsigned(vmap.size()); }
 
+  /// The last suffix appended to a name to make it unique. A copy of the
+  /// values in another context renames them the same way if it is given the
+  /// same counter.
+  uint32_t getLastUnique() const { return LastUnique; }
+  void setLastUnique(uint32_t Last) { LastUnique = Last; }
+
   /// This function can be used from the debugger to display the
   /// content of the symbol table while debugging.
   /// Print out symbol table on stderr
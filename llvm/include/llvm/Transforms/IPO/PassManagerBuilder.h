@@ -131,6 +131,12 @@ public:
   /// added to the per-module passes.
   Pass *Inliner;
 
+  /// FunctionOptimizer - If this is non-null, it is added to the per-module
+  /// passes in place of the late GlobalsAA computation and the passes of
+  /// populateFunctionOptimizationPasses, which it is expected to run itself,
+  /// e.g. on several threads.
+  Pass *FunctionOptimizer;
+
   /// The module summary index to use for exporting information from the
   /// regular LTO phase, for example for the CFI and devirtualization type
   /// tests.
@@ -203,6 +209,13 @@ public:
 
   /// populateModulePassManager - This sets up the primary pass manager.
   void populateModulePassManager(legacy::PassManagerBase &MPM);
+
+  /// populateFunctionOptimizationPasses - This adds the function passes that
+  /// populateModulePassManager runs once inlining and the interprocedural
+  /// passes are done: vectorization, unrolling and their cleanups. They only
+  /// change the function they run on and expect GlobalsAA results computed
+  /// right before them.
+  void populateFunctionOptimizationPasses(legacy::PassManagerBase &PM);
   void populateLTOPassManager(legacy::PassManagerBase &PM);
   void populateThinLTOPassManager(legacy::PassManagerBase &PM);
 };
@@ -27,6 +27,7 @@
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/CFLAndersAliasAnalysis.h"
 #include "llvm/Analysis/CFLSteensAliasAnalysis.h"
+#include "llvm/Analysis/CaptureInfo.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/MemoryLocation.h"
@@ -61,7 +62,8 @@ static cl::opt<bool> DisableBasicAA("disable-basicaa", cl::Hidden,
                                     cl::init(false));
 
 AAResults::AAResults(AAResults &&Arg)
-    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)) {
+    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)),
+      CapInfo(Arg.CapInfo) {
   for (auto &AA : AAs)
     AA->setAAResults(this);
 }
@@ -649,10 +651,14 @@ ModRefInfo AAResults::callCapturesBefore(const Instruction *I,
   if (!Call || Call == Object)
     return ModRefInfo::ModRef;
 
-  if (PointerMayBeCapturedBefore(Object, /* ReturnCaptures */ true,
-                                 /* StoreCaptures */ true, I, DT,
-                                 /* include Object */ true,
-                                 /* OrderedBasicBlock */ OBB))
+  if (CapInfo ? CapInfo->isCapturedBefore(Object, /* ReturnCaptures */ true,
+                                          /* StoreCaptures */ true, I, DT,
+                                          /* include Object */ true,
+                                          /* OrderedBasicBlock */ OBB)
+              : PointerMayBeCapturedBefore(Object, /* ReturnCaptures */ true,
+                                           /* StoreCaptures */ true, I, DT,
+                                           /* include Object */ true,
+                                           /* OrderedBasicBlock */ OBB))
     return ModRefInfo::ModRef;
 
   unsigned ArgNo = 0;
@@ -725,6 +731,20 @@ AAResults::Concept::~Concept() = default;
 // Provide a definition for the static object used to identify passes.
 AnalysisKey AAManager::Key;
 
+AAManager::Result AAManager::run(Function &F, FunctionAnalysisManager &AM) {
+  Result R(AM.getResult<TargetLibraryAnalysis>(F));
+  for (auto &Getter : ResultGetters)
+    (*Getter)(F, AM, R);
+
+  // Use the capture points cached for F if they have been computed, and drop
+  // the results together with them.
+  if (auto *CI = AM.getCachedResult<CaptureInfoAnalysis>(F)) {
+    R.setCaptureInfo(CI);
+    R.addAADependencyID(CaptureInfoAnalysis::ID());
+  }
+  return R;
+}
+
 namespace {
 
 
@@ -751,6 +771,7 @@ INITIALIZE_PASS_BEGIN(AAResultsWrapperPass, "aa",
 INITIALIZE_PASS_DEPENDENCY(BasicAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(CFLAndersAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(CFLSteensAAWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(CFLSteensModuleAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(ExternalAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(GlobalsAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(ObjCARCAAWrapperPass)
@@ -805,6 +826,9 @@ bool AAResultsWrapperPass::runOnFunction(Function &F) {
     AAR->addAAResult(WrapperPass->getResult());
   if (auto *WrapperPass = getAnalysisIfAvailable<CFLSteensAAWrapperPass>())
     AAR->addAAResult(WrapperPass->getResult());
+  if (auto *WrapperPass =
+          getAnalysisIfAvailable<CFLSteensModuleAAWrapperPass>())
+    AAR->addAAResult(WrapperPass->getResult());
 
   // If available, run an external AA providing callback over the results as
   // well.
@@ -812,6 +836,9 @@ bool AAResultsWrapperPass::runOnFunction(Function &F) {
     if (WrapperPass->CB)
       WrapperPass->CB(*this, F, *AAR);
 
+  if (auto *WrapperPass = getAnalysisIfAvailable<CaptureInfoWrapperPass>())
+    AAR->setCaptureInfo(&WrapperPass->getResult());
+
   // Analyses don't mutate the IR, so return false.
   return false;
 }
@@ -832,6 +859,8 @@ void AAResultsWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addUsedIfAvailable<SCEVAAWrapperPass>();
   AU.addUsedIfAvailable<CFLAndersAAWrapperPass>();
   AU.addUsedIfAvailable<CFLSteensAAWrapperPass>();
+  AU.addUsedIfAvailable<CFLSteensModuleAAWrapperPass>();
+  AU.addUsedIfAvailable<CaptureInfoWrapperPass>();
 }
 
 AAResults llvm::createLegacyPMAAResults(Pass &P, Function &F,
@@ -857,6 +886,9 @@ AAResults llvm::createLegacyPMAAResults(Pass &P, Function &F,
     AAR.addAAResult(WrapperPass->getResult());
   if (auto *WrapperPass = P.getAnalysisIfAvailable<CFLSteensAAWrapperPass>())
     AAR.addAAResult(WrapperPass->getResult());
+  if (auto *WrapperPass =
+          P.getAnalysisIfAvailable<CFLSteensModuleAAWrapperPass>())
+    AAR.addAAResult(WrapperPass->getResult());
 
   return AAR;
 }
@@ -900,4 +932,5 @@ void llvm::getAAResultsAnalysisUsage(AnalysisUsage &AU) {
   AU.addUsedIfAvailable<GlobalsAAWrapperPass>();
   AU.addUsedIfAvailable<CFLAndersAAWrapperPass>();
   AU.addUsedIfAvailable<CFLSteensAAWrapperPass>();
+  AU.addUsedIfAvailable<CFLSteensModuleAAWrapperPass>();
 }
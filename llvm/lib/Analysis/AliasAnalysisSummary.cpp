@@ -61,6 +61,8 @@ AliasAttrs getGlobalOrArgAttrFromValue(const Value &Val) {
   return AttrNone;
 }
 
+AliasAttrs getAttrArg(unsigned ArgNo) { return argNumberToAttr(ArgNo); }
+
 bool isGlobalOrArgAttr(AliasAttrs Attr) {
   return Attr.reset(AttrEscapedIndex)
       .reset(AttrUnknownIndex)
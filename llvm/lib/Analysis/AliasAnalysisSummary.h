@@ -86,6 +86,10 @@ bool hasEscapedAttr(AliasAttrs);
 AliasAttrs getGlobalOrArgAttrFromValue(const Value &);
 bool isGlobalOrArgAttr(AliasAttrs);
 
+/// The AttrArg of the argument with the given index, for pointers a non-pointer
+/// argument carries, such as the fields of an aggregate.
+AliasAttrs getAttrArg(unsigned ArgNo);
+
 /// Given an AliasAttrs, return a new AliasAttrs that only contains attributes
 /// meaningful to the caller. This function is primarily used for
 /// interprocedural analysis
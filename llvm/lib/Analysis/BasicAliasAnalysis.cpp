@@ -20,6 +20,7 @@
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/CaptureInfo.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -103,7 +104,8 @@ bool BasicAAResult::invalidate(Function &Fn, const PreservedAnalyses &PA,
   if (Inv.invalidate<AssumptionAnalysis>(Fn, PA) ||
       (DT && Inv.invalidate<DominatorTreeAnalysis>(Fn, PA)) ||
       (LI && Inv.invalidate<LoopAnalysis>(Fn, PA)) ||
-      (PV && Inv.invalidate<PhiValuesAnalysis>(Fn, PA)))
+      (PV && Inv.invalidate<PhiValuesAnalysis>(Fn, PA)) ||
+      (CapInfo && Inv.invalidate<CaptureInfoAnalysis>(Fn, PA)))
     return true;
 
   // Otherwise this analysis result remains valid.
@@ -115,10 +117,14 @@ bool BasicAAResult::invalidate(Function &Fn, const PreservedAnalyses &PA,
 //===----------------------------------------------------------------------===//
 
 /// Returns true if the pointer is to a function-local object that never
-/// escapes from the function.
+/// escapes from the function. If StoreCaptures is false, the object may also
+/// be stored into function-local memory that never escapes, so loads of such
+/// memory can return it; see isNonLocalEscapeSource. If CapInfo is given, the
+/// capture walk is shared with every other query on the function.
 static bool isNonEscapingLocalObject(
     const Value *V,
-    SmallDenseMap<const Value *, bool, 8> *IsCapturedCache = nullptr) {
+    SmallDenseMap<const Value *, bool, 8> *IsCapturedCache = nullptr,
+    bool StoreCaptures = true, CaptureInfo *CapInfo = nullptr) {
   SmallDenseMap<const Value *, bool, 8>::iterator CacheIt;
   if (IsCapturedCache) {
     bool Inserted;
@@ -129,13 +135,13 @@ static bool isNonEscapingLocalObject(
   }
 
   // If this is a local allocation, check to see if it escapes.
-  if (isa<AllocaInst>(V) || isNoAliasCall(V)) {
-    // Set StoreCaptures to True so that we can assume in our callers that the
-    // pointer is not the result of a load instruction. Currently
-    // PointerMayBeCaptured doesn't have any special analysis for the
-    // StoreCaptures=false case; if it did, our callers could be refined to be
-    // more precise.
-    auto Ret = !PointerMayBeCaptured(V, false, /*StoreCaptures=*/true);
+  if (isa<AllocaInst>(V) || isNoAliasCall(V) || isNoEscapeAllocation(V)) {
+    // With StoreCaptures set, callers can assume that the pointer is not the
+    // result of a load instruction. Otherwise PointerMayBeCaptured follows the
+    // pointer through stores into non-escaping local memory, and callers must
+    // only rule out loads of non-local memory.
+    auto Ret = CapInfo ? !CapInfo->isCaptured(V, false, StoreCaptures)
+                       : !PointerMayBeCaptured(V, false, StoreCaptures);
     if (IsCapturedCache)
       CacheIt->second = Ret;
     return Ret;
@@ -149,7 +155,8 @@ static bool isNonEscapingLocalObject(
       // Note even if the argument is marked nocapture, we still need to check
       // for copies made inside the function. The nocapture attribute only
       // specifies that there are no copies made that outlive the function.
-      auto Ret = !PointerMayBeCaptured(V, false, /*StoreCaptures=*/true);
+      auto Ret = CapInfo ? !CapInfo->isCaptured(V, false, StoreCaptures)
+                         : !PointerMayBeCaptured(V, false, StoreCaptures);
       if (IsCapturedCache)
         CacheIt->second = Ret;
       return Ret;
@@ -176,6 +183,19 @@ static bool isEscapeSource(const Value *V) {
   return false;
 }
 
+/// Returns true if the pointer is one which would have been considered an
+/// escape by isNonEscapingLocalObject with StoreCaptures unset. Such objects
+/// may be held in non-escaping local memory, so only loads of arguments,
+/// globals and call results still qualify.
+static bool isNonLocalEscapeSource(const Value *V, const DataLayout &DL) {
+  if (const auto *LI = dyn_cast<LoadInst>(V)) {
+    const Value *Object = GetUnderlyingObject(LI->getPointerOperand(), DL);
+    return isa<Argument>(Object) || isa<GlobalValue>(Object) ||
+           (isa<CallBase>(Object) && !isNoEscapeAllocation(Object));
+  }
+  return isEscapeSource(V);
+}
+
 /// Returns the size of the object specified by V or UnknownSize if unknown.
 static uint64_t getObjectSize(const Value *V, const DataLayout &DL,
                               const TargetLibraryInfo &TLI,
@@ -875,7 +895,10 @@ ModRefInfo BasicAAResult::getModRefInfo(const CallBase *Call,
   // then the call can not mod/ref the pointer unless the call takes the pointer
   // as an argument, and itself doesn't capture it.
   if (!isa<Constant>(Object) && Call != Object &&
-      isNonEscapingLocalObject(Object, &AAQI.IsCapturedCache)) {
+      (isNonEscapingLocalObject(Object, &AAQI.IsCapturedCache,
+                                /*StoreCaptures=*/true, CapInfo) ||
+       isNonEscapingLocalObject(Object, &AAQI.IsStoreCapturedCache,
+                                /*StoreCaptures=*/false, CapInfo))) {
 
     // Optimistically assume that call doesn't touch Object and check this
     // assumption in the following loop.
@@ -1782,10 +1805,24 @@ AliasResult BasicAAResult::aliasCheck(const Value *V1, LocationSize V1Size,
     // location if that memory location doesn't escape. Or it may pass a
     // nocapture value to other functions as long as they don't capture it.
     if (isEscapeSource(O1) &&
-        isNonEscapingLocalObject(O2, &AAQI.IsCapturedCache))
+        isNonEscapingLocalObject(O2, &AAQI.IsCapturedCache,
+                                 /*StoreCaptures=*/true, CapInfo))
       return NoAlias;
     if (isEscapeSource(O2) &&
-        isNonEscapingLocalObject(O1, &AAQI.IsCapturedCache))
+        isNonEscapingLocalObject(O1, &AAQI.IsCapturedCache,
+                                 /*StoreCaptures=*/true, CapInfo))
+      return NoAlias;
+
+    // The same holds if the local object is only ever stored into local
+    // memory that doesn't escape either, e.g. a field of a stack-allocated
+    // struct, as long as the other pointer isn't loaded from local memory.
+    if (isNonLocalEscapeSource(O1, DL) &&
+        isNonEscapingLocalObject(O2, &AAQI.IsStoreCapturedCache,
+                                 /*StoreCaptures=*/false, CapInfo))
+      return NoAlias;
+    if (isNonLocalEscapeSource(O2, DL) &&
+        isNonEscapingLocalObject(O1, &AAQI.IsStoreCapturedCache,
+                                 /*StoreCaptures=*/false, CapInfo))
       return NoAlias;
   }
 
@@ -2023,7 +2060,8 @@ BasicAAResult BasicAA::run(Function &F, FunctionAnalysisManager &AM) {
                        AM.getResult<AssumptionAnalysis>(F),
                        &AM.getResult<DominatorTreeAnalysis>(F),
                        AM.getCachedResult<LoopAnalysis>(F),
-                       AM.getCachedResult<PhiValuesAnalysis>(F));
+                       AM.getCachedResult<PhiValuesAnalysis>(F),
+                       AM.getCachedResult<CaptureInfoAnalysis>(F));
 }
 
 BasicAAWrapperPass::BasicAAWrapperPass() : FunctionPass(ID) {
@@ -2052,11 +2090,13 @@ bool BasicAAWrapperPass::runOnFunction(Function &F) {
   auto &DTWP = getAnalysis<DominatorTreeWrapperPass>();
   auto *LIWP = getAnalysisIfAvailable<LoopInfoWrapperPass>();
   auto *PVWP = getAnalysisIfAvailable<PhiValuesWrapperPass>();
+  auto *CIWP = getAnalysisIfAvailable<CaptureInfoWrapperPass>();
 
   Result.reset(new BasicAAResult(F.getParent()->getDataLayout(), F, TLIWP.getTLI(),
                                  ACT.getAssumptionCache(F), &DTWP.getDomTree(),
                                  LIWP ? &LIWP->getLoopInfo() : nullptr,
-                                 PVWP ? &PVWP->getResult() : nullptr));
+                                 PVWP ? &PVWP->getResult() : nullptr,
+                                 CIWP ? &CIWP->getResult() : nullptr));
 
   return false;
 }
@@ -2067,6 +2107,7 @@ void BasicAAWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<DominatorTreeWrapperPass>();
   AU.addRequired<TargetLibraryInfoWrapperPass>();
   AU.addUsedIfAvailable<PhiValuesWrapperPass>();
+  AU.addUsedIfAvailable<CaptureInfoWrapperPass>();
 }
 
 BasicAAResult llvm::createLegacyPMBasicAAResult(Pass &P, Function &F) {
@@ -28,11 +28,14 @@
 //
 // There are two differences between our current implementation and the one
 // described in the paper:
-// - Our algorithm eagerly computes all alias pairs after the CFLGraph is built,
-// while in the paper the authors did the computation in a demand-driven
-// fashion. We did not implement the demand-driven algorithm due to the
-// additional coding complexity and higher memory profile, but if we found it
-// necessary we may switch to it eventually.
+// - Our algorithm computes all alias pairs after the CFLGraph is built, while
+// in the paper the authors did the computation in a demand-driven fashion for
+// every query. As a middle ground, the first few queries on a function only
+// compute the alias pairs within the weakly connected components of the
+// CFLGraph that contain the queried values. CFL paths never leave such a
+// component, so the answer is the same as with all pairs computed. Once a
+// function has been queried often enough, or its summary is needed, all alias
+// pairs are computed as before.
 // - In the paper the authors use a state machine that does not distinguish
 // value reads from value writes. For example, if Y is reachable from X at state
 // S3, it may be the case that X is written into Y, or it may be the case that
@@ -55,6 +58,8 @@
 #include "llvm/Analysis/CFLAndersAliasAnalysis.h"
 #include "AliasAnalysisSummary.h"
 #include "CFLGraph.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/ADT/DenseSet.h"
@@ -62,6 +67,7 @@
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/MemoryLocation.h"
@@ -71,6 +77,7 @@
 #include "llvm/IR/Type.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -80,6 +87,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <numeric>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -88,6 +98,12 @@ using namespace llvm::cflaa;
 
 #define DEBUG_TYPE "cfl-anders-aa"
 
+static cl::opt<unsigned> DemandQueryLimit(
+    "cfl-anders-demand-queries", cl::init(32), cl::Hidden,
+    cl::desc("Number of alias queries on a function that CFL-Anders answers "
+             "on demand before computing all of its alias pairs (0 = always "
+             "compute all alias pairs)"));
+
 CFLAndersAAResult::CFLAndersAAResult(const TargetLibraryInfo &TLI) : TLI(TLI) {}
 CFLAndersAAResult::CFLAndersAAResult(CFLAndersAAResult &&RHS)
     : AAResultBase(std::move(RHS)), TLI(RHS.TLI) {}
@@ -153,82 +169,155 @@ bool operator==(OffsetInstantiatedValue LHS, OffsetInstantiatedValue RHS) {
   return LHS.IVal == RHS.IVal && LHS.Offset == RHS.Offset;
 }
 
+// We number the nodes of the CFLGraph densely, so that the sets below can be
+// indexed by node number instead of hashing InstantiatedValues. The levels of
+// one value get consecutive numbers, so the node below N is N + 1. The
+// assignment edges are copied into flat arrays of node numbers.
+class NodeNumbering {
+  DenseMap<InstantiatedValue, unsigned> Ids;
+  std::vector<InstantiatedValue> Nodes;
+  std::vector<AliasAttrs> Attrs;
+  std::vector<bool> HasNodeBelow;
+  std::vector<unsigned> EdgeBegin, Edges, ReverseEdgeBegin, ReverseEdges;
+
+public:
+  explicit NodeNumbering(const CFLGraph &Graph) {
+    std::vector<const CFLGraph::NodeInfo *> Infos;
+    for (const auto &Mapping : Graph.value_mappings()) {
+      auto Val = Mapping.first;
+      auto &ValueInfo = Mapping.second;
+      for (unsigned I = 0, E = ValueInfo.getNumLevels(); I < E; ++I) {
+        auto Node = InstantiatedValue{Val, I};
+        auto &NodeInfo = ValueInfo.getNodeInfoAtLevel(I);
+        Ids[Node] = Nodes.size();
+        Nodes.push_back(Node);
+        Attrs.push_back(NodeInfo.Attr);
+        Infos.push_back(&NodeInfo);
+        HasNodeBelow.push_back(I + 1 < E);
+      }
+    }
+
+    for (const auto *NodeInfo : Infos) {
+      EdgeBegin.push_back(Edges.size());
+      for (const auto &Edge : NodeInfo->Edges)
+        Edges.push_back(Ids.lookup(Edge.Other));
+      ReverseEdgeBegin.push_back(ReverseEdges.size());
+      for (const auto &Edge : NodeInfo->ReverseEdges)
+        ReverseEdges.push_back(Ids.lookup(Edge.Other));
+    }
+    EdgeBegin.push_back(Edges.size());
+    ReverseEdgeBegin.push_back(ReverseEdges.size());
+  }
+
+  unsigned size() const { return Nodes.size(); }
+
+  Optional<unsigned> lookup(InstantiatedValue V) const {
+    auto Itr = Ids.find(V);
+    if (Itr == Ids.end())
+      return None;
+    return Itr->second;
+  }
+
+  InstantiatedValue getNode(unsigned Id) const { return Nodes[Id]; }
+
+  AliasAttrs getAttrs(unsigned Id) const { return Attrs[Id]; }
+
+  // Nodes that 'Id' is assigned to
+  ArrayRef<unsigned> getEdges(unsigned Id) const {
+    return makeArrayRef(Edges).slice(EdgeBegin[Id],
+                                     EdgeBegin[Id + 1] - EdgeBegin[Id]);
+  }
+
+  // Nodes that are assigned to 'Id'
+  ArrayRef<unsigned> getReverseEdges(unsigned Id) const {
+    return makeArrayRef(ReverseEdges)
+        .slice(ReverseEdgeBegin[Id],
+               ReverseEdgeBegin[Id + 1] - ReverseEdgeBegin[Id]);
+  }
+
+  Optional<unsigned> getNodeBelow(unsigned Id) const {
+    if (HasNodeBelow[Id])
+      return Id + 1;
+    return None;
+  }
+};
+
 // We use ReachabilitySet to keep track of value aliases (The nonterminal "V" in
-// the paper) during the analysis.
+// the paper) during the analysis. Each node has one sparse bitvector holding
+// bit 'From * NumStates + State' for every edge 'From->Node' at 'State', so the
+// states of one source share a word with those of its neighbours.
 class ReachabilitySet {
-  using ValueStateMap = DenseMap<InstantiatedValue, StateSet>;
-  using ValueReachMap = DenseMap<InstantiatedValue, ValueStateMap>;
+  static const unsigned NumStates = 8;
 
-  ValueReachMap ReachMap;
+  std::vector<SparseBitVector<>> ReachMap;
 
 public:
-  using const_valuestate_iterator = ValueStateMap::const_iterator;
-  using const_value_iterator = ValueReachMap::const_iterator;
+  explicit ReachabilitySet(unsigned NumNodes) : ReachMap(NumNodes) {}
 
   // Insert edge 'From->To' at state 'State'
-  bool insert(InstantiatedValue From, InstantiatedValue To, MatchState State) {
+  bool insert(unsigned From, unsigned To, MatchState State) {
     assert(From != To);
-    auto &States = ReachMap[To][From];
-    auto Idx = static_cast<size_t>(State);
-    if (!States.test(Idx)) {
-      States.set(Idx);
-      return true;
-    }
-    return false;
+    return ReachMap[To].test_and_set(From * NumStates +
+                                     static_cast<unsigned>(State));
   }
 
-  // Return the set of all ('From', 'State') pair for a given node 'To'
-  iterator_range<const_valuestate_iterator>
-  reachableValueAliases(InstantiatedValue V) const {
-    auto Itr = ReachMap.find(V);
-    if (Itr == ReachMap.end())
-      return make_range<const_valuestate_iterator>(const_valuestate_iterator(),
-                                                   const_valuestate_iterator());
-    return make_range<const_valuestate_iterator>(Itr->second.begin(),
-                                                 Itr->second.end());
+  // Call 'Callback(From, States)' for every node 'From' that reaches the node
+  // 'To', in increasing order of 'From'
+  template <typename CallbackT>
+  void forEachValueAlias(unsigned To, CallbackT Callback) const {
+    Optional<unsigned> Current;
+    StateSet States;
+    for (unsigned Bit : ReachMap[To]) {
+      unsigned From = Bit / NumStates;
+      if (Current != From) {
+        if (Current)
+          Callback(*Current, States);
+        Current = From;
+        States.reset();
+      }
+      States.set(Bit % NumStates);
+    }
+    if (Current)
+      Callback(*Current, States);
   }
 
-  iterator_range<const_value_iterator> value_mappings() const {
-    return make_range<const_value_iterator>(ReachMap.begin(), ReachMap.end());
+  bool hasValueAliases(unsigned To) const { return !ReachMap[To].empty(); }
+
+  // Return true if edge 'From->To' exists at any state
+  bool reaches(unsigned From, unsigned To) const {
+    for (unsigned State = 0; State < NumStates; ++State)
+      if (ReachMap[To].test(From * NumStates + State))
+        return true;
+    return false;
   }
 };
 
 // We use AliasMemSet to keep track of all memory aliases (the nonterminal "M"
-// in the paper) during the analysis.
+// in the paper) during the analysis. Top-level values can never be memory
+// aliases because one cannot take the addresses of them.
 class AliasMemSet {
-  using MemSet = DenseSet<InstantiatedValue>;
-  using MemMapType = DenseMap<InstantiatedValue, MemSet>;
-
-  MemMapType MemMap;
+  std::vector<SparseBitVector<>> MemMap;
 
 public:
-  using const_mem_iterator = MemSet::const_iterator;
+  explicit AliasMemSet(unsigned NumNodes) : MemMap(NumNodes) {}
 
-  bool insert(InstantiatedValue LHS, InstantiatedValue RHS) {
-    // Top-level values can never be memory aliases because one cannot take the
-    // addresses of them
-    assert(LHS.DerefLevel > 0 && RHS.DerefLevel > 0);
-    return MemMap[LHS].insert(RHS).second;
+  bool insert(unsigned LHS, unsigned RHS) {
+    return MemMap[LHS].test_and_set(RHS);
   }
 
-  const MemSet *getMemoryAliases(InstantiatedValue V) const {
-    auto Itr = MemMap.find(V);
-    if (Itr == MemMap.end())
-      return nullptr;
-    return &Itr->second;
+  const SparseBitVector<> &getMemoryAliases(unsigned V) const {
+    return MemMap[V];
   }
 };
 
 // We use AliasAttrMap to keep track of the AliasAttr of each node.
 class AliasAttrMap {
-  using MapType = DenseMap<InstantiatedValue, AliasAttrs>;
-
-  MapType AttrMap;
+  std::vector<AliasAttrs> AttrMap;
 
 public:
-  using const_iterator = MapType::const_iterator;
+  explicit AliasAttrMap(unsigned NumNodes) : AttrMap(NumNodes) {}
 
-  bool add(InstantiatedValue V, AliasAttrs Attr) {
+  bool add(unsigned V, AliasAttrs Attr) {
     auto &OldAttr = AttrMap[V];
     auto NewAttr = OldAttr | Attr;
     if (OldAttr == NewAttr)
@@ -237,22 +326,14 @@ public:
     return true;
   }
 
-  AliasAttrs getAttrs(InstantiatedValue V) const {
-    AliasAttrs Attr;
-    auto Itr = AttrMap.find(V);
-    if (Itr != AttrMap.end())
-      Attr = Itr->second;
-    return Attr;
-  }
+  AliasAttrs getAttrs(unsigned V) const { return AttrMap[V]; }
 
-  iterator_range<const_iterator> mappings() const {
-    return make_range<const_iterator>(AttrMap.begin(), AttrMap.end());
-  }
+  unsigned size() const { return AttrMap.size(); }
 };
 
 struct WorkListItem {
-  InstantiatedValue From;
-  InstantiatedValue To;
+  unsigned From;
+  unsigned To;
   MatchState State;
 };
 
@@ -334,7 +415,8 @@ class CFLAndersAAResult::FunctionInfo {
 
 public:
   FunctionInfo(const Function &, const SmallVectorImpl<Value *> &,
-               const ReachabilitySet &, const AliasAttrMap &);
+               const NodeNumbering &, const ReachabilitySet &,
+               const AliasAttrMap &);
 
   bool mayAlias(const Value *, LocationSize, const Value *, LocationSize) const;
   const AliasSummary &getAliasSummary() const { return Summary; }
@@ -365,33 +447,35 @@ getInterfaceValue(InstantiatedValue IValue,
 }
 
 static void populateAttrMap(DenseMap<const Value *, AliasAttrs> &AttrMap,
+                            const NodeNumbering &Nodes,
                             const AliasAttrMap &AMap) {
-  for (const auto &Mapping : AMap.mappings()) {
-    auto IVal = Mapping.first;
+  for (unsigned Id = 0, E = AMap.size(); Id < E; ++Id) {
+    auto IVal = Nodes.getNode(Id);
 
     // Insert IVal into the map
     auto &Attr = AttrMap[IVal.Val];
     // AttrMap only cares about top-level values
     if (IVal.DerefLevel == 0)
-      Attr |= Mapping.second;
+      Attr |= AMap.getAttrs(Id);
   }
 }
 
 static void
 populateAliasMap(DenseMap<const Value *, std::vector<OffsetValue>> &AliasMap,
-                 const ReachabilitySet &ReachSet) {
-  for (const auto &OuterMapping : ReachSet.value_mappings()) {
+                 const NodeNumbering &Nodes, const ReachabilitySet &ReachSet) {
+  for (unsigned Id = 0, E = Nodes.size(); Id < E; ++Id) {
     // AliasMap only cares about top-level values
-    if (OuterMapping.first.DerefLevel > 0)
+    auto IVal = Nodes.getNode(Id);
+    if (IVal.DerefLevel > 0 || !ReachSet.hasValueAliases(Id))
       continue;
 
-    auto Val = OuterMapping.first.Val;
-    auto &AliasList = AliasMap[Val];
-    for (const auto &InnerMapping : OuterMapping.second) {
+    auto &AliasList = AliasMap[IVal.Val];
+    ReachSet.forEachValueAlias(Id, [&](unsigned From, StateSet) {
       // Again, AliasMap only cares about top-level values
-      if (InnerMapping.first.DerefLevel == 0)
-        AliasList.push_back(OffsetValue{InnerMapping.first.Val, UnknownOffset});
-    }
+      auto FromVal = Nodes.getNode(From);
+      if (FromVal.DerefLevel == 0)
+        AliasList.push_back(OffsetValue{FromVal.Val, UnknownOffset});
+    });
 
     // Sort AliasList for faster lookup
     llvm::sort(AliasList);
@@ -400,7 +484,8 @@ populateAliasMap(DenseMap<const Value *, std::vector<OffsetValue>> &AliasMap,
 
 static void populateExternalRelations(
     SmallVectorImpl<ExternalRelation> &ExtRelations, const Function &Fn,
-    const SmallVectorImpl<Value *> &RetVals, const ReachabilitySet &ReachSet) {
+    const SmallVectorImpl<Value *> &RetVals, const NodeNumbering &Nodes,
+    const ReachabilitySet &ReachSet) {
   // If a function only returns one of its argument X, then X will be both an
   // argument and a return value at the same time. This is an edge case that
   // needs special handling here.
@@ -426,29 +511,29 @@ static void populateExternalRelations(
   // are non-empty, we know that a particular value is an intermidate and we
   // need to add summary edges from the writes to the reads.
   DenseMap<Value *, ValueSummary> ValueMap;
-  for (const auto &OuterMapping : ReachSet.value_mappings()) {
-    if (auto Dst = getInterfaceValue(OuterMapping.first, RetVals)) {
-      for (const auto &InnerMapping : OuterMapping.second) {
+  for (unsigned Id = 0, E = Nodes.size(); Id < E; ++Id) {
+    if (auto Dst = getInterfaceValue(Nodes.getNode(Id), RetVals)) {
+      ReachSet.forEachValueAlias(Id, [&](unsigned From, StateSet States) {
+        auto SrcIVal = Nodes.getNode(From);
         // If Src is a param/return value, we get a same-level assignment.
-        if (auto Src = getInterfaceValue(InnerMapping.first, RetVals)) {
+        if (auto Src = getInterfaceValue(SrcIVal, RetVals)) {
           // This may happen if both Dst and Src are return values
           if (*Dst == *Src)
-            continue;
+            return;
 
-          if (hasReadOnlyState(InnerMapping.second))
+          if (hasReadOnlyState(States))
             ExtRelations.push_back(ExternalRelation{*Dst, *Src, UnknownOffset});
           // No need to check for WriteOnly state, since ReachSet is symmetric
         } else {
           // If Src is not a param/return, add it to ValueMap
-          auto SrcIVal = InnerMapping.first;
-          if (hasReadOnlyState(InnerMapping.second))
+          if (hasReadOnlyState(States))
             ValueMap[SrcIVal.Val].FromRecords.push_back(
                 ValueSummary::Record{*Dst, SrcIVal.DerefLevel});
-          if (hasWriteOnlyState(InnerMapping.second))
+          if (hasWriteOnlyState(States))
             ValueMap[SrcIVal.Val].ToRecords.push_back(
                 ValueSummary::Record{*Dst, SrcIVal.DerefLevel});
         }
-      }
+      });
     }
   }
 
@@ -485,10 +570,11 @@ static void populateExternalRelations(
 
 static void populateExternalAttributes(
     SmallVectorImpl<ExternalAttribute> &ExtAttributes, const Function &Fn,
-    const SmallVectorImpl<Value *> &RetVals, const AliasAttrMap &AMap) {
-  for (const auto &Mapping : AMap.mappings()) {
-    if (auto IVal = getInterfaceValue(Mapping.first, RetVals)) {
-      auto Attr = getExternallyVisibleAttrs(Mapping.second);
+    const SmallVectorImpl<Value *> &RetVals, const NodeNumbering &Nodes,
+    const AliasAttrMap &AMap) {
+  for (unsigned Id = 0, E = AMap.size(); Id < E; ++Id) {
+    if (auto IVal = getInterfaceValue(Nodes.getNode(Id), RetVals)) {
+      auto Attr = getExternallyVisibleAttrs(AMap.getAttrs(Id));
       if (Attr.any())
         ExtAttributes.push_back(ExternalAttribute{*IVal, Attr});
     }
@@ -497,11 +583,14 @@ static void populateExternalAttributes(
 
 CFLAndersAAResult::FunctionInfo::FunctionInfo(
     const Function &Fn, const SmallVectorImpl<Value *> &RetVals,
-    const ReachabilitySet &ReachSet, const AliasAttrMap &AMap) {
-  populateAttrMap(AttrMap, AMap);
-  populateExternalAttributes(Summary.RetParamAttributes, Fn, RetVals, AMap);
-  populateAliasMap(AliasMap, ReachSet);
-  populateExternalRelations(Summary.RetParamRelations, Fn, RetVals, ReachSet);
+    const NodeNumbering &Nodes, const ReachabilitySet &ReachSet,
+    const AliasAttrMap &AMap) {
+  populateAttrMap(AttrMap, Nodes, AMap);
+  populateExternalAttributes(Summary.RetParamAttributes, Fn, RetVals, Nodes,
+                             AMap);
+  populateAliasMap(AliasMap, Nodes, ReachSet);
+  populateExternalRelations(Summary.RetParamRelations, Fn, RetVals, Nodes,
+                            ReachSet);
 }
 
 Optional<AliasAttrs>
@@ -514,6 +603,19 @@ CFLAndersAAResult::FunctionInfo::getAttrs(const Value *V) const {
   return None;
 }
 
+// Decide a query from the AliasAttrs of both values alone if possible.
+static Optional<bool> mayAliasFromAttrs(AliasAttrs AttrsA, AliasAttrs AttrsB) {
+  if (hasUnknownOrCallerAttr(AttrsA))
+    return AttrsB.any();
+  if (hasUnknownOrCallerAttr(AttrsB))
+    return AttrsA.any();
+  if (isGlobalOrArgAttr(AttrsA))
+    return isGlobalOrArgAttr(AttrsB);
+  if (isGlobalOrArgAttr(AttrsB))
+    return isGlobalOrArgAttr(AttrsA);
+  return None;
+}
+
 bool CFLAndersAAResult::FunctionInfo::mayAlias(
     const Value *LHS, LocationSize MaybeLHSSize, const Value *RHS,
     LocationSize MaybeRHSSize) const {
@@ -528,16 +630,8 @@ bool CFLAndersAAResult::FunctionInfo::mayAlias(
     return true;
 
   // Check AliasAttrs before AliasMap lookup since it's cheaper
-  auto AttrsA = *MaybeAttrsA;
-  auto AttrsB = *MaybeAttrsB;
-  if (hasUnknownOrCallerAttr(AttrsA))
-    return AttrsB.any();
-  if (hasUnknownOrCallerAttr(AttrsB))
-    return AttrsA.any();
-  if (isGlobalOrArgAttr(AttrsA))
-    return isGlobalOrArgAttr(AttrsB);
-  if (isGlobalOrArgAttr(AttrsB))
-    return isGlobalOrArgAttr(AttrsA);
+  if (auto Result = mayAliasFromAttrs(*MaybeAttrsA, *MaybeAttrsB))
+    return *Result;
 
   // At this point both LHS and RHS should point to locally allocated objects
 
@@ -591,8 +685,8 @@ bool CFLAndersAAResult::FunctionInfo::mayAlias(
   return false;
 }
 
-static void propagate(InstantiatedValue From, InstantiatedValue To,
-                      MatchState State, ReachabilitySet &ReachSet,
+static void propagate(unsigned From, unsigned To, MatchState State,
+                      ReachabilitySet &ReachSet,
                       std::vector<WorkListItem> &WorkList) {
   if (From == To)
     return;
@@ -602,44 +696,26 @@ static void propagate(InstantiatedValue From, InstantiatedValue To,
 
 static void initializeWorkList(std::vector<WorkListItem> &WorkList,
                                ReachabilitySet &ReachSet,
-                               const CFLGraph &Graph) {
-  for (const auto &Mapping : Graph.value_mappings()) {
-    auto Val = Mapping.first;
-    auto &ValueInfo = Mapping.second;
-    assert(ValueInfo.getNumLevels() > 0);
-
-    // Insert all immediate assignment neighbors to the worklist
-    for (unsigned I = 0, E = ValueInfo.getNumLevels(); I < E; ++I) {
-      auto Src = InstantiatedValue{Val, I};
-      // If there's an assignment edge from X to Y, it means Y is reachable from
-      // X at S3 and X is reachable from Y at S1
-      for (auto &Edge : ValueInfo.getNodeInfoAtLevel(I).Edges) {
-        propagate(Edge.Other, Src, MatchState::FlowFromReadOnly, ReachSet,
-                  WorkList);
-        propagate(Src, Edge.Other, MatchState::FlowToWriteOnly, ReachSet,
-                  WorkList);
-      }
+                               const NodeNumbering &Nodes,
+                               ArrayRef<unsigned> Roots) {
+  // Insert all immediate assignment neighbors to the worklist
+  for (unsigned Src : Roots) {
+    // If there's an assignment edge from X to Y, it means Y is reachable from
+    // X at S3 and X is reachable from Y at S1
+    for (unsigned Other : Nodes.getEdges(Src)) {
+      propagate(Other, Src, MatchState::FlowFromReadOnly, ReachSet, WorkList);
+      propagate(Src, Other, MatchState::FlowToWriteOnly, ReachSet, WorkList);
     }
   }
 }
 
-static Optional<InstantiatedValue> getNodeBelow(const CFLGraph &Graph,
-                                                InstantiatedValue V) {
-  auto NodeBelow = InstantiatedValue{V.Val, V.DerefLevel + 1};
-  if (Graph.getNode(NodeBelow))
-    return NodeBelow;
-  return None;
-}
-
-static void processWorkListItem(const WorkListItem &Item, const CFLGraph &Graph,
+static void processWorkListItem(const WorkListItem &Item,
+                                const NodeNumbering &Nodes,
                                 ReachabilitySet &ReachSet, AliasMemSet &MemSet,
                                 std::vector<WorkListItem> &WorkList) {
   auto FromNode = Item.From;
   auto ToNode = Item.To;
 
-  auto NodeInfo = Graph.getNode(ToNode);
-  assert(NodeInfo != nullptr);
-
   // TODO: propagate field offsets
 
   // FIXME: Here is a neat trick we can do: since both ReachSet and MemSet holds
@@ -648,26 +724,27 @@ static void processWorkListItem(const WorkListItem &Item, const CFLGraph &Graph,
 
   // The newly added value alias pair may potentially generate more memory
   // alias pairs. Check for them here.
-  auto FromNodeBelow = getNodeBelow(Graph, FromNode);
-  auto ToNodeBelow = getNodeBelow(Graph, ToNode);
+  auto FromNodeBelow = Nodes.getNodeBelow(FromNode);
+  auto ToNodeBelow = Nodes.getNodeBelow(ToNode);
   if (FromNodeBelow && ToNodeBelow &&
       MemSet.insert(*FromNodeBelow, *ToNodeBelow)) {
     propagate(*FromNodeBelow, *ToNodeBelow,
               MatchState::FlowFromMemAliasNoReadWrite, ReachSet, WorkList);
-    for (const auto &Mapping : ReachSet.reachableValueAliases(*FromNodeBelow)) {
-      auto Src = Mapping.first;
-      auto MemAliasPropagate = [&](MatchState FromState, MatchState ToState) {
-        if (Mapping.second.test(static_cast<size_t>(FromState)))
-          propagate(Src, *ToNodeBelow, ToState, ReachSet, WorkList);
-      };
-
-      MemAliasPropagate(MatchState::FlowFromReadOnly,
-                        MatchState::FlowFromMemAliasReadOnly);
-      MemAliasPropagate(MatchState::FlowToWriteOnly,
-                        MatchState::FlowToMemAliasWriteOnly);
-      MemAliasPropagate(MatchState::FlowToReadWrite,
-                        MatchState::FlowToMemAliasReadWrite);
-    }
+    ReachSet.forEachValueAlias(
+        *FromNodeBelow, [&](unsigned Src, StateSet States) {
+          auto MemAliasPropagate = [&](MatchState FromState,
+                                       MatchState ToState) {
+            if (States.test(static_cast<size_t>(FromState)))
+              propagate(Src, *ToNodeBelow, ToState, ReachSet, WorkList);
+          };
+
+          MemAliasPropagate(MatchState::FlowFromReadOnly,
+                            MatchState::FlowFromMemAliasReadOnly);
+          MemAliasPropagate(MatchState::FlowToWriteOnly,
+                            MatchState::FlowToMemAliasWriteOnly);
+          MemAliasPropagate(MatchState::FlowToReadWrite,
+                            MatchState::FlowToMemAliasReadWrite);
+        });
   }
 
   // This is the core of the state machine walking algorithm. We expand ReachSet
@@ -679,18 +756,16 @@ static void processWorkListItem(const WorkListItem &Item, const CFLGraph &Graph,
   // - If Y is an alias of X, then reverse assignment edges (if there is any)
   // should precede any assignment edges on the path from X to Y.
   auto NextAssignState = [&](MatchState State) {
-    for (const auto &AssignEdge : NodeInfo->Edges)
-      propagate(FromNode, AssignEdge.Other, State, ReachSet, WorkList);
+    for (unsigned AssignEdge : Nodes.getEdges(ToNode))
+      propagate(FromNode, AssignEdge, State, ReachSet, WorkList);
   };
   auto NextRevAssignState = [&](MatchState State) {
-    for (const auto &RevAssignEdge : NodeInfo->ReverseEdges)
-      propagate(FromNode, RevAssignEdge.Other, State, ReachSet, WorkList);
+    for (unsigned RevAssignEdge : Nodes.getReverseEdges(ToNode))
+      propagate(FromNode, RevAssignEdge, State, ReachSet, WorkList);
   };
   auto NextMemState = [&](MatchState State) {
-    if (auto AliasSet = MemSet.getMemoryAliases(ToNode)) {
-      for (const auto &MemAlias : *AliasSet)
-        propagate(FromNode, MemAlias, State, ReachSet, WorkList);
-    }
+    for (unsigned MemAlias : MemSet.getMemoryAliases(ToNode))
+      propagate(FromNode, MemAlias, State, ReachSet, WorkList);
   };
 
   switch (Item.State) {
@@ -730,20 +805,38 @@ static void processWorkListItem(const WorkListItem &Item, const CFLGraph &Graph,
   }
 }
 
-static AliasAttrMap buildAttrMap(const CFLGraph &Graph,
-                                 const ReachabilitySet &ReachSet) {
-  AliasAttrMap AttrMap;
-  std::vector<InstantiatedValue> WorkList, NextList;
+// Compute the alias pairs of the given nodes and of everything reachable from
+// them.
+static void buildReachability(const NodeNumbering &Nodes,
+                              ArrayRef<unsigned> Roots,
+                              ReachabilitySet &ReachSet, AliasMemSet &MemSet) {
+  std::vector<WorkListItem> WorkList, NextList;
+  initializeWorkList(WorkList, ReachSet, Nodes, Roots);
+  // TODO: make sure we don't stop before the fix point is reached
+  while (!WorkList.empty()) {
+    // Handle the items of one round grouped by their target node, so that
+    // consecutive items touch the same rows of ReachSet and MemSet.
+    llvm::sort(WorkList, [](const WorkListItem &LHS, const WorkListItem &RHS) {
+      return std::tie(LHS.To, LHS.From) < std::tie(RHS.To, RHS.From);
+    });
+    for (const auto &Item : WorkList)
+      processWorkListItem(Item, Nodes, ReachSet, MemSet, NextList);
+
+    NextList.swap(WorkList);
+    NextList.clear();
+  }
+}
+
+// Propagate the AliasAttrs of the given nodes according to ReachSet.
+static void buildAttrMap(const NodeNumbering &Nodes,
+                         const ReachabilitySet &ReachSet,
+                         ArrayRef<unsigned> Roots, AliasAttrMap &AttrMap) {
+  std::vector<unsigned> WorkList, NextList;
 
   // Initialize each node with its original AliasAttrs in CFLGraph
-  for (const auto &Mapping : Graph.value_mappings()) {
-    auto Val = Mapping.first;
-    auto &ValueInfo = Mapping.second;
-    for (unsigned I = 0, E = ValueInfo.getNumLevels(); I < E; ++I) {
-      auto Node = InstantiatedValue{Val, I};
-      AttrMap.add(Node, ValueInfo.getNodeInfoAtLevel(I).Attr);
-      WorkList.push_back(Node);
-    }
+  for (unsigned Node : Roots) {
+    AttrMap.add(Node, Nodes.getAttrs(Node));
+    WorkList.push_back(Node);
   }
 
   while (!WorkList.empty()) {
@@ -753,27 +846,24 @@ static AliasAttrMap buildAttrMap(const CFLGraph &Graph,
         continue;
 
       // Propagate attr on the same level
-      for (const auto &Mapping : ReachSet.reachableValueAliases(Dst)) {
-        auto Src = Mapping.first;
+      ReachSet.forEachValueAlias(Dst, [&](unsigned Src, StateSet) {
         if (AttrMap.add(Src, DstAttr))
           NextList.push_back(Src);
-      }
+      });
 
       // Propagate attr to the levels below
-      auto DstBelow = getNodeBelow(Graph, Dst);
+      auto DstBelow = Nodes.getNodeBelow(Dst);
       while (DstBelow) {
         if (AttrMap.add(*DstBelow, DstAttr)) {
           NextList.push_back(*DstBelow);
           break;
         }
-        DstBelow = getNodeBelow(Graph, *DstBelow);
+        DstBelow = Nodes.getNodeBelow(*DstBelow);
       }
     }
     WorkList.swap(NextList);
     NextList.clear();
   }
-
-  return AttrMap;
 }
 
 CFLAndersAAResult::FunctionInfo
@@ -784,29 +874,150 @@ CFLAndersAAResult::buildInfoFrom(const Function &Fn) {
       const_cast<Function &>(Fn));
   auto &Graph = GraphBuilder.getCFLGraph();
 
+  NodeNumbering Nodes(Graph);
+  ReachabilitySet ReachSet(Nodes.size());
+  AliasMemSet MemSet(Nodes.size());
+
+  std::vector<unsigned> AllNodes(Nodes.size());
+  std::iota(AllNodes.begin(), AllNodes.end(), 0);
+  buildReachability(Nodes, AllNodes, ReachSet, MemSet);
+
+  // Now that we have all the reachability info, propagate AliasAttrs according
+  // to it
+  AliasAttrMap IValueAttrMap(Nodes.size());
+  buildAttrMap(Nodes, ReachSet, AllNodes, IValueAttrMap);
+
+  return FunctionInfo(Fn, GraphBuilder.getReturnValues(), Nodes, ReachSet,
+                      std::move(IValueAttrMap));
+}
+
+/// Alias information for a function that has only been queried a few times.
+/// The CFLGraph is split into weakly connected components up front, and the
+/// alias pairs of a component are only computed once a value in it is queried.
+class CFLAndersAAResult::LazyFunctionInfo {
+  NodeNumbering Nodes;
+
+  /// The component of each node, and the nodes grouped by component.
+  std::vector<unsigned> ComponentOf;
+  std::vector<unsigned> ComponentBegin, ComponentNodes;
+  BitVector Solved;
+
   ReachabilitySet ReachSet;
   AliasMemSet MemSet;
+  AliasAttrMap AttrMap;
 
-  std::vector<WorkListItem> WorkList, NextList;
-  initializeWorkList(WorkList, ReachSet, Graph);
-  // TODO: make sure we don't stop before the fix point is reached
-  while (!WorkList.empty()) {
-    for (const auto &Item : WorkList)
-      processWorkListItem(Item, Graph, ReachSet, MemSet, NextList);
+  unsigned NumQueries = 0;
 
-    NextList.swap(WorkList);
-    NextList.clear();
+  void solveComponentOf(unsigned Node);
+
+public:
+  explicit LazyFunctionInfo(const CFLGraph &);
+
+  /// Count a query. Returns the number of queries so far.
+  unsigned addQuery() { return ++NumQueries; }
+
+  bool mayAlias(const Value *, const Value *);
+};
+
+CFLAndersAAResult::LazyFunctionInfo::LazyFunctionInfo(const CFLGraph &Graph)
+    : Nodes(Graph), ReachSet(Nodes.size()), MemSet(Nodes.size()),
+      AttrMap(Nodes.size()) {
+  // Assignment edges and the link from a node to the node below it are the
+  // only ways a CFL path moves between nodes.
+  unsigned NumNodes = Nodes.size();
+  std::vector<unsigned> Leader(NumNodes);
+  std::iota(Leader.begin(), Leader.end(), 0);
+  auto FindLeader = [&](unsigned Node) {
+    while (Leader[Node] != Node)
+      Node = Leader[Node] = Leader[Leader[Node]];
+    return Node;
+  };
+  auto Unite = [&](unsigned A, unsigned B) {
+    Leader[FindLeader(A)] = FindLeader(B);
+  };
+  for (unsigned Node = 0; Node < NumNodes; ++Node) {
+    for (unsigned Other : Nodes.getEdges(Node))
+      Unite(Node, Other);
+    if (auto Below = Nodes.getNodeBelow(Node))
+      Unite(Node, *Below);
   }
 
-  // Now that we have all the reachability info, propagate AliasAttrs according
-  // to it
-  auto IValueAttrMap = buildAttrMap(Graph, ReachSet);
+  const unsigned NoComponent = ~0U;
+  std::vector<unsigned> LeaderComponent(NumNodes, NoComponent);
+  unsigned NumComponents = 0;
+  ComponentOf.resize(NumNodes);
+  for (unsigned Node = 0; Node < NumNodes; ++Node) {
+    auto &Component = LeaderComponent[FindLeader(Node)];
+    if (Component == NoComponent)
+      Component = NumComponents++;
+    ComponentOf[Node] = Component;
+  }
 
-  return FunctionInfo(Fn, GraphBuilder.getReturnValues(), ReachSet,
-                      std::move(IValueAttrMap));
+  ComponentBegin.assign(NumComponents + 1, 0);
+  for (unsigned Component : ComponentOf)
+    ++ComponentBegin[Component + 1];
+  std::partial_sum(ComponentBegin.begin(), ComponentBegin.end(),
+                   ComponentBegin.begin());
+  std::vector<unsigned> Next(ComponentBegin.begin(), ComponentBegin.end() - 1);
+  ComponentNodes.resize(NumNodes);
+  for (unsigned Node = 0; Node < NumNodes; ++Node)
+    ComponentNodes[Next[ComponentOf[Node]]++] = Node;
+
+  Solved.resize(NumComponents);
+}
+
+void CFLAndersAAResult::LazyFunctionInfo::solveComponentOf(unsigned Node) {
+  unsigned Component = ComponentOf[Node];
+  if (Solved.test(Component))
+    return;
+  Solved.set(Component);
+
+  auto Members = makeArrayRef(ComponentNodes)
+                     .slice(ComponentBegin[Component],
+                            ComponentBegin[Component + 1] -
+                                ComponentBegin[Component]);
+  buildReachability(Nodes, Members, ReachSet, MemSet);
+  buildAttrMap(Nodes, ReachSet, Members, AttrMap);
+}
+
+bool CFLAndersAAResult::LazyFunctionInfo::mayAlias(const Value *LHS,
+                                                   const Value *RHS) {
+  // Be conservative about values created after the graph was built, like
+  // FunctionInfo::mayAlias.
+  auto NodeA = Nodes.lookup(InstantiatedValue{const_cast<Value *>(LHS), 0});
+  auto NodeB = Nodes.lookup(InstantiatedValue{const_cast<Value *>(RHS), 0});
+  if (!NodeA || !NodeB)
+    return true;
+
+  solveComponentOf(*NodeA);
+  solveComponentOf(*NodeB);
+  if (auto Result =
+          mayAliasFromAttrs(AttrMap.getAttrs(*NodeA), AttrMap.getAttrs(*NodeB)))
+    return *Result;
+
+  // FunctionInfo conservatively treats every offset as unknown, so any alias
+  // pair makes the query MayAlias.
+  return ReachSet.reaches(*NodeB, *NodeA);
+}
+
+std::unique_ptr<CFLAndersAAResult::LazyFunctionInfo>
+CFLAndersAAResult::buildLazyInfoFrom(const Function &Fn) {
+  // Mark Fn as being built while its graph is built, so that recursive calls
+  // see no summary for it, just as they would during scan.
+  Cache.insert(std::make_pair(&Fn, Optional<FunctionInfo>()));
+  CFLGraphBuilder<CFLAndersAAResult> GraphBuilder(
+      *this, TLI,
+      // Cast away the constness here due to GraphBuilder's API requirement
+      const_cast<Function &>(Fn));
+  Cache.erase(&Fn);
+
+  Handles.emplace_front(const_cast<Function *>(&Fn), this);
+  return llvm::make_unique<LazyFunctionInfo>(GraphBuilder.getCFLGraph());
 }
 
 void CFLAndersAAResult::scan(const Function &Fn) {
+  LazyCache.erase(&Fn);
+
   auto InsertPair = Cache.insert(std::make_pair(&Fn, Optional<FunctionInfo>()));
   (void)InsertPair;
   assert(InsertPair.second &&
@@ -820,7 +1031,10 @@ void CFLAndersAAResult::scan(const Function &Fn) {
   Handles.emplace_front(const_cast<Function *>(&Fn), this);
 }
 
-void CFLAndersAAResult::evict(const Function *Fn) { Cache.erase(Fn); }
+void CFLAndersAAResult::evict(const Function *Fn) {
+  Cache.erase(Fn);
+  LazyCache.erase(Fn);
+}
 
 const Optional<CFLAndersAAResult::FunctionInfo> &
 CFLAndersAAResult::ensureCached(const Function &Fn) {
@@ -866,6 +1080,19 @@ AliasResult CFLAndersAAResult::query(const MemoryLocation &LocA,
   }
 
   assert(Fn != nullptr);
+
+  // Answer the first queries on a function that hasn't been scanned yet on
+  // demand.
+  if (DemandQueryLimit && !Cache.count(Fn)) {
+    auto Itr = LazyCache.find(Fn);
+    if (Itr == LazyCache.end()) {
+      auto LazyInfo = buildLazyInfoFrom(*Fn);
+      Itr = LazyCache.insert(std::make_pair(Fn, std::move(LazyInfo))).first;
+    }
+    if (Itr->second->addQuery() <= DemandQueryLimit)
+      return Itr->second->mayAlias(ValA, ValB) ? MayAlias : NoAlias;
+  }
+
   auto &FunInfo = ensureCached(*Fn);
 
   // AliasMap lookup
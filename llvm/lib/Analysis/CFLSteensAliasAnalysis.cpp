@@ -26,6 +26,11 @@
 // in order to transform the graph into sets of variables that may alias in
 // ~nlogn time (n = number of variables), which makes queries take constant
 // time.
+//
+// CFLSteensModuleAA instead builds a single set of StratifiedSets for the whole
+// module, unifying actual arguments with formals and call results with
+// returned values at every direct call. Values from different functions can
+// then be compared, at near-linear cost in the size of the module.
 //===----------------------------------------------------------------------===//
 
 // N.B. AliasAnalysis as a whole is phrased as a FunctionPass at the moment, and
@@ -39,11 +44,16 @@
 #include "CFLGraph.h"
 #include "StratifiedSets.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Pass.h"
@@ -179,13 +189,29 @@ CFLSteensAAResult::FunctionInfo::FunctionInfo(
   }
 }
 
-// Builds the graph + StratifiedSets for a function.
-CFLSteensAAResult::FunctionInfo CFLSteensAAResult::buildSetsFrom(Function *Fn) {
-  CFLGraphBuilder<CFLSteensAAResult> GraphBuilder(*this, TLI, *Fn);
-  StratifiedSetsBuilder<InstantiatedValue> SetBuilder;
+/// Adds all CFLGraph nodes and edges of a function to \p SetBuilder.
+/// Formals of the functions in \p KnownCallers drop their argument and
+/// caller attributes: every value reaching them comes from a call site that
+/// is unified with them.
+static void
+addGraphToSets(const CFLGraph &Graph,
+               StratifiedSetsBuilder<InstantiatedValue> &SetBuilder,
+               const SmallPtrSetImpl<const Function *> *KnownCallers = nullptr) {
+  auto GetAttrs = [&](Value *Val, unsigned Level, AliasAttrs Attr) {
+    auto *Arg = dyn_cast<Argument>(Val);
+    if (!KnownCallers || !Arg || !KnownCallers->count(Arg->getParent()))
+      return Attr;
+    if (Level == 0) {
+      auto ArgAttr = getGlobalOrArgAttrFromValue(*Arg);
+      if (isGlobalOrArgAttr(ArgAttr))
+        Attr &= ~ArgAttr;
+    } else if (Level == 1) {
+      Attr &= ~getAttrCaller();
+    }
+    return Attr;
+  };
 
   // Add all CFLGraph nodes and all Dereference edges to StratifiedSets
-  auto &Graph = GraphBuilder.getCFLGraph();
   for (const auto &Mapping : Graph.value_mappings()) {
     auto Val = Mapping.first;
     if (canSkipAddingToSets(Val))
@@ -194,12 +220,14 @@ CFLSteensAAResult::FunctionInfo CFLSteensAAResult::buildSetsFrom(Function *Fn) {
 
     assert(ValueInfo.getNumLevels() > 0);
     SetBuilder.add(InstantiatedValue{Val, 0});
-    SetBuilder.noteAttributes(InstantiatedValue{Val, 0},
-                              ValueInfo.getNodeInfoAtLevel(0).Attr);
+    SetBuilder.noteAttributes(
+        InstantiatedValue{Val, 0},
+        GetAttrs(Val, 0, ValueInfo.getNodeInfoAtLevel(0).Attr));
     for (unsigned I = 0, E = ValueInfo.getNumLevels() - 1; I < E; ++I) {
       SetBuilder.add(InstantiatedValue{Val, I + 1});
-      SetBuilder.noteAttributes(InstantiatedValue{Val, I + 1},
-                                ValueInfo.getNodeInfoAtLevel(I + 1).Attr);
+      SetBuilder.noteAttributes(
+          InstantiatedValue{Val, I + 1},
+          GetAttrs(Val, I + 1, ValueInfo.getNodeInfoAtLevel(I + 1).Attr));
       SetBuilder.addBelow(InstantiatedValue{Val, I},
                           InstantiatedValue{Val, I + 1});
     }
@@ -218,7 +246,13 @@ CFLSteensAAResult::FunctionInfo CFLSteensAAResult::buildSetsFrom(Function *Fn) {
         SetBuilder.addWith(Src, Edge.Other);
     }
   }
+}
 
+// Builds the graph + StratifiedSets for a function.
+CFLSteensAAResult::FunctionInfo CFLSteensAAResult::buildSetsFrom(Function *Fn) {
+  CFLGraphBuilder<CFLSteensAAResult> GraphBuilder(*this, TLI, *Fn);
+  StratifiedSetsBuilder<InstantiatedValue> SetBuilder;
+  addGraphToSets(GraphBuilder.getCFLGraph(), SetBuilder);
   return FunctionInfo(*Fn, GraphBuilder.getReturnValues(), SetBuilder.build());
 }
 
@@ -261,6 +295,45 @@ const AliasSummary *CFLSteensAAResult::getAliasSummary(Function &Fn) {
     return nullptr;
 }
 
+/// Answers an alias query between two values from the sets they were
+/// unified into.
+static AliasResult
+aliasFromSets(const StratifiedSets<InstantiatedValue> &Sets, Value *ValA,
+              Value *ValB) {
+  auto MaybeA = Sets.find(InstantiatedValue{ValA, 0});
+  if (!MaybeA.hasValue())
+    return MayAlias;
+
+  auto MaybeB = Sets.find(InstantiatedValue{ValB, 0});
+  if (!MaybeB.hasValue())
+    return MayAlias;
+
+  auto SetA = *MaybeA;
+  auto SetB = *MaybeB;
+  auto AttrsA = Sets.getLink(SetA.Index).Attrs;
+  auto AttrsB = Sets.getLink(SetB.Index).Attrs;
+
+  // If both values are local (meaning the corresponding set has attribute
+  // AttrNone or AttrEscaped), then we know that CFLSteensAA fully models them:
+  // they may-alias each other if and only if they are in the same set.
+  // If at least one value is non-local (meaning it either is global/argument or
+  // it comes from unknown sources like integer cast), the situation becomes a
+  // bit more interesting. We follow three general rules described below:
+  // - Non-local values may alias each other
+  // - AttrNone values do not alias any non-local values
+  // - AttrEscaped do not alias globals/arguments, but they may alias
+  // AttrUnknown values
+  if (SetA.Index == SetB.Index)
+    return MayAlias;
+  if (AttrsA.none() || AttrsB.none())
+    return NoAlias;
+  if (hasUnknownOrCallerAttr(AttrsA) || hasUnknownOrCallerAttr(AttrsB))
+    return MayAlias;
+  if (isGlobalOrArgAttr(AttrsA) && isGlobalOrArgAttr(AttrsB))
+    return MayAlias;
+  return NoAlias;
+}
+
 AliasResult CFLSteensAAResult::query(const MemoryLocation &LocA,
                                      const MemoryLocation &LocB) {
   auto *ValA = const_cast<Value *>(LocA.Ptr);
@@ -293,39 +366,287 @@ AliasResult CFLSteensAAResult::query(const MemoryLocation &LocA,
   auto &MaybeInfo = ensureCached(Fn);
   assert(MaybeInfo.hasValue());
 
-  auto &Sets = MaybeInfo->getStratifiedSets();
-  auto MaybeA = Sets.find(InstantiatedValue{ValA, 0});
-  if (!MaybeA.hasValue())
-    return MayAlias;
+  return aliasFromSets(MaybeInfo->getStratifiedSets(), ValA, ValB);
+}
 
-  auto MaybeB = Sets.find(InstantiatedValue{ValB, 0});
-  if (!MaybeB.hasValue())
-    return MayAlias;
 
-  auto SetA = *MaybeA;
-  auto SetB = *MaybeB;
-  auto AttrsA = Sets.getLink(SetA.Index).Attrs;
-  auto AttrsB = Sets.getLink(SetB.Index).Attrs;
+//===----------------------------------------------------------------------===//
+// Module-wide unification
+//===----------------------------------------------------------------------===//
 
-  // If both values are local (meaning the corresponding set has attribute
-  // AttrNone or AttrEscaped), then we know that CFLSteensAA fully models them:
-  // they may-alias each other if and only if they are in the same set.
-  // If at least one value is non-local (meaning it either is global/argument or
-  // it comes from unknown sources like integer cast), the situation becomes a
-  // bit more interesting. We follow three general rules described below:
-  // - Non-local values may alias each other
-  // - AttrNone values do not alias any non-local values
-  // - AttrEscaped do not alias globals/arguments, but they may alias
-  // AttrUnknown values
-  if (SetA.Index == SetB.Index)
-    return MayAlias;
-  if (AttrsA.none() || AttrsB.none())
+namespace {
+
+/// Summary provider used while building the graphs of a whole module. Every
+/// call CFLGraphBuilder would instantiate a summary for is unified with its
+/// callee by the module builder instead, so an empty summary suffices.
+struct EmptySummaries {
+  AliasSummary Empty;
+
+  const AliasSummary *getAliasSummary(Function &) { return &Empty; }
+};
+
+} // end anonymous namespace
+
+/// The module-wide sets, along with the values they no longer describe.
+class CFLSteensModuleAAResult::ModuleInfo {
+public:
+  /// Evicts its value once the value is deleted or replaced, and the value
+  /// replacing it as well.
+  class ValueHandle final : public CallbackVH {
+    ModuleInfo *Info;
+
+  public:
+    ValueHandle(Value *Val, ModuleInfo *Info) : CallbackVH(Val), Info(Info) {}
+
+    void deleted() override {
+      Info->Evicted.insert(getValPtr());
+      setValPtr(nullptr);
+    }
+    void allUsesReplacedWith(Value *New) override {
+      Info->Evicted.insert(getValPtr());
+      Info->Evicted.insert(New);
+    }
+  };
+
+  StratifiedSets<InstantiatedValue> Sets;
+  DenseSet<const Value *> Evicted;
+  std::forward_list<ValueHandle> Handles;
+
+  explicit ModuleInfo(StratifiedSets<InstantiatedValue> S)
+      : Sets(std::move(S)) {}
+};
+
+/// Determines whether \p Call is resolved by unifying it with its callee. This
+/// matches the calls CFLGraphBuilder would instantiate a summary for.
+static bool isUnifiableCall(const CallBase &Call, const Function &Callee) {
+  return Call.arg_size() <= MaxSupportedArgsInSummary &&
+         Callee.hasExactDefinition() && !Callee.isVarArg();
+}
+
+/// Determines whether every caller of \p Fn is a direct call in this module
+/// that is unified with \p Fn's formals.
+static bool hasOnlyKnownCallers(const Function &Fn) {
+  if (!Fn.hasLocalLinkage() || !Fn.hasExactDefinition() || Fn.isVarArg())
+    return false;
+
+  for (const Use &U : Fn.uses()) {
+    auto *Call = dyn_cast<CallBase>(U.getUser());
+    if (!Call || !Call->isCallee(&U) || !isUnifiableCall(*Call, Fn))
+      return false;
+  }
+  return true;
+}
+
+/// Determines whether \p Ty is a first-class aggregate with pointer fields,
+/// such as the slices, strings and interfaces Go passes by value. CFLGraph
+/// has no nodes for these.
+static bool isAggregateWithPointers(Type *Ty) {
+  return Ty->isAggregateType() &&
+         any_of(Ty->subtypes(), [](Type *T) { return T->isPointerTy(); });
+}
+
+/// The pointer values of an aggregate, by field.
+using AggregateFields = DenseMap<unsigned, SmallVector<Value *, 2>>;
+
+/// Collects the pointers inserted into the fields of \p Agg by the
+/// insertvalues that built it. Returns false if that doesn't account for
+/// every field, e.g. because the aggregate was loaded from memory.
+static bool getInsertedPointers(Value *Agg, AggregateFields &Fields) {
+  SmallDenseSet<unsigned, 4> Seen;
+  auto AddField = [&](unsigned Index, Value *Val) {
+    // A later insertvalue overwrites what an earlier one put in the field.
+    if (Seen.insert(Index).second && Val->getType()->isPointerTy())
+      Fields[Index].push_back(Val);
+  };
+  while (auto *Insert = dyn_cast<InsertValueInst>(Agg)) {
+    if (Insert->getNumIndices() != 1)
+      return false;
+    AddField(Insert->getIndices()[0], Insert->getInsertedValueOperand());
+    Agg = Insert->getAggregateOperand();
+  }
+  if (auto *C = dyn_cast<ConstantAggregate>(Agg)) {
+    for (unsigned I = 0, E = C->getNumOperands(); I != E; ++I)
+      AddField(I, C->getOperand(I));
+    return true;
+  }
+  return isa<UndefValue>(Agg) || isa<ConstantAggregateZero>(Agg);
+}
+
+/// Collects the extractvalues of the pointer fields of \p Formal. Returns
+/// false if the formal has other uses, through which its fields may reach
+/// values the sets don't relate to it.
+static bool getExtractedPointers(Argument &Formal, AggregateFields &Fields) {
+  bool OnlyExtracted = true;
+  for (User *U : Formal.users()) {
+    auto *Extract = dyn_cast<ExtractValueInst>(U);
+    if (!Extract || Extract->getNumIndices() != 1 ||
+        isAggregateWithPointers(Extract->getType()) ||
+        Extract->getType()->isVectorTy()) {
+      OnlyExtracted = false;
+      continue;
+    }
+    if (Extract->getType()->isPointerTy())
+      Fields[Extract->getIndices()[0]].push_back(Extract);
+  }
+  return OnlyExtracted;
+}
+
+CFLSteensModuleAAResult::CFLSteensModuleAAResult(
+    std::unique_ptr<ModuleInfo> Info)
+    : AAResultBase(), Info(std::move(Info)) {}
+CFLSteensModuleAAResult::CFLSteensModuleAAResult(CFLSteensModuleAAResult &&Arg)
+    : AAResultBase(std::move(Arg)), Info(std::move(Arg.Info)) {}
+CFLSteensModuleAAResult::~CFLSteensModuleAAResult() = default;
+
+CFLSteensModuleAAResult
+CFLSteensModuleAAResult::analyzeModule(Module &M,
+                                       const TargetLibraryInfo &TLI) {
+  SmallPtrSet<const Function *, 16> KnownCallers;
+  for (auto &Fn : M)
+    if (hasOnlyKnownCallers(Fn))
+      KnownCallers.insert(&Fn);
+
+  EmptySummaries Summaries;
+  StratifiedSetsBuilder<InstantiatedValue> SetBuilder;
+  DenseMap<const Function *, SmallVector<Value *, 4>> ReturnValues;
+  DenseSet<Value *> Tracked;
+  DenseMap<const Argument *, AggregateFields> AggregateFormals;
+  SmallPtrSet<const Argument *, 4> OpaqueFormals;
+  for (auto &Fn : M) {
+    if (Fn.isDeclaration())
+      continue;
+    CFLGraphBuilder<EmptySummaries> GraphBuilder(Summaries, TLI, Fn);
+    addGraphToSets(GraphBuilder.getCFLGraph(), SetBuilder, &KnownCallers);
+    ReturnValues[&Fn] = GraphBuilder.getReturnValues();
+    for (const auto &Mapping : GraphBuilder.getCFLGraph().value_mappings())
+      Tracked.insert(Mapping.first);
+
+    for (auto &Formal : Fn.args())
+      if (isAggregateWithPointers(Formal.getType()) &&
+          !getExtractedPointers(Formal, AggregateFormals[&Formal]))
+        OpaqueFormals.insert(&Formal);
+  }
+
+  auto Unify = [&](Value *A, Value *B) {
+    InstantiatedValue IA{A, 0}, IB{B, 0};
+    if (SetBuilder.has(IA) && SetBuilder.has(IB))
+      SetBuilder.addWith(IA, IB);
+  };
+
+  // Puts \p Val in the sets with \p Attr, and what it points to with
+  // \p BelowAttr.
+  auto AddWithAttrs = [&](Value *Val, AliasAttrs Attr, AliasAttrs BelowAttr) {
+    InstantiatedValue IV{Val, 0}, Below{Val, 1};
+    SetBuilder.add(IV);
+    SetBuilder.noteAttributes(IV, Attr);
+    SetBuilder.addBelow(IV, Below);
+    SetBuilder.noteAttributes(Below, BelowAttr);
+    Tracked.insert(Val);
+  };
+
+  // The pointers in an aggregate passed where the sets don't follow escape,
+  // as they would if passed to an opaque call on their own.
+  auto EscapeFields = [&](const AggregateFields &Fields) {
+    for (auto &Field : Fields)
+      for (Value *Val : Field.second)
+        if (!isa<Constant>(Val))
+          AddWithAttrs(Val, getAttrEscaped(), getAttrUnknown());
+  };
+
+  for (auto &Fn : M) {
+    for (auto &Inst : instructions(Fn)) {
+      auto *Call = dyn_cast<CallBase>(&Inst);
+      if (!Call)
+        continue;
+      auto *Callee = Call->getCalledFunction();
+      if (!Callee || !isUnifiableCall(*Call, *Callee)) {
+        if (Call->onlyReadsMemory())
+          continue;
+        for (Value *Actual : Call->args())
+          if (isAggregateWithPointers(Actual->getType())) {
+            AggregateFields Inserted;
+            getInsertedPointers(Actual, Inserted);
+            EscapeFields(Inserted);
+          }
+        continue;
+      }
+
+      for (auto &Formal : Callee->args()) {
+        Value *Actual = Call->getArgOperand(Formal.getArgNo());
+        if (Formal.getType()->isPointerTy()) {
+          Unify(Actual, &Formal);
+          continue;
+        }
+        if (!isAggregateWithPointers(Formal.getType()))
+          continue;
+
+        // Unify each pointer put into the aggregate with the values the
+        // callee takes out of that field.
+        AggregateFields Inserted;
+        bool Resolved = getInsertedPointers(Actual, Inserted) &&
+                        !OpaqueFormals.count(&Formal);
+        for (auto &Field : AggregateFormals[&Formal]) {
+          auto It = Inserted.find(Field.first);
+          if (It == Inserted.end())
+            continue;
+          Value *Val = It->second.front();
+          if (isa<ConstantPointerNull>(Val) || isa<UndefValue>(Val))
+            continue;
+          if (!SetBuilder.has(InstantiatedValue{Val, 0})) {
+            Resolved = false;
+            continue;
+          }
+          for (Value *Extract : Field.second) {
+            SetBuilder.addWith(InstantiatedValue{Val, 0},
+                               InstantiatedValue{Extract, 0});
+            Tracked.insert(Extract);
+          }
+        }
+        if (!Resolved) {
+          EscapeFields(Inserted);
+          OpaqueFormals.insert(&Formal);
+        }
+      }
+
+      if (Call->getType()->isPointerTy())
+        for (auto *RetVal : ReturnValues[Callee])
+          Unify(Call, RetVal);
+    }
+  }
+
+  // The fields of an aggregate formal come from an unknown caller like a
+  // pointer formal would, unless every caller is known and passes an
+  // aggregate whose fields were unified with them above.
+  for (auto &Formal : AggregateFormals) {
+    const Argument *Arg = Formal.first;
+    if (KnownCallers.count(Arg->getParent()) && !OpaqueFormals.count(Arg))
+      continue;
+    for (auto &Field : Formal.second)
+      for (Value *Extract : Field.second)
+        AddWithAttrs(Extract, getAttrArg(Arg->getArgNo()),
+                     getAttrCaller());
+  }
+
+  auto NewInfo = llvm::make_unique<ModuleInfo>(SetBuilder.build());
+  for (Value *Val : Tracked)
+    NewInfo->Handles.emplace_front(Val, NewInfo.get());
+  return CFLSteensModuleAAResult(std::move(NewInfo));
+}
+
+AliasResult CFLSteensModuleAAResult::query(const MemoryLocation &LocA,
+                                           const MemoryLocation &LocB) {
+  auto *ValA = const_cast<Value *>(LocA.Ptr);
+  auto *ValB = const_cast<Value *>(LocB.Ptr);
+
+  if (!ValA->getType()->isPointerTy() || !ValB->getType()->isPointerTy())
     return NoAlias;
-  if (hasUnknownOrCallerAttr(AttrsA) || hasUnknownOrCallerAttr(AttrsB))
-    return MayAlias;
-  if (isGlobalOrArgAttr(AttrsA) && isGlobalOrArgAttr(AttrsB))
+
+  // Values that were deleted or replaced since the sets were built are no
+  // longer described by them, nor are values that replaced them.
+  if (Info->Evicted.count(ValA) || Info->Evicted.count(ValB))
     return MayAlias;
-  return NoAlias;
+
+  return aliasFromSets(Info->Sets, ValA, ValB);
 }
 
 AnalysisKey CFLSteensAA::Key;
@@ -355,3 +676,45 @@ void CFLSteensAAWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequired<TargetLibraryInfoWrapperPass>();
 }
+
+AnalysisKey CFLSteensModuleAA::Key;
+
+CFLSteensModuleAAResult CFLSteensModuleAA::run(Module &M,
+                                               ModuleAnalysisManager &AM) {
+  return CFLSteensModuleAAResult::analyzeModule(
+      M, AM.getResult<TargetLibraryAnalysis>(M));
+}
+
+char CFLSteensModuleAAWrapperPass::ID = 0;
+INITIALIZE_PASS_BEGIN(CFLSteensModuleAAWrapperPass, "cfl-steens-module-aa",
+                      "Module-Wide Unification-Based CFL Alias Analysis", false,
+                      true)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_END(CFLSteensModuleAAWrapperPass, "cfl-steens-module-aa",
+                    "Module-Wide Unification-Based CFL Alias Analysis", false,
+                    true)
+
+ModulePass *llvm::createCFLSteensModuleAAWrapperPass() {
+  return new CFLSteensModuleAAWrapperPass();
+}
+
+CFLSteensModuleAAWrapperPass::CFLSteensModuleAAWrapperPass() : ModulePass(ID) {
+  initializeCFLSteensModuleAAWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+bool CFLSteensModuleAAWrapperPass::runOnModule(Module &M) {
+  Result.reset(new CFLSteensModuleAAResult(
+      CFLSteensModuleAAResult::analyzeModule(
+          M, getAnalysis<TargetLibraryInfoWrapperPass>().getTLI())));
+  return false;
+}
+
+bool CFLSteensModuleAAWrapperPass::doFinalization(Module &M) {
+  Result.reset();
+  return false;
+}
+
+void CFLSteensModuleAAWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<TargetLibraryInfoWrapperPass>();
+}
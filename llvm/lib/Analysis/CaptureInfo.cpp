@@ -0,0 +1,220 @@
+//===- CaptureInfo.cpp - Cached Capture Information -----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/CaptureInfo.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/OrderedBasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+// The uses of each pointer are only walked once, so the walk can afford a much
+// higher limit than the per-query default of PointerMayBeCaptured.
+static cl::opt<unsigned> MaxUsesToExplore(
+    "capture-info-max-uses", cl::init(1000), cl::Hidden,
+    cl::desc("Maximum number of uses CaptureInfo explores for one pointer"));
+
+/// The first use of V, which changes whenever a use is added to V.
+static const Use *getFirstUse(const Value *V) {
+  return V->use_empty() ? nullptr : &*V->use_begin();
+}
+
+namespace {
+  /// Records every instruction that may capture the pointer instead of
+  /// stopping at the first one, and the values whose uses were looked at.
+  struct CapturePointTracker : public CaptureTracker {
+    CapturePointTracker(
+        bool StoreCaptures, SmallVectorImpl<const Instruction *> &CapturePoints,
+        SmallVectorImpl<std::pair<const Value *, const Use *>> &WalkedValues)
+      : StoreCaptures(StoreCaptures), CapturePoints(CapturePoints),
+        WalkedValues(WalkedValues), TooManyUses(false) {}
+
+    void tooManyUses() override { TooManyUses = true; }
+
+    bool captured(const Use *U) override {
+      CapturePoints.push_back(cast<Instruction>(U->getUser()));
+      return false;
+    }
+
+    bool followStores() override { return !StoreCaptures; }
+
+    void exploreUses(const Value *V) override {
+      WalkedValues.push_back({V, getFirstUse(V)});
+    }
+
+    bool StoreCaptures;
+    SmallVectorImpl<const Instruction *> &CapturePoints;
+    SmallVectorImpl<std::pair<const Value *, const Use *>> &WalkedValues;
+
+    bool TooManyUses;
+  };
+}
+
+void CaptureInfo::CaptureInfoCallbackVH::deleted() {
+  CI->invalidateValue(getValPtr());
+}
+
+void CaptureInfo::CaptureInfoCallbackVH::allUsesReplacedWith(Value *) {
+  // The uses of the old value now belong to the new one, so neither the old
+  // value's capture points nor the objects it captures are accurate anymore.
+  CI->invalidateValue(getValPtr());
+}
+
+bool CaptureInfo::invalidate(Function &, const PreservedAnalyses &PA,
+                             FunctionAnalysisManager::Invalidator &) {
+  // CaptureInfo is invalidated if it isn't preserved.
+  auto PAC = PA.getChecker<CaptureInfoAnalysis>();
+  return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Function>>());
+}
+
+void CaptureInfo::addDependency(const Value *V, const Value *Object) {
+  TrackedValues.insert(CaptureInfoCallbackVH(const_cast<Value *>(V), this));
+  auto &Objects = DependentObjects[V];
+  if (!is_contained(Objects, Object))
+    Objects.push_back(Object);
+}
+
+const CaptureInfo::ObjectInfo &
+CaptureInfo::getObjectInfo(const Value *V, bool StoreCaptures) {
+  auto Inserted = Objects.try_emplace(ObjectKey(V, StoreCaptures));
+  ObjectInfo &Info = Inserted.first->second;
+  if (!Inserted.second) {
+    if (all_of(Info.WalkedValues,
+               [](const std::pair<const Value *, const Use *> &Walked) {
+                 return getFirstUse(Walked.first) == Walked.second;
+               }))
+      return Info;
+    Info = ObjectInfo();
+  }
+
+  CapturePointTracker Tracker(StoreCaptures, Info.CapturePoints,
+                              Info.WalkedValues);
+  PointerMayBeCaptured(V, &Tracker, MaxUsesToExplore);
+  Info.TooManyUses = Tracker.TooManyUses;
+
+  TrackedValues.insert(CaptureInfoCallbackVH(const_cast<Value *>(V), this));
+  for (const Instruction *I : Info.CapturePoints)
+    addDependency(I, V);
+  for (const auto &Walked : Info.WalkedValues)
+    addDependency(Walked.first, V);
+  return Info;
+}
+
+bool CaptureInfo::isAvailable() const {
+  return !LegacyPass ||
+         LegacyPass->getResolver()->getAnalysisIfAvailable(
+             &CaptureInfoWrapperPass::ID, true) == LegacyPass;
+}
+
+bool CaptureInfo::isCaptured(const Value *V, bool ReturnCaptures,
+                             bool StoreCaptures) {
+  assert(!isa<GlobalValue>(V) &&
+         "It doesn't make sense to ask whether a global is captured.");
+  if (isNoEscapeAllocation(V))
+    return false;
+  if (!isAvailable())
+    return PointerMayBeCaptured(V, ReturnCaptures, StoreCaptures);
+
+  const ObjectInfo &Info = getObjectInfo(V, StoreCaptures);
+  if (Info.TooManyUses)
+    return true;
+  for (const Instruction *I : Info.CapturePoints)
+    if (ReturnCaptures || !isa<ReturnInst>(I))
+      return true;
+  return false;
+}
+
+bool CaptureInfo::isCapturedBefore(const Value *V, bool ReturnCaptures,
+                                   bool StoreCaptures, const Instruction *I,
+                                   const DominatorTree *DT, bool IncludeI,
+                                   OrderedBasicBlock *OBB) {
+  assert(!isa<GlobalValue>(V) &&
+         "It doesn't make sense to ask whether a global is captured.");
+  if (!DT)
+    return isCaptured(V, ReturnCaptures, StoreCaptures);
+  if (isNoEscapeAllocation(V))
+    return false;
+  if (!isAvailable())
+    return PointerMayBeCapturedBefore(V, ReturnCaptures, StoreCaptures, I, DT,
+                                      IncludeI, OBB);
+
+  const ObjectInfo &Info = getObjectInfo(V, StoreCaptures);
+  if (Info.TooManyUses)
+    return true;
+  std::unique_ptr<OrderedBasicBlock> NewOBB;
+  for (const Instruction *CapturePoint : Info.CapturePoints) {
+    if (!ReturnCaptures && isa<ReturnInst>(CapturePoint))
+      continue;
+    if (!OBB && CapturePoint->getParent() == I->getParent()) {
+      NewOBB = llvm::make_unique<OrderedBasicBlock>(I->getParent());
+      OBB = NewOBB.get();
+    }
+    if (mayCaptureBefore(CapturePoint, I, DT, IncludeI, OBB))
+      return true;
+  }
+  return false;
+}
+
+void CaptureInfo::invalidateValue(const Value *V) {
+  Objects.erase(ObjectKey(V, false));
+  Objects.erase(ObjectKey(V, true));
+
+  auto It = DependentObjects.find(V);
+  if (It != DependentObjects.end()) {
+    for (const Value *Object : It->second) {
+      Objects.erase(ObjectKey(Object, false));
+      Objects.erase(ObjectKey(Object, true));
+    }
+    DependentObjects.erase(It);
+  }
+
+  auto TrackedIt = TrackedValues.find_as(V);
+  if (TrackedIt != TrackedValues.end())
+    TrackedValues.erase(TrackedIt);
+}
+
+void CaptureInfo::releaseMemory() {
+  Objects.clear();
+  DependentObjects.clear();
+  TrackedValues.clear();
+}
+
+AnalysisKey CaptureInfoAnalysis::Key;
+CaptureInfo CaptureInfoAnalysis::run(Function &F, FunctionAnalysisManager &) {
+  return CaptureInfo(F);
+}
+
+CaptureInfoWrapperPass::CaptureInfoWrapperPass() : FunctionPass(ID) {
+  initializeCaptureInfoWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+bool CaptureInfoWrapperPass::runOnFunction(Function &F) {
+  // Keep the same object alive across runs, BasicAA results that were
+  // preserved while this analysis wasn't may still point at it.
+  if (Result)
+    Result->releaseMemory();
+  else
+    Result.reset(new CaptureInfo(F));
+  Result->setLegacyPass(this);
+  return false;
+}
+
+void CaptureInfoWrapperPass::releaseMemory() {
+  Result->releaseMemory();
+}
+
+void CaptureInfoWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+}
+
+char CaptureInfoWrapperPass::ID = 0;
+
+INITIALIZE_PASS(CaptureInfoWrapperPass, "capture-info",
+                "Capture Information Analysis", false, true)
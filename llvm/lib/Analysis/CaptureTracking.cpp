@@ -16,6 +16,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/AliasAnalysis.h"
@@ -26,6 +27,7 @@
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
 
 using namespace llvm;
 
@@ -33,10 +35,67 @@ CaptureTracker::~CaptureTracker() {}
 
 bool CaptureTracker::shouldExplore(const Use *U) { return true; }
 
+bool CaptureTracker::followStores() { return false; }
+
+void CaptureTracker::exploreUses(const Value *V) {}
+
+/// Return true if I can only run after BeforeHere and never reaches it again,
+/// so that neither I nor the values derived from it can capture the pointer
+/// before BeforeHere.
+static bool isSafeToPrune(Instruction *I, const Instruction *BeforeHere,
+                          const DominatorTree *DT, OrderedBasicBlock *OrderedBB) {
+  BasicBlock *BB = I->getParent();
+  // We explore this usage only if the usage can reach "BeforeHere".
+  // If use is not reachable from entry, there is no need to explore.
+  if (BeforeHere != I && !DT->isReachableFromEntry(BB))
+    return true;
+
+  // Compute the case where both instructions are inside the same basic
+  // block. Since instructions in the same BB as BeforeHere are numbered in
+  // 'OrderedBB', avoid using 'dominates' and 'isPotentiallyReachable'
+  // which are very expensive for large basic blocks.
+  if (BB == BeforeHere->getParent()) {
+    // 'I' dominates 'BeforeHere' => not safe to prune.
+    //
+    // The value defined by an invoke dominates an instruction only
+    // if it dominates every instruction in UseBB. A PHI is dominated only
+    // if the instruction dominates every possible use in the UseBB. Since
+    // UseBB == BB, avoid pruning.
+    if (isa<InvokeInst>(BeforeHere) || isa<PHINode>(I) || I == BeforeHere)
+      return false;
+    if (!OrderedBB->dominates(BeforeHere, I))
+      return false;
+
+    // 'BeforeHere' comes before 'I', it's safe to prune if we also
+    // guarantee that 'I' never reaches 'BeforeHere' through a back-edge or
+    // by its successors, i.e, prune if:
+    //
+    //  (1) BB is an entry block or have no successors.
+    //  (2) There's no path coming back through BB successors.
+    if (BB == &BB->getParent()->getEntryBlock() ||
+        !BB->getTerminator()->getNumSuccessors())
+      return true;
+
+    SmallVector<BasicBlock*, 32> Worklist;
+    Worklist.append(succ_begin(BB), succ_end(BB));
+    return !isPotentiallyReachableFromMany(Worklist, BB, nullptr, DT);
+  }
+
+  // If the value is defined in the same basic block as use and BeforeHere,
+  // there is no need to explore the use if BeforeHere dominates use.
+  // Check whether there is a path from I to BeforeHere.
+  if (BeforeHere != I && DT->dominates(BeforeHere, I) &&
+      !isPotentiallyReachable(I, BeforeHere, nullptr, DT))
+    return true;
+
+  return false;
+}
+
 namespace {
   struct SimpleCaptureTracker : public CaptureTracker {
-    explicit SimpleCaptureTracker(bool ReturnCaptures)
-      : ReturnCaptures(ReturnCaptures), Captured(false) {}
+    SimpleCaptureTracker(bool ReturnCaptures, bool StoreCaptures)
+      : ReturnCaptures(ReturnCaptures), StoreCaptures(StoreCaptures),
+        Captured(false) {}
 
     void tooManyUses() override { Captured = true; }
 
@@ -48,7 +107,10 @@ namespace {
       return true;
     }
 
+    bool followStores() override { return !StoreCaptures; }
+
     bool ReturnCaptures;
+    bool StoreCaptures;
 
     bool Captured;
   };
@@ -59,68 +121,22 @@ namespace {
   /// as the given instruction and the use.
   struct CapturesBefore : public CaptureTracker {
 
-    CapturesBefore(bool ReturnCaptures, const Instruction *I, const DominatorTree *DT,
+    CapturesBefore(bool ReturnCaptures, bool StoreCaptures,
+                   const Instruction *I, const DominatorTree *DT,
                    bool IncludeI, OrderedBasicBlock *IC)
       : OrderedBB(IC), BeforeHere(I), DT(DT),
-        ReturnCaptures(ReturnCaptures), IncludeI(IncludeI), Captured(false) {}
+        ReturnCaptures(ReturnCaptures), StoreCaptures(StoreCaptures),
+        IncludeI(IncludeI), Captured(false) {}
 
     void tooManyUses() override { Captured = true; }
 
-    bool isSafeToPrune(Instruction *I) {
-      BasicBlock *BB = I->getParent();
-      // We explore this usage only if the usage can reach "BeforeHere".
-      // If use is not reachable from entry, there is no need to explore.
-      if (BeforeHere != I && !DT->isReachableFromEntry(BB))
-        return true;
-
-      // Compute the case where both instructions are inside the same basic
-      // block. Since instructions in the same BB as BeforeHere are numbered in
-      // 'OrderedBB', avoid using 'dominates' and 'isPotentiallyReachable'
-      // which are very expensive for large basic blocks.
-      if (BB == BeforeHere->getParent()) {
-        // 'I' dominates 'BeforeHere' => not safe to prune.
-        //
-        // The value defined by an invoke dominates an instruction only
-        // if it dominates every instruction in UseBB. A PHI is dominated only
-        // if the instruction dominates every possible use in the UseBB. Since
-        // UseBB == BB, avoid pruning.
-        if (isa<InvokeInst>(BeforeHere) || isa<PHINode>(I) || I == BeforeHere)
-          return false;
-        if (!OrderedBB->dominates(BeforeHere, I))
-          return false;
-
-        // 'BeforeHere' comes before 'I', it's safe to prune if we also
-        // guarantee that 'I' never reaches 'BeforeHere' through a back-edge or
-        // by its successors, i.e, prune if:
-        //
-        //  (1) BB is an entry block or have no successors.
-        //  (2) There's no path coming back through BB successors.
-        if (BB == &BB->getParent()->getEntryBlock() ||
-            !BB->getTerminator()->getNumSuccessors())
-          return true;
-
-        SmallVector<BasicBlock*, 32> Worklist;
-        Worklist.append(succ_begin(BB), succ_end(BB));
-        return !isPotentiallyReachableFromMany(Worklist, BB, nullptr, DT);
-      }
-
-      // If the value is defined in the same basic block as use and BeforeHere,
-      // there is no need to explore the use if BeforeHere dominates use.
-      // Check whether there is a path from I to BeforeHere.
-      if (BeforeHere != I && DT->dominates(BeforeHere, I) &&
-          !isPotentiallyReachable(I, BeforeHere, nullptr, DT))
-        return true;
-
-      return false;
-    }
-
     bool shouldExplore(const Use *U) override {
       Instruction *I = cast<Instruction>(U->getUser());
 
       if (BeforeHere == I && !IncludeI)
         return false;
 
-      if (isSafeToPrune(I))
+      if (isSafeToPrune(I, BeforeHere, DT, OrderedBB))
         return false;
 
       return true;
@@ -137,37 +153,47 @@ namespace {
       return true;
     }
 
+    bool followStores() override { return !StoreCaptures; }
+
     OrderedBasicBlock *OrderedBB;
     const Instruction *BeforeHere;
     const DominatorTree *DT;
 
     bool ReturnCaptures;
+    bool StoreCaptures;
     bool IncludeI;
 
     bool Captured;
   };
 }
 
+/// isNoEscapeAllocation - Return true if V is a call or invoke annotated with
+/// !noescape metadata, i.e. an allocation that is known never to be captured.
+bool llvm::isNoEscapeAllocation(const Value *V) {
+  if (const auto *Call = dyn_cast<CallBase>(V))
+    return Call->getMetadata(LLVMContext::MD_noescape) != nullptr;
+  return false;
+}
+
 /// PointerMayBeCaptured - Return true if this pointer value may be captured
 /// by the enclosing function (which is required to exist).  This routine can
 /// be expensive, so consider caching the results.  The boolean ReturnCaptures
 /// specifies whether returning the value (or part of it) from the function
 /// counts as capturing it or not.  The boolean StoreCaptures specified whether
 /// storing the value (or part of it) into memory anywhere automatically
-/// counts as capturing it or not.
+/// counts as capturing it or not.  If it is false, a store into function-local
+/// memory that doesn't escape is not a capture by itself; the values loaded
+/// back out of that memory are checked instead.
 bool llvm::PointerMayBeCaptured(const Value *V,
                                 bool ReturnCaptures, bool StoreCaptures,
                                 unsigned MaxUsesToExplore) {
   assert(!isa<GlobalValue>(V) &&
          "It doesn't make sense to ask whether a global is captured.");
 
-  // TODO: If StoreCaptures is not true, we could do Fancy analysis
-  // to determine whether this store is not actually an escape point.
-  // In that case, BasicAliasAnalysis should be updated as well to
-  // take advantage of this.
-  (void)StoreCaptures;
+  if (isNoEscapeAllocation(V))
+    return false;
 
-  SimpleCaptureTracker SCT(ReturnCaptures);
+  SimpleCaptureTracker SCT(ReturnCaptures, StoreCaptures);
   PointerMayBeCaptured(V, &SCT, MaxUsesToExplore);
   return SCT.Captured;
 }
@@ -180,8 +206,9 @@ bool llvm::PointerMayBeCaptured(const Value *V,
 /// returning the value (or part of it) from the function counts as capturing
 /// it or not.  The boolean StoreCaptures specified whether storing the value
 /// (or part of it) into memory anywhere automatically counts as capturing it
-/// or not. A ordered basic block \p OBB can be used in order to speed up
-/// queries about relative order among instructions in the same basic block.
+/// or not; see PointerMayBeCaptured for what happens if it is false. A ordered
+/// basic block \p OBB can be used in order to speed up queries about relative
+/// order among instructions in the same basic block.
 bool llvm::PointerMayBeCapturedBefore(const Value *V, bool ReturnCaptures,
                                       bool StoreCaptures, const Instruction *I,
                                       const DominatorTree *DT, bool IncludeI,
@@ -191,16 +218,16 @@ bool llvm::PointerMayBeCapturedBefore(const Value *V, bool ReturnCaptures,
          "It doesn't make sense to ask whether a global is captured.");
   bool UseNewOBB = OBB == nullptr;
 
+  if (isNoEscapeAllocation(V))
+    return false;
+
   if (!DT)
     return PointerMayBeCaptured(V, ReturnCaptures, StoreCaptures,
                                 MaxUsesToExplore);
   if (UseNewOBB)
     OBB = new OrderedBasicBlock(I->getParent());
 
-  // TODO: See comment in PointerMayBeCaptured regarding what could be done
-  // with StoreCaptures.
-
-  CapturesBefore CB(ReturnCaptures, I, DT, IncludeI, OBB);
+  CapturesBefore CB(ReturnCaptures, StoreCaptures, I, DT, IncludeI, OBB);
   PointerMayBeCaptured(V, &CB, MaxUsesToExplore);
 
   if (UseNewOBB)
@@ -208,13 +235,82 @@ bool llvm::PointerMayBeCapturedBefore(const Value *V, bool ReturnCaptures,
   return CB.Captured;
 }
 
+/// mayCaptureBefore - Return true if a capture by CapturePoint may happen
+/// before instruction I, the way PointerMayBeCapturedBefore decides it for
+/// each capturing use. A capture by I itself counts if IncludeI is true. An
+/// ordered basic block for the block of I is needed if CapturePoint is in that
+/// block.
+bool llvm::mayCaptureBefore(const Instruction *CapturePoint,
+                            const Instruction *I, const DominatorTree *DT,
+                            bool IncludeI, OrderedBasicBlock *OBB) {
+  if (CapturePoint == I)
+    return IncludeI;
+  return !isSafeToPrune(const_cast<Instruction *>(CapturePoint), I, DT, OBB);
+}
+
+/// Collect the loads of the function-local object Obj into Loads. Returns false
+/// if Obj isn't a non-escaping local allocation, or if its address is used by
+/// anything other than plain loads, stores to it and lifetime markers, in
+/// which case a value stored into it can't be followed.
+static bool collectLocalLoads(const Value *Obj,
+                              SmallVectorImpl<const LoadInst *> &Loads,
+                              CaptureTracker *Tracker,
+                              unsigned MaxUsesToExplore) {
+  if (!isa<AllocaInst>(Obj) && !isNoEscapeAllocation(Obj))
+    return false;
+
+  SmallVector<const Value *, 8> Worklist;
+  SmallPtrSet<const Value *, 8> Visited;
+  unsigned Count = 0;
+  Worklist.push_back(Obj);
+  Visited.insert(Obj);
+  while (!Worklist.empty()) {
+    const Value *Ptr = Worklist.pop_back_val();
+    Tracker->exploreUses(Ptr);
+    for (const User *U : Ptr->users()) {
+      if (Count++ >= MaxUsesToExplore)
+        return false;
+      const auto *I = cast<Instruction>(U);
+      switch (I->getOpcode()) {
+      case Instruction::Load:
+        if (cast<LoadInst>(I)->isVolatile())
+          return false;
+        Loads.push_back(cast<LoadInst>(I));
+        break;
+      case Instruction::Store:
+        // Storing the address itself would let the contents escape.
+        if (cast<StoreInst>(I)->isVolatile() || I->getOperand(0) == Ptr)
+          return false;
+        break;
+      case Instruction::BitCast:
+      case Instruction::GetElementPtr:
+      case Instruction::PHI:
+      case Instruction::Select:
+      case Instruction::AddrSpaceCast:
+        if (Visited.insert(I).second)
+          Worklist.push_back(I);
+        break;
+      case Instruction::Call:
+        if (I->isLifetimeStartOrEnd())
+          break;
+        return false;
+      default:
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 void llvm::PointerMayBeCaptured(const Value *V, CaptureTracker *Tracker,
                                 unsigned MaxUsesToExplore) {
   assert(V->getType()->isPointerTy() && "Capture is for pointers only!");
   SmallVector<const Use *, DefaultMaxUsesToExplore> Worklist;
   SmallSet<const Use *, DefaultMaxUsesToExplore> Visited;
+  SmallPtrSet<const Value *, 4> FollowedObjects;
 
   auto AddUses = [&](const Value *V) {
+    Tracker->exploreUses(V);
     unsigned Count = 0;
     for (const Use &U : V->uses()) {
       // If there are lots of uses, conservatively say that the value
@@ -289,13 +385,36 @@ void llvm::PointerMayBeCaptured(const Value *V, CaptureTracker *Tracker,
     case Instruction::VAArg:
       // "va-arg" from a pointer does not cause it to be captured.
       break;
-    case Instruction::Store:
-        // Stored the pointer - conservatively assume it may be captured.
-        // Volatile stores make the address observable.
-      if (V == I->getOperand(0) || cast<StoreInst>(I)->isVolatile())
+    case Instruction::Store: {
+      // Volatile stores make the address observable.
+      auto *SI = cast<StoreInst>(I);
+      if (SI->isVolatile()) {
         if (Tracker->captured(U))
           return;
+        break;
+      }
+      if (V != SI->getValueOperand())
+        break;
+      // Stored the pointer into function-local memory that doesn't escape -
+      // if the tracker allows it, keep looking at what is loaded back out.
+      if (Tracker->followStores()) {
+        const Value *Obj = GetUnderlyingObject(
+            SI->getPointerOperand(), SI->getModule()->getDataLayout());
+        if (FollowedObjects.count(Obj))
+          break;
+        SmallVector<const LoadInst *, 8> Loads;
+        if (collectLocalLoads(Obj, Loads, Tracker, MaxUsesToExplore)) {
+          FollowedObjects.insert(Obj);
+          for (const LoadInst *LI : Loads)
+            AddUses(LI);
+          break;
+        }
+      }
+      // Stored the pointer - conservatively assume it may be captured.
+      if (Tracker->captured(U))
+        return;
       break;
+    }
     case Instruction::AtomicRMW: {
       // atomicrmw conceptually includes both a load and store from
       // the same location.
@@ -326,6 +445,8 @@ void llvm::PointerMayBeCaptured(const Value *V, CaptureTracker *Tracker,
     case Instruction::PHI:
     case Instruction::Select:
     case Instruction::AddrSpaceCast:
+    case Instruction::InsertValue:
+    case Instruction::ExtractValue:
       // The original value is not captured via this if the new value isn't.
       AddUses(I);
       break;
@@ -21,6 +21,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/iterator.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/AliasAnalysis.h"
@@ -50,6 +51,7 @@
 #include <algorithm>
 #include <cassert>
 #include <iterator>
+#include <list>
 #include <memory>
 #include <utility>
 
@@ -70,11 +72,21 @@ INITIALIZE_PASS_DEPENDENCY(MemorySSAWrapperPass)
 INITIALIZE_PASS_END(MemorySSAPrinterLegacyPass, "print-memoryssa",
                     "Memory SSA Printer", false, false)
 
+STATISTIC(NumClobberCacheHits, "Number of clobber queries answered from cache");
+STATISTIC(NumClobberCacheMisses, "Number of clobber queries missing the cache");
+STATISTIC(NumClobberCacheEvictions, "Number of clobber cache entries evicted");
+STATISTIC(NumClobberCacheInvalidations, "Number of clobber cache invalidations");
+
 static cl::opt<unsigned> MaxCheckLimit(
     "memssa-check-limit", cl::Hidden, cl::init(100),
     cl::desc("The maximum number of stores/phis MemorySSA"
              "will consider trying to walk past (default = 100)"));
 
+static cl::opt<unsigned> ClobberCacheSize(
+    "memssa-clobber-cache-size", cl::Hidden, cl::init(1024),
+    cl::desc("The maximum number of clobber queries the MemorySSA walker "
+             "remembers, 0 disables the cache (default = 1024)"));
+
 // Always verify MemorySSA if expensive checking is enabled.
 #ifdef EXPENSIVE_CHECKS
 bool llvm::VerifyMemorySSA = true;
@@ -978,18 +990,62 @@ template <class AliasAnalysisType> class MemorySSA::ClobberWalkerBase {
   ClobberWalker<AliasAnalysisType> Walker;
   MemorySSA *MSSA;
 
+  // Results of the walks that are not recorded as the optimized access of the
+  // starting access: queries for an explicit location, and the walk past self
+  // of a SkipSelf query, keyed with an empty location. Entries are kept in
+  // least recently used order, and the whole cache is dropped whenever the
+  // def-use chains change.
+  using ClobberCacheKey = std::pair<const MemoryAccess *, MemoryLocation>;
+  using ClobberCacheList = std::list<std::pair<ClobberCacheKey, MemoryAccess *>>;
+  ClobberCacheList ClobberCacheLRU;
+  DenseMap<ClobberCacheKey, typename ClobberCacheList::iterator> ClobberCache;
+
+  MemoryAccess *lookupCachedClobber(const ClobberCacheKey &Key) {
+    if (!ClobberCacheSize)
+      return nullptr;
+    auto It = ClobberCache.find(Key);
+    if (It == ClobberCache.end()) {
+      ++NumClobberCacheMisses;
+      return nullptr;
+    }
+    ++NumClobberCacheHits;
+    ClobberCacheLRU.splice(ClobberCacheLRU.begin(), ClobberCacheLRU,
+                           It->second);
+    return It->second->second;
+  }
+
+  void cacheClobber(const ClobberCacheKey &Key, MemoryAccess *Clobber) {
+    if (!ClobberCacheSize)
+      return;
+    ClobberCacheLRU.emplace_front(Key, Clobber);
+    ClobberCache[Key] = ClobberCacheLRU.begin();
+    if (ClobberCache.size() > ClobberCacheSize) {
+      ClobberCache.erase(ClobberCacheLRU.back().first);
+      ClobberCacheLRU.pop_back();
+      ++NumClobberCacheEvictions;
+    }
+  }
+
 public:
   ClobberWalkerBase(MemorySSA *M, AliasAnalysisType *A, DominatorTree *D)
       : Walker(*M, *A, *D), MSSA(M) {}
 
+  void clearClobberCache() {
+    if (ClobberCache.empty())
+      return;
+    ClobberCache.clear();
+    ClobberCacheLRU.clear();
+    ++NumClobberCacheInvalidations;
+  }
+
   MemoryAccess *getClobberingMemoryAccessBase(MemoryAccess *,
                                               const MemoryLocation &,
                                               unsigned &);
   // Third argument (bool), defines whether the clobber search should skip the
   // original queried access. If true, there will be a follow-up query searching
   // for a clobber access past "self". Note that the Optimized access is not
-  // updated if a new clobber is found by this SkipSelf search. If this
-  // additional query becomes heavily used we may decide to cache the result.
+  // updated if a new clobber is found by this SkipSelf search; the result goes
+  // to the clobber cache instead.
   // Walker instantiations will decide how to set the SkipSelf bool.
   MemoryAccess *getClobberingMemoryAccessBase(MemoryAccess *, unsigned &, bool);
 };
@@ -1030,6 +1086,7 @@ public:
   void invalidateInfo(MemoryAccess *MA) override {
     if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
       MUD->resetOptimized();
+    Walker->clearClobberCache();
   }
 };
 
@@ -1066,6 +1123,7 @@ public:
   void invalidateInfo(MemoryAccess *MA) override {
     if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
       MUD->resetOptimized();
+    Walker->clearClobberCache();
   }
 };
 
@@ -1554,6 +1612,11 @@ MemorySSA::CachingWalker<AliasAnalysis> *MemorySSA::getWalkerImpl() {
   return Walker.get();
 }
 
+void MemorySSA::invalidateClobberCache() {
+  if (WalkerBase)
+    WalkerBase->clearClobberCache();
+}
+
 MemorySSAWalker *MemorySSA::getSkipSelfWalker() {
   if (SkipWalker)
     return SkipWalker.get();
@@ -1601,6 +1664,7 @@ void MemorySSA::insertIntoListsForBlock(MemoryAccess *NewAccess,
     }
   }
   BlockNumberingValid.erase(BB);
+  invalidateClobberCache();
 }
 
 void MemorySSA::insertIntoListsBefore(MemoryAccess *What, const BasicBlock *BB,
@@ -1629,6 +1693,7 @@ void MemorySSA::insertIntoListsBefore(MemoryAccess *What, const BasicBlock *BB,
     }
   }
   BlockNumberingValid.erase(BB);
+  invalidateClobberCache();
 }
 
 void MemorySSA::prepareForMoveTo(MemoryAccess *What, BasicBlock *BB) {
@@ -1784,6 +1849,8 @@ void MemorySSA::removeFromLookups(MemoryAccess *MA) {
   // Invalidate our walker's cache if necessary
   if (!isa<MemoryUse>(MA))
     getWalker()->invalidateInfo(MA);
+  // Cached clobbers may be keyed on, or point to, the access going away.
+  invalidateClobberCache();
 
   Value *MemoryInst;
   if (const auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
@@ -2275,6 +2342,10 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
   if (!isa<CallBase>(I) && I->isFenceLike())
     return StartingUseOrDef;
 
+  ClobberCacheKey Key(StartingUseOrDef, Loc);
+  if (MemoryAccess *Cached = lookupCachedClobber(Key))
+    return Cached;
+
   UpwardsMemoryQuery Q;
   Q.OriginalAccess = StartingUseOrDef;
   Q.StartingLoc = Loc;
@@ -2290,6 +2361,10 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
 
   MemoryAccess *Clobber =
       Walker.findClobber(DefiningAccess, Q, UpwardWalkLimit);
+  // A walk that ran out of budget gives a conservative answer; leave the
+  // query to be retried with a fresh budget.
+  if (UpwardWalkLimit)
+    cacheClobber(Key, Clobber);
   LLVM_DEBUG(dbgs() << "Starting Memory SSA clobber for " << *I << " is ");
   LLVM_DEBUG(dbgs() << *StartingUseOrDef << "\n");
   LLVM_DEBUG(dbgs() << "Final Memory SSA clobber for " << *I << " is ");
@@ -2364,8 +2439,14 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
   if (SkipSelf && isa<MemoryPhi>(OptimizedAccess) &&
       isa<MemoryDef>(StartingAccess) && UpwardWalkLimit) {
     assert(isa<MemoryDef>(Q.OriginalAccess));
-    Q.SkipSelfAccess = true;
-    Result = Walker.findClobber(OptimizedAccess, Q, UpwardWalkLimit);
+    ClobberCacheKey Key(StartingAccess, MemoryLocation());
+    Result = lookupCachedClobber(Key);
+    if (!Result) {
+      Q.SkipSelfAccess = true;
+      Result = Walker.findClobber(OptimizedAccess, Q, UpwardWalkLimit);
+      if (UpwardWalkLimit)
+        cacheClobber(Key, Result);
+    }
   } else
     Result = OptimizedAccess;
 
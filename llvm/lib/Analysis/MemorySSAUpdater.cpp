@@ -217,6 +217,7 @@ MemoryAccess *MemorySSAUpdater::tryRemoveTrivialPhi(MemoryPhi *Phi,
 
 void MemorySSAUpdater::insertUse(MemoryUse *MU) {
   InsertedPHIs.clear();
+  MSSA->invalidateClobberCache();
   MU->setDefiningAccess(getPreviousDef(MU));
   // Unlike for defs, there is no extra work to do.  Because uses do not create
   // new may-defs, there are only two cases:
@@ -254,6 +255,7 @@ static void setMemoryPhiValueForBlock(MemoryPhi *MP, const BasicBlock *BB,
 // disconnected stores.
 void MemorySSAUpdater::insertDef(MemoryDef *MD, bool RenameUses) {
   InsertedPHIs.clear();
+  MSSA->invalidateClobberCache();
 
   // See if we had a local def, and if not, go hunting.
   MemoryAccess *DefBefore = getPreviousDef(MD);
@@ -457,6 +459,7 @@ void MemorySSAUpdater::fixupDefs(const SmallVectorImpl<WeakVH> &Vars) {
 
 void MemorySSAUpdater::removeEdge(BasicBlock *From, BasicBlock *To) {
   if (MemoryPhi *MPhi = MSSA->getMemoryAccess(To)) {
+    MSSA->invalidateClobberCache();
     MPhi->unorderedDeleteIncomingBlock(From);
     if (MPhi->getNumIncomingValues() == 1)
       removeMemoryAccess(MPhi);
@@ -466,6 +469,7 @@ void MemorySSAUpdater::removeEdge(BasicBlock *From, BasicBlock *To) {
 void MemorySSAUpdater::removeDuplicatePhiEdgesBetween(BasicBlock *From,
                                                       BasicBlock *To) {
   if (MemoryPhi *MPhi = MSSA->getMemoryAccess(To)) {
+    MSSA->invalidateClobberCache();
     bool Found = false;
     MPhi->unorderedDeleteIncomingIf([&](const MemoryAccess *, BasicBlock *B) {
       if (From != B)
@@ -688,6 +692,9 @@ void MemorySSAUpdater::applyInsertUpdates(ArrayRef<CFGUpdate> Updates,
 void MemorySSAUpdater::applyInsertUpdates(ArrayRef<CFGUpdate> Updates,
                                           DominatorTree &DT,
                                           const GraphDiff<BasicBlock *> *GD) {
+  // Existing phis gain incoming values below without being reinserted.
+  MSSA->invalidateClobberCache();
+
   // Get recursive last Def, assuming well formed MSSA and updated DT.
   auto GetLastDef = [&](BasicBlock *BB) -> MemoryAccess * {
     while (true) {
@@ -1079,6 +1086,7 @@ static MemoryAccess *onlySingleValue(MemoryPhi *MP) {
 void MemorySSAUpdater::wireOldPredecessorsToNewImmediatePredecessor(
     BasicBlock *Old, BasicBlock *New, ArrayRef<BasicBlock *> Preds,
     bool IdenticalEdgesWereMerged) {
+  MSSA->invalidateClobberCache();
   assert(!MSSA->getWritableBlockAccesses(New) &&
          "Access list should be null for a new block.");
   MemoryPhi *Phi = MSSA->getMemoryAccess(Old);
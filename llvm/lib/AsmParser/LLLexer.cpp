@@ -14,6 +14,7 @@
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Instruction.h"
@@ -22,6 +23,7 @@
 #include <cassert>
 #include <cctype>
 #include <cstdio>
+#include <cstring>
 
 using namespace llvm;
 
@@ -139,8 +141,7 @@ static void UnEscapeLexed(std::string &Str) {
 
 /// isLabelChar - Return true for [-a-zA-Z$._0-9].
 static bool isLabelChar(char C) {
-  return isalnum(static_cast<unsigned char>(C)) || C == '-' || C == '$' ||
-         C == '.' || C == '_';
+  return isAlnum(C) || C == '-' || C == '$' || C == '.' || C == '_';
 }
 
 /// isLabelTail - Return true if this pointer points to a valid end of a label.
@@ -187,7 +188,7 @@ lltok::Kind LLLexer::LexToken() {
     switch (CurChar) {
     default:
       // Handle letters: [a-zA-Z_]
-      if (isalpha(static_cast<unsigned char>(CurChar)) || CurChar == '_')
+      if (isAlpha(CurChar) || CurChar == '_')
         return LexIdentifier();
 
       return lltok::Error;
@@ -245,10 +246,62 @@ lltok::Kind LLLexer::LexToken() {
 }
 
 void LLLexer::SkipLineComment() {
-  while (true) {
-    if (CurPtr[0] == '\n' || CurPtr[0] == '\r' || getNextChar() == EOF)
-      return;
+  // Let memchr find the end of the line rather than walking the comment one
+  // character at a time.
+  const char *End = CurBuf.end();
+  const char *NewLine =
+      static_cast<const char *>(memchr(CurPtr, '\n', End - CurPtr));
+  if (!NewLine)
+    NewLine = End;
+  const char *Return =
+      static_cast<const char *>(memchr(CurPtr, '\r', NewLine - CurPtr));
+  CurPtr = Return ? Return : NewLine;
+}
+
+/// SkipToQuote - Move CurPtr past the next '"' and return true, or move it to
+/// the end of the buffer and return false if there is none.
+bool LLLexer::SkipToQuote() {
+  const char *End = CurBuf.end();
+  const char *Quote =
+      static_cast<const char *>(memchr(CurPtr, '"', End - CurPtr));
+  if (!Quote) {
+    CurPtr = End;
+    return false;
+  }
+  CurPtr = Quote + 1;
+  return true;
+}
+
+/// SkipBraces - Move CurPtr past the '}' matching the '{' token just lexed,
+/// looking only at braces, quoted strings and comments on the way, and return
+/// true. Return false, with the current token at the end of the buffer, if
+/// the braces are not balanced.
+bool LLLexer::SkipBraces() {
+  assert(CurKind == lltok::lbrace && "not at a '{'");
+  const char *End = CurBuf.end();
+  unsigned Depth = 1;
+  while (CurPtr != End) {
+    switch (*CurPtr++) {
+    case '{':
+      ++Depth;
+      break;
+    case '}':
+      if (--Depth == 0)
+        return true;
+      break;
+    case '"':
+      SkipToQuote();
+      break;
+    case ';':
+      SkipLineComment();
+      break;
+    default:
+      break;
+    }
   }
+  TokStart = CurPtr;
+  CurKind = lltok::Eof;
+  return false;
 }
 
 /// Lex all tokens that start with an @ character.
@@ -270,23 +323,17 @@ lltok::Kind LLLexer::LexDollar() {
   if (CurPtr[0] == '"') {
     ++CurPtr;
 
-    while (true) {
-      int CurChar = getNextChar();
-
-      if (CurChar == EOF) {
-        Error("end of file in COMDAT variable name");
-        return lltok::Error;
-      }
-      if (CurChar == '"') {
-        StrVal.assign(TokStart + 2, CurPtr - 1);
-        UnEscapeLexed(StrVal);
-        if (StringRef(StrVal).find_first_of(0) != StringRef::npos) {
-          Error("Null bytes are not allowed in names");
-          return lltok::Error;
-        }
-        return lltok::ComdatVar;
-      }
+    if (!SkipToQuote()) {
+      Error("end of file in COMDAT variable name");
+      return lltok::Error;
     }
+    StrVal.assign(TokStart + 2, CurPtr - 1);
+    UnEscapeLexed(StrVal);
+    if (StringRef(StrVal).find_first_of(0) != StringRef::npos) {
+      Error("Null bytes are not allowed in names");
+      return lltok::Error;
+    }
+    return lltok::ComdatVar;
   }
 
   // Handle ComdatVarName: $[-a-zA-Z$._][-a-zA-Z$._0-9]*
@@ -299,29 +346,23 @@ lltok::Kind LLLexer::LexDollar() {
 /// ReadString - Read a string until the closing quote.
 lltok::Kind LLLexer::ReadString(lltok::Kind kind) {
   const char *Start = CurPtr;
-  while (true) {
-    int CurChar = getNextChar();
-
-    if (CurChar == EOF) {
-      Error("end of file in string constant");
-      return lltok::Error;
-    }
-    if (CurChar == '"') {
-      StrVal.assign(Start, CurPtr-1);
-      UnEscapeLexed(StrVal);
-      return kind;
-    }
+  if (!SkipToQuote()) {
+    Error("end of file in string constant");
+    return lltok::Error;
   }
+  StrVal.assign(Start, CurPtr-1);
+  UnEscapeLexed(StrVal);
+  return kind;
 }
 
 /// ReadVarName - Read the rest of a token containing a variable name.
 bool LLLexer::ReadVarName() {
   const char *NameStart = CurPtr;
-  if (isalpha(static_cast<unsigned char>(CurPtr[0])) ||
+  if (isAlpha(CurPtr[0]) ||
       CurPtr[0] == '-' || CurPtr[0] == '$' ||
       CurPtr[0] == '.' || CurPtr[0] == '_') {
     ++CurPtr;
-    while (isalnum(static_cast<unsigned char>(CurPtr[0])) ||
+    while (isAlnum(CurPtr[0]) ||
            CurPtr[0] == '-' || CurPtr[0] == '$' ||
            CurPtr[0] == '.' || CurPtr[0] == '_')
       ++CurPtr;
@@ -335,10 +376,10 @@ bool LLLexer::ReadVarName() {
 // Lex an ID: [0-9]+. On success, the ID is stored in UIntVal and Token is
 // returned, otherwise the Error token is returned.
 lltok::Kind LLLexer::LexUIntID(lltok::Kind Token) {
-  if (!isdigit(static_cast<unsigned char>(CurPtr[0])))
+  if (!isDigit(CurPtr[0]))
     return lltok::Error;
 
-  for (++CurPtr; isdigit(static_cast<unsigned char>(CurPtr[0])); ++CurPtr)
+  for (++CurPtr; isDigit(CurPtr[0]); ++CurPtr)
     /*empty*/;
 
   uint64_t Val = atoull(TokStart + 1, CurPtr);
@@ -353,23 +394,17 @@ lltok::Kind LLLexer::LexVar(lltok::Kind Var, lltok::Kind VarID) {
   if (CurPtr[0] == '"') {
     ++CurPtr;
 
-    while (true) {
-      int CurChar = getNextChar();
-
-      if (CurChar == EOF) {
-        Error("end of file in global variable name");
-        return lltok::Error;
-      }
-      if (CurChar == '"') {
-        StrVal.assign(TokStart+2, CurPtr-1);
-        UnEscapeLexed(StrVal);
-        if (StringRef(StrVal).find_first_of(0) != StringRef::npos) {
-          Error("Null bytes are not allowed in names");
-          return lltok::Error;
-        }
-        return Var;
-      }
+    if (!SkipToQuote()) {
+      Error("end of file in global variable name");
+      return lltok::Error;
+    }
+    StrVal.assign(TokStart+2, CurPtr-1);
+    UnEscapeLexed(StrVal);
+    if (StringRef(StrVal).find_first_of(0) != StringRef::npos) {
+      Error("Null bytes are not allowed in names");
+      return lltok::Error;
     }
+    return Var;
   }
 
   // Handle VarName: [-a-zA-Z$._][-a-zA-Z$._0-9]*
@@ -414,11 +449,11 @@ lltok::Kind LLLexer::LexQuote() {
 ///    !
 lltok::Kind LLLexer::LexExclaim() {
   // Lex a metadata name as a MetadataVar.
-  if (isalpha(static_cast<unsigned char>(CurPtr[0])) ||
+  if (isAlpha(CurPtr[0]) ||
       CurPtr[0] == '-' || CurPtr[0] == '$' ||
       CurPtr[0] == '.' || CurPtr[0] == '_' || CurPtr[0] == '\\') {
     ++CurPtr;
-    while (isalnum(static_cast<unsigned char>(CurPtr[0])) ||
+    while (isAlnum(CurPtr[0]) ||
            CurPtr[0] == '-' || CurPtr[0] == '$' ||
            CurPtr[0] == '.' || CurPtr[0] == '_' || CurPtr[0] == '\\')
       ++CurPtr;
@@ -444,6 +479,404 @@ lltok::Kind LLLexer::LexHash() {
   return LexUIntID(lltok::AttrGrpID);
 }
 
+/// A keyword the lexer recognizes, with the instruction opcode or type it
+/// stands for, if any.
+struct KeywordInfo {
+  lltok::Kind Kind;
+  unsigned Opcode;
+  Type::TypeID TyID;
+};
+
+/// getKeywordTable - Return the table of every keyword, so that a keyword is
+/// looked up with one hash instead of being compared against each in turn.
+static const StringMap<KeywordInfo> &getKeywordTable() {
+  static const StringMap<KeywordInfo> KeywordTable = [] {
+    StringMap<KeywordInfo> Table;
+
+#define KEYWORD(STR)                                                           \
+    Table.insert({#STR, {lltok::kw_##STR, 0, Type::VoidTyID}})
+
+    KEYWORD(true);    KEYWORD(false);
+    KEYWORD(declare); KEYWORD(define);
+    KEYWORD(global);  KEYWORD(constant);
+
+    KEYWORD(dso_local);
+    KEYWORD(dso_preemptable);
+
+    KEYWORD(private);
+    KEYWORD(internal);
+    KEYWORD(available_externally);
+    KEYWORD(linkonce);
+    KEYWORD(linkonce_odr);
+    KEYWORD(weak); // Use as a linkage, and a modifier for "cmpxchg".
+    KEYWORD(weak_odr);
+    KEYWORD(appending);
+    KEYWORD(dllimport);
+    KEYWORD(dllexport);
+    KEYWORD(common);
+    KEYWORD(default);
+    KEYWORD(hidden);
+    KEYWORD(protected);
+    KEYWORD(unnamed_addr);
+    KEYWORD(local_unnamed_addr);
+    KEYWORD(externally_initialized);
+    KEYWORD(extern_weak);
+    KEYWORD(external);
+    KEYWORD(thread_local);
+    KEYWORD(localdynamic);
+    KEYWORD(initialexec);
+    KEYWORD(localexec);
+    KEYWORD(zeroinitializer);
+    KEYWORD(undef);
+    KEYWORD(null);
+    KEYWORD(none);
+    KEYWORD(to);
+    KEYWORD(caller);
+    KEYWORD(within);
+    KEYWORD(from);
+    KEYWORD(tail);
+    KEYWORD(musttail);
+    KEYWORD(notail);
+    KEYWORD(target);
+    KEYWORD(triple);
+    KEYWORD(source_filename);
+    KEYWORD(unwind);
+    KEYWORD(deplibs);             // FIXME: Remove in 4.0.
+    KEYWORD(datalayout);
+    KEYWORD(volatile);
+    KEYWORD(atomic);
+    KEYWORD(unordered);
+    KEYWORD(monotonic);
+    KEYWORD(acquire);
+    KEYWORD(release);
+    KEYWORD(acq_rel);
+    KEYWORD(seq_cst);
+    KEYWORD(syncscope);
+
+    KEYWORD(nnan);
+    KEYWORD(ninf);
+    KEYWORD(nsz);
+    KEYWORD(arcp);
+    KEYWORD(contract);
+    KEYWORD(reassoc);
+    KEYWORD(afn);
+    KEYWORD(fast);
+    KEYWORD(nuw);
+    KEYWORD(nsw);
+    KEYWORD(exact);
+    KEYWORD(inbounds);
+    KEYWORD(inrange);
+    KEYWORD(align);
+    KEYWORD(addrspace);
+    KEYWORD(section);
+    KEYWORD(alias);
+    KEYWORD(ifunc);
+    KEYWORD(module);
+    KEYWORD(asm);
+    KEYWORD(sideeffect);
+    KEYWORD(alignstack);
+    KEYWORD(inteldialect);
+    KEYWORD(gc);
+    KEYWORD(prefix);
+    KEYWORD(prologue);
+
+    KEYWORD(ccc);
+    KEYWORD(fastcc);
+    KEYWORD(coldcc);
+    KEYWORD(x86_stdcallcc);
+    KEYWORD(x86_fastcallcc);
+    KEYWORD(x86_thiscallcc);
+    KEYWORD(x86_vectorcallcc);
+    KEYWORD(arm_apcscc);
+    KEYWORD(arm_aapcscc);
+    KEYWORD(arm_aapcs_vfpcc);
+    KEYWORD(aarch64_vector_pcs);
+    KEYWORD(msp430_intrcc);
+    KEYWORD(avr_intrcc);
+    KEYWORD(avr_signalcc);
+    KEYWORD(ptx_kernel);
+    KEYWORD(ptx_device);
+    KEYWORD(spir_kernel);
+    KEYWORD(spir_func);
+    KEYWORD(intel_ocl_bicc);
+    KEYWORD(x86_64_sysvcc);
+    KEYWORD(win64cc);
+    KEYWORD(x86_regcallcc);
+    KEYWORD(webkit_jscc);
+    KEYWORD(swiftcc);
+    KEYWORD(anyregcc);
+    KEYWORD(preserve_mostcc);
+    KEYWORD(preserve_allcc);
+    KEYWORD(ghccc);
+    KEYWORD(x86_intrcc);
+    KEYWORD(hhvmcc);
+    KEYWORD(hhvm_ccc);
+    KEYWORD(cxx_fast_tlscc);
+    KEYWORD(amdgpu_vs);
+    KEYWORD(amdgpu_ls);
+    KEYWORD(amdgpu_hs);
+    KEYWORD(amdgpu_es);
+    KEYWORD(amdgpu_gs);
+    KEYWORD(amdgpu_ps);
+    KEYWORD(amdgpu_cs);
+    KEYWORD(amdgpu_kernel);
+
+    KEYWORD(cc);
+    KEYWORD(c);
+
+    KEYWORD(attributes);
+
+    KEYWORD(alwaysinline);
+    KEYWORD(allocsize);
+    KEYWORD(argmemonly);
+    KEYWORD(builtin);
+    KEYWORD(byval);
+    KEYWORD(inalloca);
+    KEYWORD(cold);
+    KEYWORD(convergent);
+    KEYWORD(dereferenceable);
+    KEYWORD(dereferenceable_or_null);
+    KEYWORD(inaccessiblememonly);
+    KEYWORD(inaccessiblemem_or_argmemonly);
+    KEYWORD(inlinehint);
+    KEYWORD(inreg);
+    KEYWORD(jumptable);
+    KEYWORD(minsize);
+    KEYWORD(naked);
+    KEYWORD(nest);
+    KEYWORD(noalias);
+    KEYWORD(nobuiltin);
+    KEYWORD(nocapture);
+    KEYWORD(noduplicate);
+    KEYWORD(noimplicitfloat);
+    KEYWORD(noinline);
+    KEYWORD(norecurse);
+    KEYWORD(nonlazybind);
+    KEYWORD(nonnull);
+    KEYWORD(noredzone);
+    KEYWORD(noreturn);
+    KEYWORD(nocf_check);
+    KEYWORD(nounwind);
+    KEYWORD(optforfuzzing);
+    KEYWORD(optnone);
+    KEYWORD(optsize);
+    KEYWORD(readnone);
+    KEYWORD(readonly);
+    KEYWORD(returned);
+    KEYWORD(returns_twice);
+    KEYWORD(signext);
+    KEYWORD(speculatable);
+    KEYWORD(sret);
+    KEYWORD(ssp);
+    KEYWORD(sspreq);
+    KEYWORD(sspstrong);
+    KEYWORD(strictfp);
+    KEYWORD(safestack);
+    KEYWORD(shadowcallstack);
+    KEYWORD(sanitize_address);
+    KEYWORD(sanitize_hwaddress);
+    KEYWORD(sanitize_thread);
+    KEYWORD(sanitize_memory);
+    KEYWORD(speculative_load_hardening);
+    KEYWORD(swifterror);
+    KEYWORD(swiftself);
+    KEYWORD(uwtable);
+    KEYWORD(writeonly);
+    KEYWORD(zeroext);
+    KEYWORD(immarg);
+
+    KEYWORD(type);
+    KEYWORD(opaque);
+
+    KEYWORD(comdat);
+
+    // Comdat types
+    KEYWORD(any);
+    KEYWORD(exactmatch);
+    KEYWORD(largest);
+    KEYWORD(noduplicates);
+    KEYWORD(samesize);
+
+    KEYWORD(eq); KEYWORD(ne); KEYWORD(slt); KEYWORD(sgt); KEYWORD(sle);
+    KEYWORD(sge); KEYWORD(ult); KEYWORD(ugt); KEYWORD(ule); KEYWORD(uge);
+    KEYWORD(oeq); KEYWORD(one); KEYWORD(olt); KEYWORD(ogt); KEYWORD(ole);
+    KEYWORD(oge); KEYWORD(ord); KEYWORD(uno); KEYWORD(ueq); KEYWORD(une);
+
+    KEYWORD(xchg); KEYWORD(nand); KEYWORD(max); KEYWORD(min); KEYWORD(umax);
+    KEYWORD(umin);
+
+    KEYWORD(x);
+    KEYWORD(blockaddress);
+
+    // Metadata types.
+    KEYWORD(distinct);
+
+    // Use-list order directives.
+    KEYWORD(uselistorder);
+    KEYWORD(uselistorder_bb);
+
+    KEYWORD(personality);
+    KEYWORD(cleanup);
+    KEYWORD(catch);
+    KEYWORD(filter);
+
+    // Summary index keywords.
+    KEYWORD(path);
+    KEYWORD(hash);
+    KEYWORD(gv);
+    KEYWORD(guid);
+    KEYWORD(name);
+    KEYWORD(summaries);
+    KEYWORD(flags);
+    KEYWORD(linkage);
+    KEYWORD(notEligibleToImport);
+    KEYWORD(live);
+    KEYWORD(dsoLocal);
+    KEYWORD(function);
+    KEYWORD(insts);
+    KEYWORD(funcFlags);
+    KEYWORD(readNone);
+    KEYWORD(readOnly);
+    KEYWORD(noRecurse);
+    KEYWORD(returnDoesNotAlias);
+    KEYWORD(noInline);
+    KEYWORD(calls);
+    KEYWORD(callee);
+    KEYWORD(hotness);
+    KEYWORD(unknown);
+    KEYWORD(hot);
+    KEYWORD(critical);
+    KEYWORD(relbf);
+    KEYWORD(variable);
+    KEYWORD(aliasee);
+    KEYWORD(refs);
+    KEYWORD(typeIdInfo);
+    KEYWORD(typeTests);
+    KEYWORD(typeTestAssumeVCalls);
+    KEYWORD(typeCheckedLoadVCalls);
+    KEYWORD(typeTestAssumeConstVCalls);
+    KEYWORD(typeCheckedLoadConstVCalls);
+    KEYWORD(vFuncId);
+    KEYWORD(offset);
+    KEYWORD(args);
+    KEYWORD(typeid);
+    KEYWORD(summary);
+    KEYWORD(typeTestRes);
+    KEYWORD(kind);
+    KEYWORD(unsat);
+    KEYWORD(byteArray);
+    KEYWORD(inline);
+    KEYWORD(single);
+    KEYWORD(allOnes);
+    KEYWORD(sizeM1BitWidth);
+    KEYWORD(alignLog2);
+    KEYWORD(sizeM1);
+    KEYWORD(bitMask);
+    KEYWORD(inlineBits);
+    KEYWORD(wpdResolutions);
+    KEYWORD(wpdRes);
+    KEYWORD(indir);
+    KEYWORD(singleImpl);
+    KEYWORD(branchFunnel);
+    KEYWORD(singleImplName);
+    KEYWORD(resByArg);
+    KEYWORD(byArg);
+    KEYWORD(uniformRetVal);
+    KEYWORD(uniqueRetVal);
+    KEYWORD(virtualConstProp);
+    KEYWORD(info);
+    KEYWORD(byte);
+    KEYWORD(bit);
+    KEYWORD(varFlags);
+
+#undef KEYWORD
+
+    // Keywords for types.
+#define TYPEKEYWORD(STR, TYID)                                                 \
+    Table.insert({STR, {lltok::Type, 0, Type::TYID}})
+
+    TYPEKEYWORD("void",      VoidTyID);
+    TYPEKEYWORD("half",      HalfTyID);
+    TYPEKEYWORD("float",     FloatTyID);
+    TYPEKEYWORD("double",    DoubleTyID);
+    TYPEKEYWORD("x86_fp80",  X86_FP80TyID);
+    TYPEKEYWORD("fp128",     FP128TyID);
+    TYPEKEYWORD("ppc_fp128", PPC_FP128TyID);
+    TYPEKEYWORD("label",     LabelTyID);
+    TYPEKEYWORD("metadata",  MetadataTyID);
+    TYPEKEYWORD("x86_mmx",   X86_MMXTyID);
+    TYPEKEYWORD("token",     TokenTyID);
+
+#undef TYPEKEYWORD
+
+    // Keywords for instructions.
+#define INSTKEYWORD(STR, Enum)                                                 \
+    Table.insert({#STR, {lltok::kw_##STR, Instruction::Enum, Type::VoidTyID}})
+
+    INSTKEYWORD(fneg,  FNeg);
+
+    INSTKEYWORD(add,   Add);  INSTKEYWORD(fadd,   FAdd);
+    INSTKEYWORD(sub,   Sub);  INSTKEYWORD(fsub,   FSub);
+    INSTKEYWORD(mul,   Mul);  INSTKEYWORD(fmul,   FMul);
+    INSTKEYWORD(udiv, UDiv); INSTKEYWORD(sdiv, SDiv); INSTKEYWORD(fdiv, FDiv);
+    INSTKEYWORD(urem, URem); INSTKEYWORD(srem, SRem); INSTKEYWORD(frem, FRem);
+    INSTKEYWORD(shl,  Shl);  INSTKEYWORD(lshr, LShr); INSTKEYWORD(ashr, AShr);
+    INSTKEYWORD(and,   And);  INSTKEYWORD(or,    Or);   INSTKEYWORD(xor,   Xor);
+    INSTKEYWORD(icmp,  ICmp); INSTKEYWORD(fcmp,  FCmp);
+
+    INSTKEYWORD(phi,         PHI);
+    INSTKEYWORD(call,        Call);
+    INSTKEYWORD(trunc,       Trunc);
+    INSTKEYWORD(zext,        ZExt);
+    INSTKEYWORD(sext,        SExt);
+    INSTKEYWORD(fptrunc,     FPTrunc);
+    INSTKEYWORD(fpext,       FPExt);
+    INSTKEYWORD(uitofp,      UIToFP);
+    INSTKEYWORD(sitofp,      SIToFP);
+    INSTKEYWORD(fptoui,      FPToUI);
+    INSTKEYWORD(fptosi,      FPToSI);
+    INSTKEYWORD(inttoptr,    IntToPtr);
+    INSTKEYWORD(ptrtoint,    PtrToInt);
+    INSTKEYWORD(bitcast,     BitCast);
+    INSTKEYWORD(addrspacecast, AddrSpaceCast);
+    INSTKEYWORD(select,      Select);
+    INSTKEYWORD(va_arg,      VAArg);
+    INSTKEYWORD(ret,         Ret);
+    INSTKEYWORD(br,          Br);
+    INSTKEYWORD(switch,      Switch);
+    INSTKEYWORD(indirectbr,  IndirectBr);
+    INSTKEYWORD(invoke,      Invoke);
+    INSTKEYWORD(resume,      Resume);
+    INSTKEYWORD(unreachable, Unreachable);
+    INSTKEYWORD(callbr,      CallBr);
+
+    INSTKEYWORD(alloca,      Alloca);
+    INSTKEYWORD(load,        Load);
+    INSTKEYWORD(store,       Store);
+    INSTKEYWORD(cmpxchg,     AtomicCmpXchg);
+    INSTKEYWORD(atomicrmw,   AtomicRMW);
+    INSTKEYWORD(fence,       Fence);
+    INSTKEYWORD(getelementptr, GetElementPtr);
+
+    INSTKEYWORD(extractelement, ExtractElement);
+    INSTKEYWORD(insertelement,  InsertElement);
+    INSTKEYWORD(shufflevector,  ShuffleVector);
+    INSTKEYWORD(extractvalue,   ExtractValue);
+    INSTKEYWORD(insertvalue,    InsertValue);
+    INSTKEYWORD(landingpad,     LandingPad);
+    INSTKEYWORD(cleanupret,     CleanupRet);
+    INSTKEYWORD(catchret,       CatchRet);
+    INSTKEYWORD(catchswitch,  CatchSwitch);
+    INSTKEYWORD(catchpad,     CatchPad);
+    INSTKEYWORD(cleanuppad,   CleanupPad);
+
+#undef INSTKEYWORD
+
+    return Table;
+  }();
+  return KeywordTable;
+}
+
 /// Lex a label, integer type, keyword, or hexadecimal integer constant.
 ///    Label           [-a-zA-Z$._0-9]+:
 ///    IntegerType     i[0-9]+
@@ -456,9 +889,9 @@ lltok::Kind LLLexer::LexIdentifier() {
 
   for (; isLabelChar(*CurPtr); ++CurPtr) {
     // If we decide this is an integer, remember the end of the sequence.
-    if (!IntEnd && !isdigit(static_cast<unsigned char>(*CurPtr)))
+    if (!IntEnd && !isDigit(*CurPtr))
       IntEnd = CurPtr;
-    if (!KeywordEnd && !isalnum(static_cast<unsigned char>(*CurPtr)) &&
+    if (!KeywordEnd && !isAlnum(*CurPtr) &&
         *CurPtr != '_')
       KeywordEnd = CurPtr;
   }
@@ -491,397 +924,16 @@ lltok::Kind LLLexer::LexIdentifier() {
   --StartChar;
   StringRef Keyword(StartChar, CurPtr - StartChar);
 
-#define KEYWORD(STR)                                                           \
-  do {                                                                         \
-    if (Keyword == #STR)                                                       \
-      return lltok::kw_##STR;                                                  \
-  } while (false)
-
-  KEYWORD(true);    KEYWORD(false);
-  KEYWORD(declare); KEYWORD(define);
-  KEYWORD(global);  KEYWORD(constant);
-
-  KEYWORD(dso_local);
-  KEYWORD(dso_preemptable);
-
-  KEYWORD(private);
-  KEYWORD(internal);
-  KEYWORD(available_externally);
-  KEYWORD(linkonce);
-  KEYWORD(linkonce_odr);
-  KEYWORD(weak); // Use as a linkage, and a modifier for "cmpxchg".
-  KEYWORD(weak_odr);
-  KEYWORD(appending);
-  KEYWORD(dllimport);
-  KEYWORD(dllexport);
-  KEYWORD(common);
-  KEYWORD(default);
-  KEYWORD(hidden);
-  KEYWORD(protected);
-  KEYWORD(unnamed_addr);
-  KEYWORD(local_unnamed_addr);
-  KEYWORD(externally_initialized);
-  KEYWORD(extern_weak);
-  KEYWORD(external);
-  KEYWORD(thread_local);
-  KEYWORD(localdynamic);
-  KEYWORD(initialexec);
-  KEYWORD(localexec);
-  KEYWORD(zeroinitializer);
-  KEYWORD(undef);
-  KEYWORD(null);
-  KEYWORD(none);
-  KEYWORD(to);
-  KEYWORD(caller);
-  KEYWORD(within);
-  KEYWORD(from);
-  KEYWORD(tail);
-  KEYWORD(musttail);
-  KEYWORD(notail);
-  KEYWORD(target);
-  KEYWORD(triple);
-  KEYWORD(source_filename);
-  KEYWORD(unwind);
-  KEYWORD(deplibs);             // FIXME: Remove in 4.0.
-  KEYWORD(datalayout);
-  KEYWORD(volatile);
-  KEYWORD(atomic);
-  KEYWORD(unordered);
-  KEYWORD(monotonic);
-  KEYWORD(acquire);
-  KEYWORD(release);
-  KEYWORD(acq_rel);
-  KEYWORD(seq_cst);
-  KEYWORD(syncscope);
-
-  KEYWORD(nnan);
-  KEYWORD(ninf);
-  KEYWORD(nsz);
-  KEYWORD(arcp);
-  KEYWORD(contract);
-  KEYWORD(reassoc);
-  KEYWORD(afn);
-  KEYWORD(fast);
-  KEYWORD(nuw);
-  KEYWORD(nsw);
-  KEYWORD(exact);
-  KEYWORD(inbounds);
-  KEYWORD(inrange);
-  KEYWORD(align);
-  KEYWORD(addrspace);
-  KEYWORD(section);
-  KEYWORD(alias);
-  KEYWORD(ifunc);
-  KEYWORD(module);
-  KEYWORD(asm);
-  KEYWORD(sideeffect);
-  KEYWORD(alignstack);
-  KEYWORD(inteldialect);
-  KEYWORD(gc);
-  KEYWORD(prefix);
-  KEYWORD(prologue);
-
-  KEYWORD(ccc);
-  KEYWORD(fastcc);
-  KEYWORD(coldcc);
-  KEYWORD(x86_stdcallcc);
-  KEYWORD(x86_fastcallcc);
-  KEYWORD(x86_thiscallcc);
-  KEYWORD(x86_vectorcallcc);
-  KEYWORD(arm_apcscc);
-  KEYWORD(arm_aapcscc);
-  KEYWORD(arm_aapcs_vfpcc);
-  KEYWORD(aarch64_vector_pcs);
-  KEYWORD(msp430_intrcc);
-  KEYWORD(avr_intrcc);
-  KEYWORD(avr_signalcc);
-  KEYWORD(ptx_kernel);
-  KEYWORD(ptx_device);
-  KEYWORD(spir_kernel);
-  KEYWORD(spir_func);
-  KEYWORD(intel_ocl_bicc);
-  KEYWORD(x86_64_sysvcc);
-  KEYWORD(win64cc);
-  KEYWORD(x86_regcallcc);
-  KEYWORD(webkit_jscc);
-  KEYWORD(swiftcc);
-  KEYWORD(anyregcc);
-  KEYWORD(preserve_mostcc);
-  KEYWORD(preserve_allcc);
-  KEYWORD(ghccc);
-  KEYWORD(x86_intrcc);
-  KEYWORD(hhvmcc);
-  KEYWORD(hhvm_ccc);
-  KEYWORD(cxx_fast_tlscc);
-  KEYWORD(amdgpu_vs);
-  KEYWORD(amdgpu_ls);
-  KEYWORD(amdgpu_hs);
-  KEYWORD(amdgpu_es);
-  KEYWORD(amdgpu_gs);
-  KEYWORD(amdgpu_ps);
-  KEYWORD(amdgpu_cs);
-  KEYWORD(amdgpu_kernel);
-
-  KEYWORD(cc);
-  KEYWORD(c);
-
-  KEYWORD(attributes);
-
-  KEYWORD(alwaysinline);
-  KEYWORD(allocsize);
-  KEYWORD(argmemonly);
-  KEYWORD(builtin);
-  KEYWORD(byval);
-  KEYWORD(inalloca);
-  KEYWORD(cold);
-  KEYWORD(convergent);
-  KEYWORD(dereferenceable);
-  KEYWORD(dereferenceable_or_null);
-  KEYWORD(inaccessiblememonly);
-  KEYWORD(inaccessiblemem_or_argmemonly);
-  KEYWORD(inlinehint);
-  KEYWORD(inreg);
-  KEYWORD(jumptable);
-  KEYWORD(minsize);
-  KEYWORD(naked);
-  KEYWORD(nest);
-  KEYWORD(noalias);
-  KEYWORD(nobuiltin);
-  KEYWORD(nocapture);
-  KEYWORD(noduplicate);
-  KEYWORD(noimplicitfloat);
-  KEYWORD(noinline);
-  KEYWORD(norecurse);
-  KEYWORD(nonlazybind);
-  KEYWORD(nonnull);
-  KEYWORD(noredzone);
-  KEYWORD(noreturn);
-  KEYWORD(nocf_check);
-  KEYWORD(nounwind);
-  KEYWORD(optforfuzzing);
-  KEYWORD(optnone);
-  KEYWORD(optsize);
-  KEYWORD(readnone);
-  KEYWORD(readonly);
-  KEYWORD(returned);
-  KEYWORD(returns_twice);
-  KEYWORD(signext);
-  KEYWORD(speculatable);
-  KEYWORD(sret);
-  KEYWORD(ssp);
-  KEYWORD(sspreq);
-  KEYWORD(sspstrong);
-  KEYWORD(strictfp);
-  KEYWORD(safestack);
-  KEYWORD(shadowcallstack);
-  KEYWORD(sanitize_address);
-  KEYWORD(sanitize_hwaddress);
-  KEYWORD(sanitize_thread);
-  KEYWORD(sanitize_memory);
-  KEYWORD(speculative_load_hardening);
-  KEYWORD(swifterror);
-  KEYWORD(swiftself);
-  KEYWORD(uwtable);
-  KEYWORD(writeonly);
-  KEYWORD(zeroext);
-  KEYWORD(immarg);
-
-  KEYWORD(type);
-  KEYWORD(opaque);
-
-  KEYWORD(comdat);
-
-  // Comdat types
-  KEYWORD(any);
-  KEYWORD(exactmatch);
-  KEYWORD(largest);
-  KEYWORD(noduplicates);
-  KEYWORD(samesize);
-
-  KEYWORD(eq); KEYWORD(ne); KEYWORD(slt); KEYWORD(sgt); KEYWORD(sle);
-  KEYWORD(sge); KEYWORD(ult); KEYWORD(ugt); KEYWORD(ule); KEYWORD(uge);
-  KEYWORD(oeq); KEYWORD(one); KEYWORD(olt); KEYWORD(ogt); KEYWORD(ole);
-  KEYWORD(oge); KEYWORD(ord); KEYWORD(uno); KEYWORD(ueq); KEYWORD(une);
-
-  KEYWORD(xchg); KEYWORD(nand); KEYWORD(max); KEYWORD(min); KEYWORD(umax);
-  KEYWORD(umin);
-
-  KEYWORD(x);
-  KEYWORD(blockaddress);
-
-  // Metadata types.
-  KEYWORD(distinct);
-
-  // Use-list order directives.
-  KEYWORD(uselistorder);
-  KEYWORD(uselistorder_bb);
-
-  KEYWORD(personality);
-  KEYWORD(cleanup);
-  KEYWORD(catch);
-  KEYWORD(filter);
-
-  // Summary index keywords.
-  KEYWORD(path);
-  KEYWORD(hash);
-  KEYWORD(gv);
-  KEYWORD(guid);
-  KEYWORD(name);
-  KEYWORD(summaries);
-  KEYWORD(flags);
-  KEYWORD(linkage);
-  KEYWORD(notEligibleToImport);
-  KEYWORD(live);
-  KEYWORD(dsoLocal);
-  KEYWORD(function);
-  KEYWORD(insts);
-  KEYWORD(funcFlags);
-  KEYWORD(readNone);
-  KEYWORD(readOnly);
-  KEYWORD(noRecurse);
-  KEYWORD(returnDoesNotAlias);
-  KEYWORD(noInline);
-  KEYWORD(calls);
-  KEYWORD(callee);
-  KEYWORD(hotness);
-  KEYWORD(unknown);
-  KEYWORD(hot);
-  KEYWORD(critical);
-  KEYWORD(relbf);
-  KEYWORD(variable);
-  KEYWORD(aliasee);
-  KEYWORD(refs);
-  KEYWORD(typeIdInfo);
-  KEYWORD(typeTests);
-  KEYWORD(typeTestAssumeVCalls);
-  KEYWORD(typeCheckedLoadVCalls);
-  KEYWORD(typeTestAssumeConstVCalls);
-  KEYWORD(typeCheckedLoadConstVCalls);
-  KEYWORD(vFuncId);
-  KEYWORD(offset);
-  KEYWORD(args);
-  KEYWORD(typeid);
-  KEYWORD(summary);
-  KEYWORD(typeTestRes);
-  KEYWORD(kind);
-  KEYWORD(unsat);
-  KEYWORD(byteArray);
-  KEYWORD(inline);
-  KEYWORD(single);
-  KEYWORD(allOnes);
-  KEYWORD(sizeM1BitWidth);
-  KEYWORD(alignLog2);
-  KEYWORD(sizeM1);
-  KEYWORD(bitMask);
-  KEYWORD(inlineBits);
-  KEYWORD(wpdResolutions);
-  KEYWORD(wpdRes);
-  KEYWORD(indir);
-  KEYWORD(singleImpl);
-  KEYWORD(branchFunnel);
-  KEYWORD(singleImplName);
-  KEYWORD(resByArg);
-  KEYWORD(byArg);
-  KEYWORD(uniformRetVal);
-  KEYWORD(uniqueRetVal);
-  KEYWORD(virtualConstProp);
-  KEYWORD(info);
-  KEYWORD(byte);
-  KEYWORD(bit);
-  KEYWORD(varFlags);
-
-#undef KEYWORD
-
-  // Keywords for types.
-#define TYPEKEYWORD(STR, LLVMTY)                                               \
-  do {                                                                         \
-    if (Keyword == STR) {                                                      \
-      TyVal = LLVMTY;                                                          \
-      return lltok::Type;                                                      \
-    }                                                                          \
-  } while (false)
-
-  TYPEKEYWORD("void",      Type::getVoidTy(Context));
-  TYPEKEYWORD("half",      Type::getHalfTy(Context));
-  TYPEKEYWORD("float",     Type::getFloatTy(Context));
-  TYPEKEYWORD("double",    Type::getDoubleTy(Context));
-  TYPEKEYWORD("x86_fp80",  Type::getX86_FP80Ty(Context));
-  TYPEKEYWORD("fp128",     Type::getFP128Ty(Context));
-  TYPEKEYWORD("ppc_fp128", Type::getPPC_FP128Ty(Context));
-  TYPEKEYWORD("label",     Type::getLabelTy(Context));
-  TYPEKEYWORD("metadata",  Type::getMetadataTy(Context));
-  TYPEKEYWORD("x86_mmx",   Type::getX86_MMXTy(Context));
-  TYPEKEYWORD("token",     Type::getTokenTy(Context));
-
-#undef TYPEKEYWORD
-
-  // Keywords for instructions.
-#define INSTKEYWORD(STR, Enum)                                                 \
-  do {                                                                         \
-    if (Keyword == #STR) {                                                     \
-      UIntVal = Instruction::Enum;                                             \
-      return lltok::kw_##STR;                                                  \
-    }                                                                          \
-  } while (false)
-
-  INSTKEYWORD(fneg,  FNeg);
-
-  INSTKEYWORD(add,   Add);  INSTKEYWORD(fadd,   FAdd);
-  INSTKEYWORD(sub,   Sub);  INSTKEYWORD(fsub,   FSub);
-  INSTKEYWORD(mul,   Mul);  INSTKEYWORD(fmul,   FMul);
-  INSTKEYWORD(udiv,  UDiv); INSTKEYWORD(sdiv,  SDiv); INSTKEYWORD(fdiv,  FDiv);
-  INSTKEYWORD(urem,  URem); INSTKEYWORD(srem,  SRem); INSTKEYWORD(frem,  FRem);
-  INSTKEYWORD(shl,   Shl);  INSTKEYWORD(lshr,  LShr); INSTKEYWORD(ashr,  AShr);
-  INSTKEYWORD(and,   And);  INSTKEYWORD(or,    Or);   INSTKEYWORD(xor,   Xor);
-  INSTKEYWORD(icmp,  ICmp); INSTKEYWORD(fcmp,  FCmp);
-
-  INSTKEYWORD(phi,         PHI);
-  INSTKEYWORD(call,        Call);
-  INSTKEYWORD(trunc,       Trunc);
-  INSTKEYWORD(zext,        ZExt);
-  INSTKEYWORD(sext,        SExt);
-  INSTKEYWORD(fptrunc,     FPTrunc);
-  INSTKEYWORD(fpext,       FPExt);
-  INSTKEYWORD(uitofp,      UIToFP);
-  INSTKEYWORD(sitofp,      SIToFP);
-  INSTKEYWORD(fptoui,      FPToUI);
-  INSTKEYWORD(fptosi,      FPToSI);
-  INSTKEYWORD(inttoptr,    IntToPtr);
-  INSTKEYWORD(ptrtoint,    PtrToInt);
-  INSTKEYWORD(bitcast,     BitCast);
-  INSTKEYWORD(addrspacecast, AddrSpaceCast);
-  INSTKEYWORD(select,      Select);
-  INSTKEYWORD(va_arg,      VAArg);
-  INSTKEYWORD(ret,         Ret);
-  INSTKEYWORD(br,          Br);
-  INSTKEYWORD(switch,      Switch);
-  INSTKEYWORD(indirectbr,  IndirectBr);
-  INSTKEYWORD(invoke,      Invoke);
-  INSTKEYWORD(resume,      Resume);
-  INSTKEYWORD(unreachable, Unreachable);
-  INSTKEYWORD(callbr,      CallBr);
-
-  INSTKEYWORD(alloca,      Alloca);
-  INSTKEYWORD(load,        Load);
-  INSTKEYWORD(store,       Store);
-  INSTKEYWORD(cmpxchg,     AtomicCmpXchg);
-  INSTKEYWORD(atomicrmw,   AtomicRMW);
-  INSTKEYWORD(fence,       Fence);
-  INSTKEYWORD(getelementptr, GetElementPtr);
-
-  INSTKEYWORD(extractelement, ExtractElement);
-  INSTKEYWORD(insertelement,  InsertElement);
-  INSTKEYWORD(shufflevector,  ShuffleVector);
-  INSTKEYWORD(extractvalue,   ExtractValue);
-  INSTKEYWORD(insertvalue,    InsertValue);
-  INSTKEYWORD(landingpad,     LandingPad);
-  INSTKEYWORD(cleanupret,     CleanupRet);
-  INSTKEYWORD(catchret,       CatchRet);
-  INSTKEYWORD(catchswitch,  CatchSwitch);
-  INSTKEYWORD(catchpad,     CatchPad);
-  INSTKEYWORD(cleanuppad,   CleanupPad);
-
-#undef INSTKEYWORD
+  const StringMap<KeywordInfo> &KeywordTable = getKeywordTable();
+  auto KW = KeywordTable.find(Keyword);
+  if (KW != KeywordTable.end()) {
+    const KeywordInfo &Info = KW->second;
+    if (Info.Kind == lltok::Type)
+      TyVal = Type::getPrimitiveType(Context, Info.TyID);
+    else if (Info.Opcode)
+      UIntVal = Info.Opcode;
+    return Info.Kind;
+  }
 
 #define DWKEYWORD(TYPE, TOKEN)                                                 \
   do {                                                                         \
@@ -1030,8 +1082,8 @@ lltok::Kind LLLexer::Lex0x() {
 ///    HexPPC128Constant 0xM[0-9A-Fa-f]+
 lltok::Kind LLLexer::LexDigitOrNegative() {
   // If the letter after the negative is not a number, this is probably a label.
-  if (!isdigit(static_cast<unsigned char>(TokStart[0])) &&
-      !isdigit(static_cast<unsigned char>(CurPtr[0]))) {
+  if (!isDigit(TokStart[0]) &&
+      !isDigit(CurPtr[0])) {
     // Okay, this is not a number after the -, it's probably a label.
     if (const char *End = isLabelTail(CurPtr)) {
       StrVal.assign(TokStart, End-1);
@@ -1045,7 +1097,7 @@ lltok::Kind LLLexer::LexDigitOrNegative() {
   // At this point, it is either a label, int or fp constant.
 
   // Skip digits, we have at least one.
-  for (; isdigit(static_cast<unsigned char>(CurPtr[0])); ++CurPtr)
+  for (; isDigit(CurPtr[0]); ++CurPtr)
     /*empty*/;
 
   // Check if this is a fully-numeric label:
@@ -1079,14 +1131,14 @@ lltok::Kind LLLexer::LexDigitOrNegative() {
   ++CurPtr;
 
   // Skip over [0-9]*([eE][-+]?[0-9]+)?
-  while (isdigit(static_cast<unsigned char>(CurPtr[0]))) ++CurPtr;
+  while (isDigit(CurPtr[0])) ++CurPtr;
 
   if (CurPtr[0] == 'e' || CurPtr[0] == 'E') {
-    if (isdigit(static_cast<unsigned char>(CurPtr[1])) ||
+    if (isDigit(CurPtr[1]) ||
         ((CurPtr[1] == '-' || CurPtr[1] == '+') &&
-          isdigit(static_cast<unsigned char>(CurPtr[2])))) {
+          isDigit(CurPtr[2]))) {
       CurPtr += 2;
-      while (isdigit(static_cast<unsigned char>(CurPtr[0]))) ++CurPtr;
+      while (isDigit(CurPtr[0])) ++CurPtr;
     }
   }
 
@@ -1100,11 +1152,11 @@ lltok::Kind LLLexer::LexDigitOrNegative() {
 lltok::Kind LLLexer::LexPositive() {
   // If the letter after the negative is a number, this is probably not a
   // label.
-  if (!isdigit(static_cast<unsigned char>(CurPtr[0])))
+  if (!isDigit(CurPtr[0]))
     return lltok::Error;
 
   // Skip digits.
-  for (++CurPtr; isdigit(static_cast<unsigned char>(CurPtr[0])); ++CurPtr)
+  for (++CurPtr; isDigit(CurPtr[0]); ++CurPtr)
     /*empty*/;
 
   // At this point, we need a '.'.
@@ -1116,14 +1168,14 @@ lltok::Kind LLLexer::LexPositive() {
   ++CurPtr;
 
   // Skip over [0-9]*([eE][-+]?[0-9]+)?
-  while (isdigit(static_cast<unsigned char>(CurPtr[0]))) ++CurPtr;
+  while (isDigit(CurPtr[0])) ++CurPtr;
 
   if (CurPtr[0] == 'e' || CurPtr[0] == 'E') {
-    if (isdigit(static_cast<unsigned char>(CurPtr[1])) ||
+    if (isDigit(CurPtr[1]) ||
         ((CurPtr[1] == '-' || CurPtr[1] == '+') &&
-        isdigit(static_cast<unsigned char>(CurPtr[2])))) {
+        isDigit(CurPtr[2]))) {
       CurPtr += 2;
-      while (isdigit(static_cast<unsigned char>(CurPtr[0]))) ++CurPtr;
+      while (isDigit(CurPtr[0])) ++CurPtr;
     }
   }
 
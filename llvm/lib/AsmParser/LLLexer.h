@@ -53,6 +53,16 @@ namespace llvm {
       return CurKind = LexToken();
     }
 
+    /// Go back (or forward) to a token lexed before, and lex it again.
+    lltok::Kind LexAt(SMLoc Loc) {
+      CurPtr = Loc.getPointer();
+      return Lex();
+    }
+
+    /// Step over the rest of a braced block when at its '{', without lexing
+    /// it. Returns false if it runs into the end of the buffer instead.
+    bool SkipBraces();
+
     typedef SMLoc LocTy;
     LocTy getLoc() const { return SMLoc::getFromPointer(TokStart); }
     lltok::Kind getKind() const { return CurKind; }
@@ -77,6 +87,7 @@ namespace llvm {
 
     int getNextChar();
     void SkipLineComment();
+    bool SkipToQuote();
     lltok::Kind ReadString(lltok::Kind kind);
     bool ReadVarName();
 
@@ -31,6 +31,7 @@
 #include "llvm/IR/GlobalObject.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
@@ -41,6 +42,7 @@
 #include "llvm/IR/Value.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/SaveAndRestore.h"
@@ -53,6 +55,12 @@
 
 using namespace llvm;
 
+static cl::opt<bool> DeferFunctionBodies(
+    "ll-defer-function-bodies", cl::Hidden, cl::init(false),
+    cl::desc("Parse function bodies after every other top-level entity, so "
+             "that the globals and metadata they use are already defined. "
+             "Use lists may come out in a different order."));
+
 static std::string getTypeString(Type *T) {
   std::string Result;
   raw_string_ostream Tmp(Result);
@@ -70,8 +78,8 @@ bool LLParser::Run() {
         Lex.getLoc(),
         "Can't read textual IR with a Context that discards named Values");
 
-  return ParseTopLevelEntities() || ValidateEndOfModule() ||
-         ValidateEndOfIndex();
+  return ParseTopLevelEntities() || ParseDeferredFunctionBodies() ||
+         ValidateEndOfModule() || ValidateEndOfIndex();
 }
 
 bool LLParser::parseStandaloneConstantValue(Constant *&C,
@@ -340,9 +348,14 @@ bool LLParser::ParseTopLevelEntities() {
       break;
     case lltok::MetadataVar:if (ParseNamedMetadata()) return true; break;
     case lltok::kw_attributes: if (ParseUnnamedAttrGrp()) return true; break;
-    case lltok::kw_uselistorder: if (ParseUseListOrder()) return true; break;
+    // Use list orders need every use in place, so any deferred function bodies
+    // are parsed first.
+    case lltok::kw_uselistorder:
+      if (ParseDeferredFunctionBodies() || ParseUseListOrder())
+        return true;
+      break;
     case lltok::kw_uselistorder_bb:
-      if (ParseUseListOrderBB())
+      if (ParseDeferredFunctionBodies() || ParseUseListOrderBB())
         return true;
       break;
     }
@@ -506,9 +519,59 @@ bool LLParser::ParseDefine() {
   Lex.Lex();
 
   Function *F;
-  return ParseFunctionHeader(F, true) ||
-         ParseOptionalFunctionMetadata(*F) ||
-         ParseFunctionBody(*F);
+  if (ParseFunctionHeader(F, true) || ParseOptionalFunctionMetadata(*F))
+    return true;
+
+  int FunctionNumber = -1;
+  if (!F->hasName()) FunctionNumber = NumberedVals.size()-1;
+
+  if (DeferFunctionBodies) {
+    DeferredFunctionBodies.push_back({F, Lex.getLoc(), FunctionNumber});
+    return SkipFunctionBody();
+  }
+  return ParseFunctionBody(*F, FunctionNumber);
+}
+
+/// SkipFunctionBody - Step over a function body without parsing it, leaving it
+/// to ParseDeferredFunctionBodies. The body is not lexed here, only scanned
+/// for its closing brace.
+bool LLParser::SkipFunctionBody() {
+  if (Lex.getKind() != lltok::lbrace)
+    return TokError("expected '{' in function body");
+  if (!Lex.SkipBraces())
+    return TokError("expected '}' at end of function body");
+  Lex.Lex();
+  return false;
+}
+
+/// ParseDeferredFunctionBodies - Parse the function bodies skipped so far, in
+/// the order they appear, then continue lexing where we left off.
+bool LLParser::ParseDeferredFunctionBodies() {
+  if (DeferredFunctionBodies.empty())
+    return false;
+
+  // The bodies stay listed while they are parsed, so that blockaddress
+  // references to the ones still pending are recognized.
+  LocTy ResumeLoc = Lex.getLoc();
+  for (size_t I = 0; I != DeferredFunctionBodies.size(); ++I) {
+    DeferredFunctionBody Body = DeferredFunctionBodies[I];
+    Lex.LexAt(Body.BodyLoc);
+    if (ParseFunctionBody(*Body.Fn, Body.FunctionNumber))
+      return true;
+  }
+  DeferredFunctionBodies.clear();
+  Lex.LexAt(ResumeLoc);
+  return false;
+}
+
+/// isDeferredFunction - Return true if F has a body that was skipped and has
+/// not been parsed yet.
+bool LLParser::isDeferredFunction(const Function *F) const {
+  return F->isDeclaration() &&
+         llvm::any_of(DeferredFunctionBodies,
+                      [&](const DeferredFunctionBody &Body) {
+                        return Body.Fn == F;
+                      });
 }
 
 /// ParseGlobalType
@@ -3166,7 +3229,11 @@ bool LLParser::ParseValID(ValID &ID, PerFunctionState *PFS) {
       if (!isa<Function>(GV))
         return Error(Fn.Loc, "expected function name in blockaddress");
       F = cast<Function>(GV);
-      if (F->isDeclaration())
+      // A deferred body is parsed later, so its blocks are referenced like
+      // those of a function that is not defined yet.
+      if (isDeferredFunction(F))
+        F = nullptr;
+      else if (F->isDeclaration())
         return Error(Fn.Loc, "cannot take blockaddress inside a declaration");
     }
 
@@ -5485,15 +5552,13 @@ bool LLParser::PerFunctionState::resolveForwardRefBlockAddresses() {
 
 /// ParseFunctionBody
 ///   ::= '{' BasicBlock+ UseListOrderDirective* '}'
-bool LLParser::ParseFunctionBody(Function &Fn) {
+bool LLParser::ParseFunctionBody(Function &Fn, int FunctionNumber) {
   if (Lex.getKind() != lltok::lbrace)
     return TokError("expected '{' in function body");
   Lex.Lex();  // eat the {.
 
-  int FunctionNumber = -1;
-  if (!Fn.hasName()) FunctionNumber = NumberedVals.size()-1;
-
   PerFunctionState PFS(*this, Fn, FunctionNumber);
+  InstructionArena::Scope ArenaScope(Fn);
 
   // Resolve block addresses and allow basic blocks to be forward-declared
   // within this function.
@@ -129,6 +129,16 @@ namespace llvm {
     // Comdat forward reference information.
     std::map<std::string, LocTy> ForwardRefComdats;
 
+    // Function bodies skipped with -ll-defer-function-bodies, in the order they
+    // appear in the file, with where each starts and the number of its
+    // function if it is unnamed.
+    struct DeferredFunctionBody {
+      Function *Fn;
+      LocTy BodyLoc;
+      int FunctionNumber;
+    };
+    std::vector<DeferredFunctionBody> DeferredFunctionBodies;
+
     // References to blockaddress.  The key is the function ValID, the value is
     // a list of references to blocks in that function.
     std::map<ValID, std::map<ValID, GlobalValue *>> ForwardRefBlockAddresses;
@@ -547,7 +557,10 @@ namespace llvm {
     };
     bool ParseArgumentList(SmallVectorImpl<ArgInfo> &ArgList, bool &isVarArg);
     bool ParseFunctionHeader(Function *&Fn, bool isDefine);
-    bool ParseFunctionBody(Function &Fn);
+    bool ParseFunctionBody(Function &Fn, int FunctionNumber);
+    bool SkipFunctionBody();
+    bool ParseDeferredFunctionBodies();
+    bool isDeferredFunction(const Function *F) const;
     bool ParseBasicBlock(PerFunctionState &PFS);
 
     enum TailCallType { TCT_None, TCT_Tail, TCT_MustTail };
@@ -49,6 +49,7 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
@@ -3424,6 +3425,7 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
     return error("Invalid function metadata: incoming forward references");
 
   InstructionList.clear();
+  InstructionArena::Scope ArenaScope(*F);
   unsigned ModuleValueListSize = ValueList.size();
   unsigned ModuleMDLoaderSize = MDLoader->size();
 
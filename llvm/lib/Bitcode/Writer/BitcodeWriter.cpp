@@ -67,6 +67,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/SHA1.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -86,6 +87,11 @@ static cl::opt<unsigned>
                    cl::desc("Number of metadatas above which we emit an index "
                             "to enable lazy-loading"));
 
+static cl::opt<unsigned> WriterThreads(
+    "bitcode-writer-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads encoding function blocks; the output is the "
+             "same for any number"));
+
 cl::opt<bool> WriteRelBFToSummary(
     "write-relbf-to-summary", cl::Hidden, cl::init(false),
     cl::desc("Write relative block frequency to function summary "));
@@ -202,6 +208,15 @@ public:
               assignValueId(CallEdge.first.getGUID());
   }
 
+  /// Constructs a ModuleBitcodeWriterBase object with a copy of \p Other's
+  /// value numbering, writing to the provided \p Stream.
+  ModuleBitcodeWriterBase(const ModuleBitcodeWriterBase &Other,
+                          BitstreamWriter &Stream)
+      : BitcodeWriterBase(Stream, Other.StrtabBuilder), M(Other.M),
+        VE(Other.VE), Index(Other.Index),
+        GUIDToValueIdMap(Other.GUIDToValueIdMap),
+        GlobalValueId(Other.GlobalValueId) {}
+
 protected:
   void writePerModuleGlobalValueSummary();
 
@@ -269,6 +284,13 @@ public:
         Buffer(Buffer), GenerateHash(GenerateHash), ModHash(ModHash),
         BitcodeStartBit(Stream.GetCurrentBitNo()) {}
 
+  /// Constructs a ModuleBitcodeWriter object that writes function blocks of
+  /// \p Other's module to \p Stream, numbering values the same way.
+  ModuleBitcodeWriter(const ModuleBitcodeWriter &Other,
+                      BitstreamWriter &Stream)
+      : ModuleBitcodeWriterBase(Other, Stream), Buffer(Other.Buffer),
+        GenerateHash(false), ModHash(nullptr), BitcodeStartBit(0) {}
+
   /// Emit the current module to the bitstream.
   void write();
 
@@ -384,6 +406,8 @@ private:
       DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
   void writeUseList(UseListOrder &&Order);
   void writeUseListBlock(const Function *F);
+  void writeFunctionsInParallel(
+      DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
   void
   writeFunction(const Function &F,
                 DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
@@ -3203,6 +3227,61 @@ void ModuleBitcodeWriter::writeFunction(
   Stream.ExitBlock();
 }
 
+/// Encode the function blocks on up to -bitcode-writer-threads threads. Each
+/// thread writes a contiguous run of functions to its own stream, with its own
+/// copy of the value numbering; purgeFunction leaves the numbering as it found
+/// it, so every block comes out as it would have here. The blocks are then
+/// spliced into this stream in function order.
+void ModuleBitcodeWriter::writeFunctionsInParallel(
+    DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex) {
+  std::vector<const Function *> Functions;
+  for (const Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+
+  unsigned NumWorkers = std::min<size_t>(WriterThreads, Functions.size());
+  std::vector<SmallVector<char, 0>> Buffers(NumWorkers);
+  // The [begin, end) byte range of each function's block contents in the
+  // buffer of the worker that wrote it.
+  std::vector<std::pair<size_t, size_t>> Contents(Functions.size());
+
+  ThreadPool Pool(NumWorkers);
+  for (unsigned W = 0; W != NumWorkers; ++W) {
+    size_t Begin = Functions.size() * W / NumWorkers;
+    size_t End = Functions.size() * (W + 1) / NumWorkers;
+    Pool.async([&, W, Begin, End]() {
+      BitstreamWriter WorkerStream(Buffers[W]);
+      WorkerStream.copyBlockInfo(Stream);
+      ModuleBitcodeWriter Worker(*this, WorkerStream);
+      DenseMap<const Function *, uint64_t> WorkerIndex;
+      for (size_t I = Begin; I != End; ++I) {
+        // The contents start after the header and size word, which are one
+        // word each once EnterSubblock has aligned them.
+        Contents[I].first = Buffers[W].size() + 8;
+        Worker.writeFunction(*Functions[I], WorkerIndex);
+        Contents[I].second = Buffers[W].size();
+      }
+    });
+  }
+  Pool.wait();
+
+  for (unsigned W = 0; W != NumWorkers; ++W) {
+    size_t Begin = Functions.size() * W / NumWorkers;
+    size_t End = Functions.size() * (W + 1) / NumWorkers;
+    for (size_t I = Begin; I != End; ++I) {
+      assert(support::endian::read32le(&Buffers[W][Contents[I].first - 4]) *
+                     4 ==
+                 Contents[I].second - Contents[I].first &&
+             "Function block contents misplaced");
+      FunctionToBitcodeIndex[Functions[I]] = Stream.GetCurrentBitNo();
+      Stream.EmitEncodedSubblock(
+          bitc::FUNCTION_BLOCK_ID, 4,
+          makeArrayRef(Buffers[W]).slice(
+              Contents[I].first, Contents[I].second - Contents[I].first));
+    }
+  }
+}
+
 // Emit blockinfo, which defines the standard abbreviations etc.
 void ModuleBitcodeWriter::writeBlockInfo() {
   // We only want to emit block info records for blocks that have multiple
@@ -4142,9 +4221,12 @@ void ModuleBitcodeWriter::write() {
 
   // Emit function bodies.
   DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
-  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
-    if (!F->isDeclaration())
-      writeFunction(*F, FunctionToBitcodeIndex);
+  if (WriterThreads > 1 && !VE.shouldPreserveUseListOrder())
+    writeFunctionsInParallel(FunctionToBitcodeIndex);
+  else
+    for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration())
+        writeFunction(*F, FunctionToBitcodeIndex);
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
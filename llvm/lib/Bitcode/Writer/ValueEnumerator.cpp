@@ -317,6 +317,24 @@ static bool isIntOrIntVectorValue(const std::pair<const Value*, unsigned> &V) {
   return V.first->getType()->isIntOrIntVectorTy();
 }
 
+ValueEnumerator::ValueEnumerator(const ValueEnumerator &Other)
+    : TypeMap(Other.TypeMap), Types(Other.Types), ValueMap(Other.ValueMap),
+      Values(Other.Values), Comdats(Other.Comdats), MDs(Other.MDs),
+      MetadataMap(Other.MetadataMap), FunctionMDInfo(Other.FunctionMDInfo),
+      ShouldPreserveUseListOrder(Other.ShouldPreserveUseListOrder),
+      AttributeGroupMap(Other.AttributeGroupMap),
+      AttributeGroups(Other.AttributeGroups),
+      AttributeListMap(Other.AttributeListMap),
+      AttributeLists(Other.AttributeLists),
+      GlobalBasicBlockIDs(Other.GlobalBasicBlockIDs),
+      InstructionMap(Other.InstructionMap), NumModuleMDs(Other.NumModuleMDs),
+      NumMDStrings(Other.NumMDStrings) {
+  assert(Other.UseListOrders.empty() &&
+         "Use-list orders are consumed in function order");
+  assert(Other.BasicBlocks.empty() && Other.FunctionMDs.empty() &&
+         "Copying a function's numbering");
+}
+
 ValueEnumerator::ValueEnumerator(const Module &M,
                                  bool ShouldPreserveUseListOrder)
     : ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
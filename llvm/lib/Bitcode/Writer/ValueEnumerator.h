@@ -140,7 +140,10 @@ private:
 
 public:
   ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
-  ValueEnumerator(const ValueEnumerator &) = delete;
+  /// Copy the module-level numbering of \p Other, which must not be
+  /// preserving use-list order or have a function incorporated, so that
+  /// function blocks can be written on another thread.
+  ValueEnumerator(const ValueEnumerator &Other);
   ValueEnumerator &operator=(const ValueEnumerator &) = delete;
 
   void dump() const;
@@ -68,11 +68,13 @@
 #include "llvm/IR/Value.h"
 #include "llvm/Support/AtomicOrdering.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -91,6 +93,10 @@ using namespace llvm;
 // Make virtual table appear in this compilation unit.
 AssemblyAnnotationWriter::~AssemblyAnnotationWriter() = default;
 
+static cl::opt<unsigned> AsmWriterThreads(
+    "asm-writer-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads printing function bodies in Module::print"));
+
 //===----------------------------------------------------------------------===//
 // Helper Functions
 //===----------------------------------------------------------------------===//
@@ -463,7 +469,8 @@ class TypePrinting {
 public:
   TypePrinting(const Module *M = nullptr) : DeferredM(M) {}
 
-  TypePrinting(const TypePrinting &) = delete;
+  /// Copies give the threads printing functions their own numbering state.
+  TypePrinting(const TypePrinting &) = default;
   TypePrinting &operator=(const TypePrinting &) = delete;
 
   /// The named types that are used by the current module.
@@ -727,7 +734,8 @@ public:
   /// Construct from a module summary index.
   explicit SlotTracker(const ModuleSummaryIndex *Index);
 
-  SlotTracker(const SlotTracker &) = delete;
+  /// Copies let functions be incorporated on several threads at once.
+  SlotTracker(const SlotTracker &) = default;
   SlotTracker &operator=(const SlotTracker &) = delete;
 
   /// Return the slot number of the specified value in it's type
@@ -777,6 +785,12 @@ public:
   inline void initializeIfNeeded();
   void initializeIndexIfNeeded();
 
+  /// Create the metadata and attribute group slots that incorporating each
+  /// function of \p M in turn would, without numbering their local values.
+  /// Copies of the tracker then agree on those slots whichever functions
+  /// they incorporate.
+  void processFunctionGlobals(const Module &M);
+
   // Implementation Details
 private:
   /// CreateModuleSlot - Insert the specified GlobalValue* into the slot table.
@@ -811,6 +825,9 @@ private:
 
   /// Add all of the metadata from an instruction.
   void processInstructionMetadata(const Instruction &I);
+
+  /// Add the function attributes of a call.
+  void processCallAttributes(const Instruction &I);
 };
 
 } // end namespace llvm
@@ -994,14 +1011,7 @@ void SlotTracker::processFunction() {
       if (!I.getType()->isVoidTy() && !I.hasName())
         CreateFunctionSlot(&I);
 
-      // We allow direct calls to any llvm.foo function here, because the
-      // target may not be linked into the optimizer.
-      if (const auto *Call = dyn_cast<CallBase>(&I)) {
-        // Add all the call attributes to the table.
-        AttributeSet Attrs = Call->getAttributes().getFnAttributes();
-        if (Attrs.hasAttributes())
-          CreateAttributeSetSlot(Attrs);
-      }
+      processCallAttributes(I);
     }
   }
 
@@ -1010,6 +1020,18 @@ void SlotTracker::processFunction() {
   ST_DEBUG("end processFunction!\n");
 }
 
+void SlotTracker::processFunctionGlobals(const Module &M) {
+  initializeIfNeeded();
+
+  for (const Function &F : M) {
+    if (!ShouldInitializeAllMetadata)
+      processFunctionMetadata(F);
+    for (auto &BB : F)
+      for (auto &I : BB)
+        processCallAttributes(I);
+  }
+}
+
 // Iterate through all the GUID in the index and create slots for them.
 void SlotTracker::processIndex() {
   ST_DEBUG("begin processIndex!\n");
@@ -1055,6 +1077,17 @@ void SlotTracker::processFunctionMetadata(const Function &F) {
   }
 }
 
+void SlotTracker::processCallAttributes(const Instruction &I) {
+  // We allow direct calls to any llvm.foo function here, because the
+  // target may not be linked into the optimizer.
+  if (const auto *Call = dyn_cast<CallBase>(&I)) {
+    // Add all the call attributes to the table.
+    AttributeSet Attrs = Call->getAttributes().getFnAttributes();
+    if (Attrs.hasAttributes())
+      CreateAttributeSetSlot(Attrs);
+  }
+}
+
 void SlotTracker::processInstructionMetadata(const Instruction &I) {
   // Process metadata used directly by intrinsics.
   if (const CallInst *CI = dyn_cast<CallInst>(&I))
@@ -1278,6 +1311,96 @@ static void WriteOptimizationInfo(raw_ostream &Out, const User *U) {
   }
 }
 
+static void WriteAPFloatInternal(raw_ostream &Out, const APFloat &APF) {
+  if (&APF.getSemantics() == &APFloat::IEEEsingle() ||
+      &APF.getSemantics() == &APFloat::IEEEdouble()) {
+    // We would like to output the FP constant value in exponential notation,
+    // but we cannot do this if doing so will lose precision.  Check here to
+    // make sure that we only output it in exponential format if we can parse
+    // the value back and get the same value.
+    //
+    bool ignored;
+    bool isDouble = &APF.getSemantics() == &APFloat::IEEEdouble();
+    bool isInf = APF.isInfinity();
+    bool isNaN = APF.isNaN();
+    if (!isInf && !isNaN) {
+      double Val = isDouble ? APF.convertToDouble() : APF.convertToFloat();
+      SmallString<128> StrVal;
+      APF.toString(StrVal, 6, 0, false);
+      // Check to make sure that the stringized number is not some string like
+      // "Inf" or NaN, that atof will accept, but the lexer will not.  Check
+      // that the string matches the "[-+]?[0-9]" regex.
+      //
+      assert(((StrVal[0] >= '0' && StrVal[0] <= '9') ||
+              ((StrVal[0] == '-' || StrVal[0] == '+') &&
+               (StrVal[1] >= '0' && StrVal[1] <= '9'))) &&
+             "[-+]?[0-9] regex does not match!");
+      // Reparse stringized version!
+      if (APFloat(APFloat::IEEEdouble(), StrVal).convertToDouble() == Val) {
+        Out << StrVal;
+        return;
+      }
+    }
+    // Otherwise we could not reparse it to exactly the same value, so we must
+    // output the string in hexadecimal format!  Note that loading and storing
+    // floating point types changes the bits of NaNs on some hosts, notably
+    // x86, so we must not use these types.
+    static_assert(sizeof(double) == sizeof(uint64_t),
+                  "assuming that double is 64 bits!");
+    APFloat apf = APF;
+    // Floats are represented in ASCII IR as double, convert.
+    if (!isDouble)
+      apf.convert(APFloat::IEEEdouble(), APFloat::rmNearestTiesToEven,
+                  &ignored);
+    Out << format_hex(apf.bitcastToAPInt().getZExtValue(), 0, /*Upper=*/true);
+    return;
+  }
+
+  // Either half, or some form of long double.
+  // These appear as a magic letter identifying the type, then a
+  // fixed number of hex digits.
+  Out << "0x";
+  APInt API = APF.bitcastToAPInt();
+  if (&APF.getSemantics() == &APFloat::x87DoubleExtended()) {
+    Out << 'K';
+    Out << format_hex_no_prefix(API.getHiBits(16).getZExtValue(), 4,
+                                /*Upper=*/true);
+    Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
+                                /*Upper=*/true);
+    return;
+  } else if (&APF.getSemantics() == &APFloat::IEEEquad()) {
+    Out << 'L';
+    Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
+                                /*Upper=*/true);
+    Out << format_hex_no_prefix(API.getHiBits(64).getZExtValue(), 16,
+                                /*Upper=*/true);
+  } else if (&APF.getSemantics() == &APFloat::PPCDoubleDouble()) {
+    Out << 'M';
+    Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
+                                /*Upper=*/true);
+    Out << format_hex_no_prefix(API.getHiBits(64).getZExtValue(), 16,
+                                /*Upper=*/true);
+  } else if (&APF.getSemantics() == &APFloat::IEEEhalf()) {
+    Out << 'H';
+    Out << format_hex_no_prefix(API.getZExtValue(), 4,
+                                /*Upper=*/true);
+  } else
+    llvm_unreachable("Unsupported floating point type");
+}
+
+/// Print element \p Idx of \p CDS the way its ConstantInt or ConstantFP would
+/// be printed, without creating that constant: function bodies may be printed
+/// on several threads, and the LLVMContext is not safe to modify from them.
+static void WriteConstantDataElement(raw_ostream &Out,
+                                     const ConstantDataSequential *CDS,
+                                     unsigned Idx) {
+  Type *ETy = CDS->getElementType();
+  if (ETy->isFloatingPointTy())
+    WriteAPFloatInternal(Out, CDS->getElementAsAPFloat(Idx));
+  else
+    Out << APInt(ETy->getIntegerBitWidth(), CDS->getElementAsInteger(Idx));
+}
+
 static void WriteConstantInternal(raw_ostream &Out, const Constant *CV,
                                   TypePrinting &TypePrinter,
                                   SlotTracker *Machine,
@@ -1292,81 +1415,7 @@ static void WriteConstantInternal(raw_ostream &Out, const Constant *CV,
   }
 
   if (const ConstantFP *CFP = dyn_cast<ConstantFP>(CV)) {
-    const APFloat &APF = CFP->getValueAPF();
-    if (&APF.getSemantics() == &APFloat::IEEEsingle() ||
-        &APF.getSemantics() == &APFloat::IEEEdouble()) {
-      // We would like to output the FP constant value in exponential notation,
-      // but we cannot do this if doing so will lose precision.  Check here to
-      // make sure that we only output it in exponential format if we can parse
-      // the value back and get the same value.
-      //
-      bool ignored;
-      bool isDouble = &APF.getSemantics() == &APFloat::IEEEdouble();
-      bool isInf = APF.isInfinity();
-      bool isNaN = APF.isNaN();
-      if (!isInf && !isNaN) {
-        double Val = isDouble ? APF.convertToDouble() : APF.convertToFloat();
-        SmallString<128> StrVal;
-        APF.toString(StrVal, 6, 0, false);
-        // Check to make sure that the stringized number is not some string like
-        // "Inf" or NaN, that atof will accept, but the lexer will not.  Check
-        // that the string matches the "[-+]?[0-9]" regex.
-        //
-        assert(((StrVal[0] >= '0' && StrVal[0] <= '9') ||
-                ((StrVal[0] == '-' || StrVal[0] == '+') &&
-                 (StrVal[1] >= '0' && StrVal[1] <= '9'))) &&
-               "[-+]?[0-9] regex does not match!");
-        // Reparse stringized version!
-        if (APFloat(APFloat::IEEEdouble(), StrVal).convertToDouble() == Val) {
-          Out << StrVal;
-          return;
-        }
-      }
-      // Otherwise we could not reparse it to exactly the same value, so we must
-      // output the string in hexadecimal format!  Note that loading and storing
-      // floating point types changes the bits of NaNs on some hosts, notably
-      // x86, so we must not use these types.
-      static_assert(sizeof(double) == sizeof(uint64_t),
-                    "assuming that double is 64 bits!");
-      APFloat apf = APF;
-      // Floats are represented in ASCII IR as double, convert.
-      if (!isDouble)
-        apf.convert(APFloat::IEEEdouble(), APFloat::rmNearestTiesToEven,
-                          &ignored);
-      Out << format_hex(apf.bitcastToAPInt().getZExtValue(), 0, /*Upper=*/true);
-      return;
-    }
-
-    // Either half, or some form of long double.
-    // These appear as a magic letter identifying the type, then a
-    // fixed number of hex digits.
-    Out << "0x";
-    APInt API = APF.bitcastToAPInt();
-    if (&APF.getSemantics() == &APFloat::x87DoubleExtended()) {
-      Out << 'K';
-      Out << format_hex_no_prefix(API.getHiBits(16).getZExtValue(), 4,
-                                  /*Upper=*/true);
-      Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
-                                  /*Upper=*/true);
-      return;
-    } else if (&APF.getSemantics() == &APFloat::IEEEquad()) {
-      Out << 'L';
-      Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
-                                  /*Upper=*/true);
-      Out << format_hex_no_prefix(API.getHiBits(64).getZExtValue(), 16,
-                                  /*Upper=*/true);
-    } else if (&APF.getSemantics() == &APFloat::PPCDoubleDouble()) {
-      Out << 'M';
-      Out << format_hex_no_prefix(API.getLoBits(64).getZExtValue(), 16,
-                                  /*Upper=*/true);
-      Out << format_hex_no_prefix(API.getHiBits(64).getZExtValue(), 16,
-                                  /*Upper=*/true);
-    } else if (&APF.getSemantics() == &APFloat::IEEEhalf()) {
-      Out << 'H';
-      Out << format_hex_no_prefix(API.getZExtValue(), 4,
-                                  /*Upper=*/true);
-    } else
-      llvm_unreachable("Unsupported floating point type");
+    WriteAPFloatInternal(Out, CFP->getValueAPF());
     return;
   }
 
@@ -1419,15 +1468,12 @@ static void WriteConstantInternal(raw_ostream &Out, const Constant *CV,
     Out << '[';
     TypePrinter.print(ETy, Out);
     Out << ' ';
-    WriteAsOperandInternal(Out, CA->getElementAsConstant(0),
-                           &TypePrinter, Machine,
-                           Context);
+    WriteConstantDataElement(Out, CA, 0);
     for (unsigned i = 1, e = CA->getNumElements(); i != e; ++i) {
       Out << ", ";
       TypePrinter.print(ETy, Out);
       Out << ' ';
-      WriteAsOperandInternal(Out, CA->getElementAsConstant(i), &TypePrinter,
-                             Machine, Context);
+      WriteConstantDataElement(Out, CA, i);
     }
     Out << ']';
     return;
@@ -1465,17 +1511,18 @@ static void WriteConstantInternal(raw_ostream &Out, const Constant *CV,
 
   if (isa<ConstantVector>(CV) || isa<ConstantDataVector>(CV)) {
     Type *ETy = CV->getType()->getVectorElementType();
+    const ConstantDataVector *CDV = dyn_cast<ConstantDataVector>(CV);
     Out << '<';
-    TypePrinter.print(ETy, Out);
-    Out << ' ';
-    WriteAsOperandInternal(Out, CV->getAggregateElement(0U), &TypePrinter,
-                           Machine, Context);
-    for (unsigned i = 1, e = CV->getType()->getVectorNumElements(); i != e;++i){
-      Out << ", ";
+    for (unsigned i = 0, e = CV->getType()->getVectorNumElements(); i != e;++i){
+      if (i)
+        Out << ", ";
       TypePrinter.print(ETy, Out);
       Out << ' ';
-      WriteAsOperandInternal(Out, CV->getAggregateElement(i), &TypePrinter,
-                             Machine, Context);
+      if (CDV)
+        WriteConstantDataElement(Out, CDV, i);
+      else
+        WriteAsOperandInternal(Out, CV->getOperand(i), &TypePrinter, Machine,
+                               Context);
     }
     Out << '>';
     return;
@@ -2343,7 +2390,11 @@ static void WriteAsOperandInternal(raw_ostream &Out, const Metadata *MD,
 namespace {
 
 class AssemblyWriter {
-  formatted_raw_ostream &Out;
+  /// Column tracking is only needed for the comments of an annotation
+  /// writer, so the output is only wrapped in a formatted_raw_ostream when
+  /// there is one.
+  Optional<formatted_raw_ostream> FormattedOut;
+  raw_ostream &Out;
   const Module *TheModule = nullptr;
   const ModuleSummaryIndex *TheIndex = nullptr;
   std::unique_ptr<SlotTracker> SlotTrackerStorage;
@@ -2361,13 +2412,18 @@ class AssemblyWriter {
 
 public:
   /// Construct an AssemblyWriter with an external SlotTracker
-  AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac, const Module *M,
+  AssemblyWriter(raw_ostream &o, SlotTracker &Mac, const Module *M,
                  AssemblyAnnotationWriter *AAW, bool IsForDebug,
                  bool ShouldPreserveUseListOrder = false);
 
-  AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
+  AssemblyWriter(raw_ostream &o, SlotTracker &Mac,
                  const ModuleSummaryIndex *Index, bool IsForDebug);
 
+  /// Construct a writer that prints functions of the module of \p Parent
+  /// exactly as \p Parent would, given a copy of its SlotTracker.
+  AssemblyWriter(raw_ostream &o, SlotTracker &Mac,
+                 const AssemblyWriter &Parent);
+
   void printMDNodeBody(const MDNode *MD);
   void printNamedMDNode(const NamedMDNode *NMD);
 
@@ -2395,6 +2451,7 @@ public:
   void printIndirectSymbol(const GlobalIndirectSymbol *GIS);
   void printComdat(const Comdat *C);
   void printFunction(const Function *F);
+  void printFunctionsInParallel(const Module *M, unsigned Threads);
   void printArgument(const Argument *FA, AttributeSet Attrs);
   void printBasicBlock(const BasicBlock *BB);
   void printInstructionLine(const Instruction &I);
@@ -2439,11 +2496,20 @@ private:
 
 } // end anonymous namespace
 
-AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
+static raw_ostream &formatIfAnnotated(Optional<formatted_raw_ostream> &FOS,
+                                      raw_ostream &OS,
+                                      AssemblyAnnotationWriter *AAW) {
+  if (!AAW)
+    return OS;
+  FOS.emplace(OS);
+  return *FOS;
+}
+
+AssemblyWriter::AssemblyWriter(raw_ostream &o, SlotTracker &Mac,
                                const Module *M, AssemblyAnnotationWriter *AAW,
                                bool IsForDebug, bool ShouldPreserveUseListOrder)
-    : Out(o), TheModule(M), Machine(Mac), TypePrinter(M), AnnotationWriter(AAW),
-      IsForDebug(IsForDebug),
+    : Out(formatIfAnnotated(FormattedOut, o, AAW)), TheModule(M), Machine(Mac),
+      TypePrinter(M), AnnotationWriter(AAW), IsForDebug(IsForDebug),
       ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
   if (!TheModule)
     return;
@@ -2452,11 +2518,20 @@ AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
       Comdats.insert(C);
 }
 
-AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
+AssemblyWriter::AssemblyWriter(raw_ostream &o, SlotTracker &Mac,
                                const ModuleSummaryIndex *Index, bool IsForDebug)
     : Out(o), TheIndex(Index), Machine(Mac), TypePrinter(/*Module=*/nullptr),
       IsForDebug(IsForDebug), ShouldPreserveUseListOrder(false) {}
 
+AssemblyWriter::AssemblyWriter(raw_ostream &o, SlotTracker &Mac,
+                               const AssemblyWriter &Parent)
+    : Out(o), TheModule(Parent.TheModule), Machine(Mac),
+      TypePrinter(Parent.TypePrinter), Comdats(Parent.Comdats),
+      IsForDebug(Parent.IsForDebug), ShouldPreserveUseListOrder(false),
+      MDNames(Parent.MDNames), SSNs(Parent.SSNs) {
+  assert(!Parent.AnnotationWriter && "Annotations must be printed in order");
+}
+
 void AssemblyWriter::writeOperand(const Value *Operand, bool PrintType) {
   if (!Operand) {
     Out << "<null operand!>";
@@ -2635,8 +2710,11 @@ void AssemblyWriter::printModule(const Module *M) {
   printUseLists(nullptr);
 
   // Output all of the functions.
-  for (const Function &F : *M)
-    printFunction(&F);
+  if (AsmWriterThreads > 1 && !AnnotationWriter && UseListOrders.empty())
+    printFunctionsInParallel(M, AsmWriterThreads);
+  else
+    for (const Function &F : *M)
+      printFunction(&F);
   assert(UseListOrders.empty() && "All use-lists should have been consumed");
 
   // Output all attribute groups.
@@ -3088,7 +3166,7 @@ void AssemblyWriter::printSummaryInfo(unsigned Slot, const ValueInfo &VI) {
 }
 
 static void printMetadataIdentifier(StringRef Name,
-                                    formatted_raw_ostream &Out) {
+                                    raw_ostream &Out) {
   if (Name.empty()) {
     Out << "<empty name> ";
   } else {
@@ -3134,7 +3212,7 @@ void AssemblyWriter::printNamedMDNode(const NamedMDNode *NMD) {
 }
 
 static void PrintVisibility(GlobalValue::VisibilityTypes Vis,
-                            formatted_raw_ostream &Out) {
+                            raw_ostream &Out) {
   switch (Vis) {
   case GlobalValue::DefaultVisibility: break;
   case GlobalValue::HiddenVisibility:    Out << "hidden "; break;
@@ -3143,7 +3221,7 @@ static void PrintVisibility(GlobalValue::VisibilityTypes Vis,
 }
 
 static void PrintDSOLocation(const GlobalValue &GV,
-                             formatted_raw_ostream &Out) {
+                             raw_ostream &Out) {
   // GVs with local linkage or non default visibility are implicitly dso_local,
   // so we don't print it.
   bool Implicit = GV.hasLocalLinkage() ||
@@ -3153,7 +3231,7 @@ static void PrintDSOLocation(const GlobalValue &GV,
 }
 
 static void PrintDLLStorageClass(GlobalValue::DLLStorageClassTypes SCT,
-                                 formatted_raw_ostream &Out) {
+                                 raw_ostream &Out) {
   switch (SCT) {
   case GlobalValue::DefaultStorageClass: break;
   case GlobalValue::DLLImportStorageClass: Out << "dllimport "; break;
@@ -3162,7 +3240,7 @@ static void PrintDLLStorageClass(GlobalValue::DLLStorageClassTypes SCT,
 }
 
 static void PrintThreadLocalModel(GlobalVariable::ThreadLocalMode TLM,
-                                  formatted_raw_ostream &Out) {
+                                  raw_ostream &Out) {
   switch (TLM) {
     case GlobalVariable::NotThreadLocal:
       break;
@@ -3193,7 +3271,7 @@ static StringRef getUnnamedAddrEncoding(GlobalVariable::UnnamedAddr UA) {
   llvm_unreachable("Unknown UnnamedAddr");
 }
 
-static void maybePrintComdat(formatted_raw_ostream &Out,
+static void maybePrintComdat(raw_ostream &Out,
                              const GlobalObject &GO) {
   const Comdat *C = GO.getComdat();
   if (!C)
@@ -3339,7 +3417,7 @@ void AssemblyWriter::printFunction(const Function *F) {
   // Print out the return type and name.
   Out << '\n';
 
-  if (AnnotationWriter) AnnotationWriter->emitFunctionAnnot(F, Out);
+  if (AnnotationWriter) AnnotationWriter->emitFunctionAnnot(F, *FormattedOut);
 
   if (F->isMaterializable())
     Out << "; Materializable\n";
@@ -3476,6 +3554,49 @@ void AssemblyWriter::printFunction(const Function *F) {
   Machine.purgeFunction();
 }
 
+/// Print the functions of \p M on \p Threads threads, each printing a run of
+/// them into its own buffer with its own copy of the SlotTracker. The runs are
+/// written out in order as soon as they and the runs before them are done.
+void AssemblyWriter::printFunctionsInParallel(const Module *M,
+                                              unsigned Threads) {
+  std::vector<const Function *> Functions;
+  for (const Function &F : *M) {
+    // Build lazy argument lists now rather than while several threads print
+    // the function.
+    (void)F.arg_begin();
+    Functions.push_back(&F);
+  }
+  if (Functions.empty())
+    return;
+
+  // Number every metadata node and attribute group up front, in the order
+  // printing the functions one by one would, so that the copies of the
+  // tracker only ever add local slots.
+  Machine.processFunctionGlobals(*M);
+
+  unsigned NumWorkers = std::min<size_t>(Threads, Functions.size());
+  std::vector<std::string> Buffers(NumWorkers);
+  std::vector<std::shared_future<void>> Done;
+  ThreadPool Pool(NumWorkers);
+  for (unsigned W = 0; W != NumWorkers; ++W) {
+    size_t Begin = Functions.size() * W / NumWorkers;
+    size_t End = Functions.size() * (W + 1) / NumWorkers;
+    Done.push_back(Pool.async([&, W, Begin, End]() {
+      raw_string_ostream OS(Buffers[W]);
+      SlotTracker WorkerMachine(Machine);
+      AssemblyWriter Worker(OS, WorkerMachine, *this);
+      for (size_t I = Begin; I != End; ++I)
+        Worker.printFunction(Functions[I]);
+    }));
+  }
+
+  for (unsigned W = 0; W != NumWorkers; ++W) {
+    Done[W].wait();
+    Out << Buffers[W];
+    std::string().swap(Buffers[W]);
+  }
+}
+
 /// printArgument - This member is called for every argument that is passed into
 /// the function.  Simply print it out
 void AssemblyWriter::printArgument(const Argument *Arg, AttributeSet Attrs) {
@@ -3496,25 +3617,33 @@ void AssemblyWriter::printArgument(const Argument *Arg, AttributeSet Attrs) {
 /// printBasicBlock - This member is called for each basic block in a method.
 void AssemblyWriter::printBasicBlock(const BasicBlock *BB) {
   bool IsEntryBlock = BB == &BB->getParent()->getEntryBlock();
+  // The comment after the label starts at column 50. The label is all there
+  // is on its line, so its column follows from the bytes written since.
+  uint64_t LineStart = Out.tell();
   if (BB->hasName()) {              // Print out the label if it exists...
     Out << "\n";
+    LineStart = Out.tell();
     PrintLLVMName(Out, BB->getName(), LabelPrefix);
     Out << ':';
   } else if (!IsEntryBlock) {
     Out << "\n";
+    LineStart = Out.tell();
     int Slot = Machine.getLocalSlot(BB);
     if (Slot != -1)
       Out << Slot << ":";
     else
       Out << "<badref>:";
   }
+  auto PadToCommentColumn = [&]() {
+    Out.indent(std::max(50 - int(Out.tell() - LineStart), 1));
+  };
 
   if (!BB->getParent()) {
-    Out.PadToColumn(50);
+    PadToCommentColumn();
     Out << "; Error: Block without parent!";
   } else if (!IsEntryBlock) {
     // Output predecessors for the block.
-    Out.PadToColumn(50);
+    PadToCommentColumn();
     Out << ";";
     const_pred_iterator PI = pred_begin(BB), PE = pred_end(BB);
 
@@ -3532,14 +3661,14 @@ void AssemblyWriter::printBasicBlock(const BasicBlock *BB) {
 
   Out << "\n";
 
-  if (AnnotationWriter) AnnotationWriter->emitBasicBlockStartAnnot(BB, Out);
+  if (AnnotationWriter) AnnotationWriter->emitBasicBlockStartAnnot(BB, *FormattedOut);
 
   // Output all of the instructions in the basic block...
   for (const Instruction &I : *BB) {
     printInstructionLine(I);
   }
 
-  if (AnnotationWriter) AnnotationWriter->emitBasicBlockEndAnnot(BB, Out);
+  if (AnnotationWriter) AnnotationWriter->emitBasicBlockEndAnnot(BB, *FormattedOut);
 }
 
 /// printInstructionLine - Print an instruction and a newline character.
@@ -3565,7 +3694,7 @@ void AssemblyWriter::printInfoComment(const Value &V) {
     printGCRelocateComment(*Relocate);
 
   if (AnnotationWriter)
-    AnnotationWriter->printInfoComment(V, Out);
+    AnnotationWriter->printInfoComment(V, *FormattedOut);
 }
 
 static void maybePrintCallAddrSpace(const Value *Operand, const Instruction *I,
@@ -3587,7 +3716,7 @@ static void maybePrintCallAddrSpace(const Value *Operand, const Instruction *I,
 
 // This member is called for each Instruction in a function..
 void AssemblyWriter::printInstruction(const Instruction &I) {
-  if (AnnotationWriter) AnnotationWriter->emitInstructionAnnot(&I, Out);
+  if (AnnotationWriter) AnnotationWriter->emitInstructionAnnot(&I, *FormattedOut);
 
   // Print out indentation for an instruction.
   Out << "  ";
@@ -4118,8 +4247,7 @@ void Function::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW,
                      bool ShouldPreserveUseListOrder,
                      bool IsForDebug) const {
   SlotTracker SlotTable(this->getParent());
-  formatted_raw_ostream OS(ROS);
-  AssemblyWriter W(OS, SlotTable, this->getParent(), AAW,
+  AssemblyWriter W(ROS, SlotTable, this->getParent(), AAW,
                    IsForDebug,
                    ShouldPreserveUseListOrder);
   W.printFunction(this);
@@ -4128,16 +4256,14 @@ void Function::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW,
 void Module::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW,
                    bool ShouldPreserveUseListOrder, bool IsForDebug) const {
   SlotTracker SlotTable(this);
-  formatted_raw_ostream OS(ROS);
-  AssemblyWriter W(OS, SlotTable, this, AAW, IsForDebug,
+  AssemblyWriter W(ROS, SlotTable, this, AAW, IsForDebug,
                    ShouldPreserveUseListOrder);
   W.printModule(this);
 }
 
 void NamedMDNode::print(raw_ostream &ROS, bool IsForDebug) const {
   SlotTracker SlotTable(getParent());
-  formatted_raw_ostream OS(ROS);
-  AssemblyWriter W(OS, SlotTable, getParent(), nullptr, IsForDebug);
+  AssemblyWriter W(ROS, SlotTable, getParent(), nullptr, IsForDebug);
   W.printNamedMDNode(this);
 }
 
@@ -4152,8 +4278,7 @@ void NamedMDNode::print(raw_ostream &ROS, ModuleSlotTracker &MST,
     SlotTable = &*LocalST;
   }
 
-  formatted_raw_ostream OS(ROS);
-  AssemblyWriter W(OS, *SlotTable, getParent(), nullptr, IsForDebug);
+  AssemblyWriter W(ROS, *SlotTable, getParent(), nullptr, IsForDebug);
   W.printNamedMDNode(this);
 }
 
@@ -4350,8 +4475,7 @@ void Metadata::print(raw_ostream &OS, ModuleSlotTracker &MST,
 
 void ModuleSummaryIndex::print(raw_ostream &ROS, bool IsForDebug) const {
   SlotTracker SlotTable(this);
-  formatted_raw_ostream OS(ROS);
-  AssemblyWriter W(OS, SlotTable, this, IsForDebug);
+  AssemblyWriter W(ROS, SlotTable, this, IsForDebug);
   W.printModuleSummaryIndex();
 }
 
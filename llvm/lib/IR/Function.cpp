@@ -29,6 +29,7 @@
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Intrinsics.h"
@@ -264,6 +265,16 @@ Function::~Function() {
 
   // Remove the function from the on-the-side GC table.
   clearGC();
+
+  // The instructions are deleted along with BasicBlocks after this, so the
+  // arena goes away once the last of them is gone.
+  if (Arena)
+    Arena->release();
+}
+
+void Function::enableInstructionArena() {
+  if (!Arena)
+    Arena = InstructionArena::create();
 }
 
 void Function::BuildLazyArguments() const {
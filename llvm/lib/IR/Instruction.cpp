@@ -14,6 +14,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Operator.h"
@@ -47,6 +48,18 @@ Instruction::~Instruction() {
     clearMetadataHashEntries();
 }
 
+void *Instruction::operator new(size_t Size) {
+  return allocateUser(Size, InstructionArena::getCurrent());
+}
+
+void *Instruction::operator new(size_t Size, unsigned Us) {
+  return allocateUser(Size, Us, 0, InstructionArena::getCurrent());
+}
+
+void *Instruction::operator new(size_t Size, unsigned Us, unsigned DescBytes) {
+  return allocateUser(Size, Us, DescBytes, InstructionArena::getCurrent());
+}
+
 
 void Instruction::setParent(BasicBlock *P) {
   Parent = P;
@@ -0,0 +1,35 @@
+//===-- InstructionArena.cpp - Implement the InstructionArena class -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the per-thread bookkeeping of InstructionArena.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/InstructionArena.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
+
+using namespace llvm;
+
+static cl::opt<bool> UseInstructionArenas(
+    "instruction-arenas", cl::init(false), cl::Hidden,
+    cl::desc("Allocate the instructions of functions built by the IR readers "
+             "from a per-function arena"));
+
+static LLVM_THREAD_LOCAL InstructionArena *CurrentArena = nullptr;
+
+InstructionArena *InstructionArena::getCurrent() { return CurrentArena; }
+
+InstructionArena::Scope::Scope(Function &F) : Saved(CurrentArena) {
+  if (UseInstructionArenas)
+    F.enableInstructionArena();
+  CurrentArena = F.getInstructionArena();
+}
+
+InstructionArena::Scope::~Scope() { CurrentArena = Saved; }
@@ -9,10 +9,33 @@
 #include "llvm/IR/User.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/InstructionArena.h"
 
 namespace llvm {
 class BasicBlock;
 
+/// Users allocated from an InstructionArena keep a pointer to it in front of
+/// the rest of their storage.
+static void *allocateStorage(size_t Size, InstructionArena *Arena) {
+  if (!Arena)
+    return ::operator new(Size);
+  auto **Storage = static_cast<InstructionArena **>(
+      Arena->allocateObject(sizeof(InstructionArena *) + Size));
+  *Storage = Arena;
+  return Storage + 1;
+}
+
+static InstructionArena *getStorageArena(void *Storage) {
+  return *(static_cast<InstructionArena **>(Storage) - 1);
+}
+
+static void freeStorage(void *Storage, bool HasArenaStorage) {
+  if (HasArenaStorage)
+    getStorageArena(Storage)->deallocateObject();
+  else
+    ::operator delete(Storage);
+}
+
 //===----------------------------------------------------------------------===//
 //                                 User Class
 //===----------------------------------------------------------------------===//
@@ -49,7 +72,14 @@ void User::allocHungoffUses(unsigned N, bool IsPhi) {
   size_t size = N * sizeof(Use) + sizeof(Use::UserRef);
   if (IsPhi)
     size += N * sizeof(BasicBlock *);
-  Use *Begin = static_cast<Use*>(::operator new(size));
+  // The operands of an arena allocated User come from the same arena, and are
+  // reclaimed with it rather than when they are replaced or the User dies.
+  Use *Begin =
+      HasArenaStorage
+          ? static_cast<Use *>(
+                getStorageArena(reinterpret_cast<Use **>(this) - 1)
+                    ->allocateOperands(size))
+          : static_cast<Use *>(::operator new(size));
   Use *End = Begin + N;
   (void) new(End) Use::UserRef(const_cast<User*>(this), 1);
   setOperandList(Use::initTags(Begin, End));
@@ -79,7 +109,7 @@ void User::growHungoffUses(unsigned NewNumUses, bool IsPhi) {
         reinterpret_cast<char *>(NewOps + NewNumUses) + sizeof(Use::UserRef);
     std::copy(OldPtr, OldPtr + (OldNumUses * sizeof(BasicBlock *)), NewPtr);
   }
-  Use::zap(OldOps, OldOps + OldNumUses, true);
+  Use::zap(OldOps, OldOps + OldNumUses, /* Delete */ !HasArenaStorage);
 }
 
 
@@ -110,7 +140,8 @@ MutableArrayRef<uint8_t> User::getDescriptor() {
 //===----------------------------------------------------------------------===//
 
 void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
-                                     unsigned DescBytes) {
+                                     unsigned DescBytes,
+                                     InstructionArena *Arena) {
   assert(Us < (1u << NumUserOperandsBits) && "Too many operands");
 
   static_assert(sizeof(DescriptorInfo) % sizeof(void *) == 0, "Required below");
@@ -120,14 +151,15 @@ void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
   assert(DescBytesToAllocate % sizeof(void *) == 0 &&
          "We need this to satisfy alignment constraints for Uses");
 
-  uint8_t *Storage = static_cast<uint8_t *>(
-      ::operator new(Size + sizeof(Use) * Us + DescBytesToAllocate));
+  uint8_t *Storage = static_cast<uint8_t *>(allocateStorage(
+      Size + sizeof(Use) * Us + DescBytesToAllocate, Arena));
   Use *Start = reinterpret_cast<Use *>(Storage + DescBytesToAllocate);
   Use *End = Start + Us;
   User *Obj = reinterpret_cast<User*>(End);
   Obj->NumUserOperands = Us;
   Obj->HasHungOffUses = false;
   Obj->HasDescriptor = DescBytes != 0;
+  Obj->HasArenaStorage = Arena != nullptr;
   Use::initTags(Start, End);
 
   if (DescBytes != 0) {
@@ -138,26 +170,40 @@ void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
   return Obj;
 }
 
-void *User::operator new(size_t Size, unsigned Us) {
-  return allocateFixedOperandUser(Size, Us, 0);
-}
-
-void *User::operator new(size_t Size, unsigned Us, unsigned DescBytes) {
-  return allocateFixedOperandUser(Size, Us, DescBytes);
-}
-
-void *User::operator new(size_t Size) {
+void *User::allocateHungOffOperandUser(size_t Size, InstructionArena *Arena) {
   // Allocate space for a single Use*
-  void *Storage = ::operator new(Size + sizeof(Use *));
+  void *Storage = allocateStorage(Size + sizeof(Use *), Arena);
   Use **HungOffOperandList = static_cast<Use **>(Storage);
   User *Obj = reinterpret_cast<User *>(HungOffOperandList + 1);
   Obj->NumUserOperands = 0;
   Obj->HasHungOffUses = true;
   Obj->HasDescriptor = false;
+  Obj->HasArenaStorage = Arena != nullptr;
   *HungOffOperandList = nullptr;
   return Obj;
 }
 
+void *User::operator new(size_t Size, unsigned Us) {
+  return allocateFixedOperandUser(Size, Us, 0, nullptr);
+}
+
+void *User::operator new(size_t Size, unsigned Us, unsigned DescBytes) {
+  return allocateFixedOperandUser(Size, Us, DescBytes, nullptr);
+}
+
+void *User::operator new(size_t Size) {
+  return allocateHungOffOperandUser(Size, nullptr);
+}
+
+void *User::allocateUser(size_t Size, unsigned Us, unsigned DescBytes,
+                         InstructionArena *Arena) {
+  return allocateFixedOperandUser(Size, Us, DescBytes, Arena);
+}
+
+void *User::allocateUser(size_t Size, InstructionArena *Arena) {
+  return allocateHungOffOperandUser(Size, Arena);
+}
+
 //===----------------------------------------------------------------------===//
 //                         User operator delete Implementation
 //===----------------------------------------------------------------------===//
@@ -172,20 +218,20 @@ void User::operator delete(void *Usr) {
     Use **HungOffOperandList = static_cast<Use **>(Usr) - 1;
     // drop the hung off uses.
     Use::zap(*HungOffOperandList, *HungOffOperandList + Obj->NumUserOperands,
-             /* Delete */ true);
-    ::operator delete(HungOffOperandList);
+             /* Delete */ !Obj->HasArenaStorage);
+    freeStorage(HungOffOperandList, Obj->HasArenaStorage);
   } else if (Obj->HasDescriptor) {
     Use *UseBegin = static_cast<Use *>(Usr) - Obj->NumUserOperands;
     Use::zap(UseBegin, UseBegin + Obj->NumUserOperands, /* Delete */ false);
 
     auto *DI = reinterpret_cast<DescriptorInfo *>(UseBegin) - 1;
     uint8_t *Storage = reinterpret_cast<uint8_t *>(DI) - DI->SizeInBytes;
-    ::operator delete(Storage);
+    freeStorage(Storage, Obj->HasArenaStorage);
   } else {
     Use *Storage = static_cast<Use *>(Usr) - Obj->NumUserOperands;
     Use::zap(Storage, Storage + Obj->NumUserOperands,
              /* Delete */ false);
-    ::operator delete(Storage);
+    freeStorage(Storage, Obj->HasArenaStorage);
   }
 }
 
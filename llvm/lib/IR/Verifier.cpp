@@ -93,6 +93,7 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Statepoint.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/IR/Use.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
@@ -103,16 +104,22 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 
 using namespace llvm;
 
+static cl::opt<unsigned> VerifyThreads(
+    "verify-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads verifying function bodies in verifyModule"));
+
 namespace llvm {
 
 struct VerifierSupport {
@@ -318,6 +325,8 @@ public:
 
   bool hasBrokenDebugInfo() const { return BrokenDebugInfo; }
 
+  bool verifyFunctionsInParallel(unsigned Threads);
+
   bool verify(const Function &F) {
     assert(F.getParent() == &M &&
            "An instance of this class only works with a specific module!");
@@ -1629,10 +1638,16 @@ void Verifier::verifyParameterAttrs(AttributeSet Attrs, Type *Ty,
          V);
 
   AttrBuilder IncompatibleAttrs = AttributeFuncs::typeIncompatible(Ty);
-  Assert(!AttrBuilder(Attrs).overlaps(IncompatibleAttrs),
-         "Wrong types for attribute: " +
-             AttributeSet::get(Context, IncompatibleAttrs).getAsString(),
-         V);
+  if (AttrBuilder(Attrs).overlaps(IncompatibleAttrs)) {
+    // Functions may be verified concurrently; uniquing the attribute set for
+    // the message must not race.
+    static std::mutex AttributeSetMutex;
+    std::lock_guard<std::mutex> Lock(AttributeSetMutex);
+    CheckFailed("Wrong types for attribute: " +
+                    AttributeSet::get(Context, IncompatibleAttrs).getAsString(),
+                V);
+    return;
+  }
 
   if (PointerType *PTy = dyn_cast<PointerType>(Ty)) {
     SmallPtrSet<Type*, 4> Visited;
@@ -4088,6 +4103,13 @@ void Verifier::visitInstruction(Instruction &I) {
     visitRangeMetadata(I, Range, I.getType());
   }
 
+  if (I.getMetadata(LLVMContext::MD_noescape)) {
+    Assert(I.getType()->isPointerTy(), "noescape applies only to pointer types",
+           &I);
+    Assert(isa<CallBase>(I),
+           "noescape applies only to call and invoke instructions", &I);
+  }
+
   if (I.getMetadata(LLVMContext::MD_nonnull)) {
     Assert(I.getType()->isPointerTy(), "nonnull applies only to pointer types",
            &I);
@@ -4889,6 +4911,109 @@ void Verifier::verifySourceDebugInfo(const DICompileUnit &U, const DIFile &F) {
            "inconsistent use of embedded source");
 }
 
+/// Create everything that verifying a function would otherwise create lazily
+/// in the context or in other functions, so that the functions of \p M can be
+/// verified concurrently.
+static void prepareForConcurrentVerification(const Module &M) {
+  ConstantTokenNone::get(M.getContext());
+
+  // StructType::isSized caches its answer in the type.
+  TypeFinder StructTypes;
+  StructTypes.run(M, /*onlyNamed=*/false);
+  for (StructType *STy : StructTypes)
+    (void)STy->isSized();
+
+  for (const Function &F : M) {
+    // Arguments are created on first use.
+    (void)F.arg_begin();
+
+    // Matching an intrinsic's signature can create the types it is
+    // overloaded on.
+    if (!F.isIntrinsic())
+      continue;
+    SmallVector<Intrinsic::IITDescriptor, 8> Table;
+    getIntrinsicInfoTableEntries(F.getIntrinsicID(), Table);
+    ArrayRef<Intrinsic::IITDescriptor> TableRef = Table;
+    SmallVector<Type *, 4> ArgTys;
+    FunctionType *FTy = F.getFunctionType();
+    if (Intrinsic::matchIntrinsicType(FTy->getReturnType(), TableRef, ArgTys))
+      continue;
+    for (Type *ParamTy : FTy->params())
+      if (Intrinsic::matchIntrinsicType(ParamTy, TableRef, ArgTys))
+        break;
+  }
+}
+
+/// Verify every function of the module on up to \p Threads threads, each
+/// with a Verifier of its own, and take over what they recorded about the
+/// module for verify(). Returns false, leaving this Verifier untouched, if any
+/// function is broken or the functions disagree about debug info they share;
+/// the caller then verifies the functions itself, which reports the problems
+/// in the usual order.
+bool Verifier::verifyFunctionsInParallel(unsigned Threads) {
+  std::vector<const Function *> Functions;
+  for (const Function &F : M)
+    Functions.push_back(&F);
+  unsigned NumWorkers = std::min<size_t>(Threads, Functions.size());
+  if (NumWorkers < 2)
+    return false;
+
+  prepareForConcurrentVerification(M);
+
+  std::vector<std::unique_ptr<Verifier>> Workers;
+  for (unsigned W = 0; W != NumWorkers; ++W)
+    Workers.push_back(llvm::make_unique<Verifier>(
+        /*OS=*/nullptr, TreatBrokenDebugInfoAsError, M));
+  std::vector<char> WorkerOK(NumWorkers);
+
+  ThreadPool Pool(NumWorkers);
+  for (unsigned W = 0; W != NumWorkers; ++W)
+    Pool.async([&, W]() {
+      Verifier &Worker = *Workers[W];
+      bool OK = true;
+      size_t Begin = Functions.size() * W / NumWorkers;
+      size_t End = Functions.size() * (W + 1) / NumWorkers;
+      for (size_t I = Begin; I != End && OK; ++I)
+        OK = Worker.verify(*Functions[I]);
+      WorkerOK[W] = OK && !Worker.BrokenDebugInfo;
+    });
+  Pool.wait();
+
+  if (!all_of(WorkerOK, [](char OK) { return OK; }))
+    return false;
+
+  // Merge in function order, checking what the serial walk would have
+  // checked across functions.
+  DenseMap<const DISubprogram *, const Function *> Attachments;
+  DenseMap<const DICompileUnit *, bool> HasSource;
+  for (auto &Worker : Workers) {
+    for (auto &Attachment : Worker->DISubprogramAttachments) {
+      const Function *&AttachedTo = Attachments[Attachment.first];
+      if (AttachedTo && AttachedTo != Attachment.second)
+        return false;
+      AttachedTo = Attachment.second;
+    }
+    for (auto &Source : Worker->HasSourceDebugInfo) {
+      auto Inserted = HasSource.insert(Source);
+      if (!Inserted.second && Inserted.first->second != Source.second)
+        return false;
+    }
+  }
+
+  DISubprogramAttachments = std::move(Attachments);
+  HasSourceDebugInfo = std::move(HasSource);
+  for (auto &Worker : Workers) {
+    MDNodes.insert(Worker->MDNodes.begin(), Worker->MDNodes.end());
+    CUVisited.insert(Worker->CUVisited.begin(), Worker->CUVisited.end());
+    for (auto &Counts : Worker->FrameEscapeInfo) {
+      auto &Entry = FrameEscapeInfo[Counts.first];
+      Entry.first = std::max(Entry.first, Counts.second.first);
+      Entry.second = std::max(Entry.second, Counts.second.second);
+    }
+  }
+  return true;
+}
+
 //===----------------------------------------------------------------------===//
 //  Implement the public interfaces to this file...
 //===----------------------------------------------------------------------===//
@@ -4910,8 +5035,9 @@ bool llvm::verifyModule(const Module &M, raw_ostream *OS,
   Verifier V(OS, /*ShouldTreatBrokenDebugInfoAsError=*/!BrokenDebugInfo, M);
 
   bool Broken = false;
-  for (const Function &F : M)
-    Broken |= !V.verify(F);
+  if (VerifyThreads < 2 || !V.verifyFunctionsInParallel(VerifyThreads))
+    for (const Function &F : M)
+      Broken |= !V.verify(F);
 
   Broken |= !V.verify();
   if (BrokenDebugInfo)
@@ -29,6 +29,29 @@ static const char *const TimeIRParsingGroupDescription = "LLVM IR Parsing";
 static const char *const TimeIRParsingName = "parse";
 static const char *const TimeIRParsingDescription = "Parse IR";
 
+/// Read \p Filename, or stdin for "-", into a buffer the IR readers can use.
+/// Only the assembly parser needs the buffer to be nul-terminated, so the file
+/// is read without that requirement; this lets MemoryBuffer map bitcode files
+/// of any size instead of copying them into the heap. Textual IR files are
+/// opened again with the requirement. Stdin is always read into a
+/// nul-terminated heap buffer.
+static ErrorOr<std::unique_ptr<MemoryBuffer>>
+getIRFileOrSTDIN(StringRef Filename) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
+      MemoryBuffer::getFileOrSTDIN(Filename, /*FileSize=*/-1,
+                                   /*RequiresNullTerminator=*/false);
+  if (!FileOrErr)
+    return FileOrErr;
+
+  MemoryBuffer &Buffer = **FileOrErr;
+  if (Filename == "-" ||
+      isBitcode((const unsigned char *)Buffer.getBufferStart(),
+                (const unsigned char *)Buffer.getBufferEnd()))
+    return FileOrErr;
+  return MemoryBuffer::getFile(Filename, /*FileSize=*/-1,
+                               /*RequiresNullTerminator=*/true);
+}
+
 std::unique_ptr<Module>
 llvm::getLazyIRModule(std::unique_ptr<MemoryBuffer> Buffer, SMDiagnostic &Err,
                       LLVMContext &Context, bool ShouldLazyLoadMetadata) {
@@ -53,8 +76,7 @@ std::unique_ptr<Module> llvm::getLazyIRFileModule(StringRef Filename,
                                                   SMDiagnostic &Err,
                                                   LLVMContext &Context,
                                                   bool ShouldLazyLoadMetadata) {
-  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
-      MemoryBuffer::getFileOrSTDIN(Filename);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr = getIRFileOrSTDIN(Filename);
   if (std::error_code EC = FileOrErr.getError()) {
     Err = SMDiagnostic(Filename, SourceMgr::DK_Error,
                        "Could not open input file: " + EC.message());
@@ -96,8 +118,7 @@ std::unique_ptr<Module> llvm::parseIRFile(StringRef Filename, SMDiagnostic &Err,
                                           LLVMContext &Context,
                                           bool UpgradeDebugInfo,
                                           StringRef DataLayoutString) {
-  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
-      MemoryBuffer::getFileOrSTDIN(Filename);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr = getIRFileOrSTDIN(Filename);
   if (std::error_code EC = FileOrErr.getError()) {
     Err = SMDiagnostic(Filename, SourceMgr::DK_Error,
                        "Could not open input file: " + EC.message());
@@ -1,14 +1,27 @@
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <deque>
@@ -33,30 +46,137 @@ using std::endl;
 using std::hex;
 using std::map;
 using std::max;
+using std::min;
 using std::set;
 using std::string;
 using std::stringstream;
 using std::to_string;
 using std::vector;
-using InstId = string;
 using namespace llvm;
 
 static const string GO_HEAP_CALL = "__go_new";
+static const string GO_MAKE_SLICE_CALL = "__go_make_slice2";
+static const string GO_GOROUTINE_CALL = "__go_go";
+static const string GO_DEFER_CALL = "__go_defer";
+static const string GO_PANIC_CALL = "__go_panic";
+static const string GO_APPEND_CALL = "__go_append";
+static const string GO_BYTES_TO_STRING_CALL = "__go_byte_array_to_string";
+static const string GO_STRING_TO_BYTES_CALL = "__go_string_to_byte_array";
+static const string GO_STRCMP_CALL = "__go_strcmp";
+static const string GO_MAP_INDEX_CALL = "__go_map_index";
+static const string GO_PRINT_PREFIX = "__go_print_";
 static const string GO_LIB_PREFIX = "__go_";
+static const unsigned GO_MAX_ALIGN = 8;
 
-InstId getId(Value *val) {
-  uintptr_t id = reinterpret_cast<uintptr_t>(val) & 0xffff;
-  stringstream stream;
-  stream << hex << id;
-  if (auto inst = dyn_cast<Instruction>(val)) {
-    return inst->getName().str() + "_" + stream.str();
-  } else {
-    return "_" + stream.str();
+// Field indices into llgo's type descriptors: the common header starts with
+// the kind byte and stores the type size in its fourth field, and a slice
+// descriptor follows the header with a pointer to its element descriptor.
+static const unsigned GO_TYPE_KIND_FIELD = 0;
+static const unsigned GO_TYPE_SIZE_FIELD = 3;
+static const unsigned GO_SLICE_ELEM_FIELD = 1;
+
+// Kind bit of types the collector does not scan (GO_NO_POINTERS in libgo).
+static const uint64_t GO_KIND_NO_POINTERS = 1 << 7;
+
+static cl::opt<bool>
+    EscapePromote("escape-promote", cl::init(false), cl::Hidden,
+                  cl::desc("Replace non-escaping __go_new calls with "
+                           "stack slots"));
+
+static cl::opt<bool> EscapeAnnotate(
+    "escape-annotate", cl::init(false), cl::Hidden,
+    cl::desc("Attach !noescape metadata to local __go_new calls that are "
+             "not promoted"));
+
+static cl::opt<unsigned> EscapeFrameBudget(
+    "escape-frame-budget", cl::init(1024), cl::Hidden,
+    cl::desc("Maximum number of bytes stack promotion may add to a frame"));
+
+static cl::opt<unsigned> EscapeRecursiveBudget(
+    "escape-recursive-budget", cl::init(128), cl::Hidden,
+    cl::desc("Maximum number of bytes stack promotion may add to the frames "
+             "of one recursive call graph SCC"));
+
+// Matches kSplitStackAvailable in X86FrameLowering.cpp: frames up to this
+// size compare the stack pointer against the stack limit directly.
+static cl::opt<unsigned> EscapeSplitStackLimit(
+    "escape-split-stack-limit", cl::init(256), cl::Hidden,
+    cl::desc("Frame size up to which the split-stack prologue check takes "
+             "its fast path"));
+
+static cl::opt<bool>
+    EscapeMerge("escape-merge", cl::init(false), cl::Hidden,
+                cl::desc("Merge __go_new calls of one block that die "
+                         "together into a single allocation"));
+
+static cl::opt<bool> EscapeElideCopies(
+    "escape-elide-copies", cl::init(false), cl::Hidden,
+    cl::desc("Alias the source buffer of string/[]byte conversions whose "
+             "result is only read"));
+
+// Identifies values of one function in the reports. Named values keep their
+// name and unnamed ones get the slot number the IR printer gives them in the
+// function as it was before any transform, so the output lines up with
+// `opt -S` on the input without running -instnamer first. Reporting an
+// allocation numbers the slots when it has no name, so the allocations of a
+// function are numbered before promotion, merging or elision insert values.
+struct ValueIds {
+  Function *f = nullptr;
+  map<const Value *, unsigned> slots;
+  bool numbered = false;
+  void reset(Function *_f) {
+    f = _f;
+    slots.clear();
+    numbered = false;
   }
-}
+  void number() {
+    unsigned next = 0;
+    for (auto &arg : f->args())
+      if (!arg.hasName())
+        slots[&arg] = next++;
+    for (auto &bb : *f) {
+      if (!bb.hasName())
+        slots[&bb] = next++;
+      for (auto &inst : bb)
+        if (!inst.getType()->isVoidTy() && !inst.hasName())
+          slots[&inst] = next++;
+    }
+    numbered = true;
+  }
+  string get(const Value *val) {
+    if (val->hasName())
+      return val->getName().str();
+    if (!numbered)
+      number();
+    auto it = slots.find(val);
+    return it == slots.end() ? "" : to_string(it->second);
+  }
+};
 
 enum EscapeType { GlobalEscape = 0, LocalEscape = 1, NoEscape = 2 };
 
+static bool isAllocation(Function *func) {
+  return func && (func->getName() == GO_HEAP_CALL ||
+                  func->getName() == GO_MAKE_SLICE_CALL);
+}
+
+// Slice headers and interfaces are first-class aggregates, so only the
+// members that can hold an address keep an object alive.
+static bool mayHoldPointer(Type *ty) {
+  if (ty->isPointerTy())
+    return true;
+  if (auto st = dyn_cast<StructType>(ty)) {
+    for (auto elem : st->elements()) {
+      if (mayHoldPointer(elem))
+        return true;
+    }
+    return false;
+  }
+  if (auto seq = dyn_cast<SequentialType>(ty))
+    return mayHoldPointer(seq->getElementType());
+  return false;
+}
+
 struct Context {
   Function *f;
   Context(Function *_f) : f(_f) {}
@@ -79,8 +199,19 @@ struct Summary {
 
 struct EscapeCache {
   map<Context, Summary> cache;
-  Summary *getSummary(const Context &ctx) { return nullptr; }
-  void putSummary(const Context &ctx, const Summary &summary) {}
+  // Recursive call graph SCCs, and the stack bytes promotion has added to
+  // the frames of each of them so far.
+  map<Context, unsigned> sccs;
+  vector<uint64_t> sccUsed;
+  Summary *getSummary(const Context &ctx) {
+    auto it = cache.find(ctx);
+    return it == cache.end() ? nullptr : &it->second;
+  }
+  void putSummary(const Context &ctx, const Summary &summary) {
+    auto r = cache.emplace(ctx, summary);
+    if (!r.second)
+      r.first->second = summary;
+  }
 };
 
 struct EscapeAnalysis {
@@ -96,6 +227,14 @@ struct EscapeAnalysis {
       return pass.getAnalysis<AAResultsWrapperPass>().getAAResults();
     }
   }
+  BlockFrequencyInfo &bfi() {
+    if (cache) {
+      return pass.getAnalysis<BlockFrequencyInfoWrapperPass>(*current)
+          .getBFI();
+    } else {
+      return pass.getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+    }
+  }
   MemorySSA &mssa() {
     if (cache) {
       return pass.getAnalysis<MemorySSAWrapperPass>(*current).getMSSA();
@@ -129,6 +268,13 @@ struct EscapeAnalysis {
       ret = GlobalEscape;
     } else if (isa<Argument>(val)) {
       ret = LocalEscape;
+    } else if (isa<LoadInst>(val)) {
+      // A pointer read out of memory, or returned by anything but an
+      // allocation, may point into an object reachable from anywhere.
+      ret = GlobalEscape;
+    } else if (auto call = dyn_cast<CallInst>(val)) {
+      if (!isAllocation(call->getCalledFunction()))
+        ret = GlobalEscape;
     }
     return ret;
   }
@@ -166,12 +312,131 @@ struct EscapeAnalysis {
     }
   }
 
+  // Goroutines run concurrently with their parent, so anything handed to the
+  // spawn entry outlives the current frame.
+  static bool isGoroutineSpawn(CallInst *call) {
+    auto func = call->getCalledFunction();
+    return func && func->getName() == GO_GOROUTINE_CALL;
+  }
+
+  // A panic value unwinds to whichever caller recovers it.
+  static bool isPanic(CallInst *call) {
+    auto func = call->getCalledFunction();
+    return func && func->getName() == GO_PANIC_CALL;
+  }
+
+  // The argument block of a deferred call is only read by the deferred thunk,
+  // which runs before the frame returns or unwinds.
+  static bool isDefer(CallInst *call) {
+    auto func = call->getCalledFunction();
+    return func && func->getName() == GO_DEFER_CALL;
+  }
+
+  // append returns a slice that may share the backing array of its slice
+  // argument.
+  static bool isAppend(CallInst *call) {
+    auto func = call->getCalledFunction();
+    return func && func->getName() == GO_APPEND_CALL;
+  }
+
+  // Finds the function stored into the first word of a closure context
+  // through `ptr', which points there. Returns false if something else may
+  // be stored there.
+  static bool findStoredFunction(Value *ptr, Function *&func) {
+    for (auto user : ptr->users()) {
+      if (isa<BitCastInst>(user) ||
+          (isa<GetElementPtrInst>(user) &&
+           cast<GetElementPtrInst>(user)->hasAllZeroIndices())) {
+        if (!findStoredFunction(user, func))
+          return false;
+      } else if (auto store = dyn_cast<StoreInst>(user)) {
+        if (store->getPointerOperand() != ptr)
+          continue;
+        auto stored =
+            dyn_cast<Function>(store->getValueOperand()->stripPointerCasts());
+        if (!stored || (func && func != stored))
+          return false;
+        func = stored;
+      }
+    }
+    return true;
+  }
+
+  // Closures are called indirectly, through the function pointer in the
+  // first word of their context, with the context in the `nest' parameter.
+  // If the context is allocated in this function, the callee is the
+  // function stored into that word, which Go never changes afterwards.
+  static Function *getClosureFunction(CallInst *call) {
+    auto load =
+        dyn_cast<LoadInst>(call->getCalledValue()->stripPointerCasts());
+    if (!load)
+      return nullptr;
+    Value *ctx = nullptr;
+    for (unsigned i = 0, n = call->getNumArgOperands(); i < n; i++) {
+      if (call->paramHasAttr(i, Attribute::Nest))
+        ctx = call->getArgOperand(i)->stripPointerCasts();
+    }
+    auto alloc = dyn_cast_or_null<CallInst>(ctx);
+    if (!alloc || !isAllocation(alloc->getCalledFunction()) ||
+        load->getPointerOperand()->stripPointerCasts() != ctx)
+      return nullptr;
+    Function *func = nullptr;
+    if (!findStoredFunction(ctx, func))
+      return nullptr;
+    return func;
+  }
+
+  // The function a call runs, if it is known.
+  static Function *getCallee(CallInst *call) {
+    if (auto func = call->getCalledFunction())
+      return func;
+    return getClosureFunction(call);
+  }
+
+  // Runtime entries that hand memory to code we cannot summarize, so the
+  // contents of anything passed to them escape.
+  static bool isRuntimeSink(CallInst *call) {
+    return isGoroutineSpawn(call) || isPanic(call) || isDefer(call);
+  }
+
+  static bool isInCycle(BasicBlock *bb) {
+    for (auto succ : successors(bb)) {
+      if (isPotentiallyReachable(succ, bb))
+        return true;
+    }
+    return false;
+  }
+
+  // Intrinsics and runtime entries known not to keep the pointers passed to
+  // them once they return. Calls to any other external function may store
+  // their arguments anywhere.
+  static bool isNonRetainingCall(CallInst *call) {
+    if (isa<MemIntrinsic>(call))
+      return true;
+    if (auto intrinsic = dyn_cast<IntrinsicInst>(call))
+      return intrinsic->getIntrinsicID() == Intrinsic::lifetime_start ||
+             intrinsic->getIntrinsicID() == Intrinsic::lifetime_end;
+    if (isReadOnlyStringCall(call))
+      return true;
+    auto func = call->getCalledFunction();
+    return isAllocation(func) ||
+           (func && func->getName().startswith(GO_PRINT_PREFIX));
+  }
+
   EscapeType resultFor(CallInst *call, Value *inst) {
     EscapeType escaping = NoEscape;
-    auto func = call->getCalledFunction();
-    if (func) {
+    auto func = getCallee(call);
+    if (isGoroutineSpawn(call) || isPanic(call)) {
+      escaping = GlobalEscape;
+    } else if (isDefer(call)) {
+      // A defer in a loop keeps one pending record per iteration, which a
+      // single stack slot cannot hold.
+      escaping = isInCycle(call->getParent()) ? LocalEscape : NoEscape;
+    } else if (isAppend(call)) {
+      escaping = track(call);
+    } else if (func) {
       if (func->isDeclaration()) {
-        escaping = NoEscape; // TODO
+        escaping = isNonRetainingCall(call) ? NoEscape : GlobalEscape;
       } else if (!cache) {
         escaping = GlobalEscape;
       } else {
@@ -182,15 +447,20 @@ struct EscapeAnalysis {
           if (!cache->getSummary(ctx)) {
             EscapeAnalysis analysis(pass, cache);
             analysis.transform(func);
+            changed |= analysis.changed;
           }
+          // A parameter that locally escapes in the callee may be returned
+          // or stored through another argument, so it stays a local escape
+          // here; only parameters that never escape keep the object local.
           auto summary = cache->getSummary(ctx);
-          int i = 0;
-          for (auto &arg : func->args()) {
-            if (&arg == inst && summary->get(i) == GlobalEscape) {
-              escaping = GlobalEscape;
+          unsigned n = min<unsigned>(call->getNumArgOperands(),
+                                          summary->args.size());
+          for (unsigned i = 0; i < n; i++) {
+            if (call->getArgOperand(i) != inst)
+              continue;
+            escaping = min(escaping, summary->get(i));
+            if (escaping == GlobalEscape)
               break;
-            }
-            i++;
           }
         }
       }
@@ -200,8 +470,45 @@ struct EscapeAnalysis {
     return escaping;
   }
 
+  // What the call does with the memory at `loc', which holds the value being
+  // tracked. The callee may read the value and keep it; a defined callee
+  // has no summary of the memory its arguments reach, so the contents stay
+  // at least a local escape, and follow the argument through which the
+  // callee reaches them.
+  EscapeType forwardCall(CallInst *call, Value *loc) {
+    MemoryLocation contents(loc, LocationSize::unknown());
+    auto func = getCallee(call);
+    if (isRuntimeSink(call) || !func || func->isDeclaration()) {
+      // A memory transfer copies the value somewhere else.
+      if (!isa<MemTransferInst>(call) && isNonRetainingCall(call))
+        return NoEscape;
+      return isRefSet(aa().getModRefInfo(call, contents)) ? GlobalEscape
+                                                          : NoEscape;
+    }
+    if (!isRefSet(aa().getModRefInfo(call, contents)))
+      return NoEscape;
+    EscapeType escaping = LocalEscape;
+    for (Value *arg : call->arg_operands()) {
+      if (arg->getType()->isPointerTy()) {
+        if (aa().alias(arg, LocationSize::unknown(), loc,
+                       LocationSize::unknown()) == NoAlias)
+          continue;
+      } else if (!mayHoldPointer(arg->getType())) {
+        continue;
+      }
+      escaping = min(escaping, resultFor(call, arg));
+      if (escaping == GlobalEscape)
+        break;
+    }
+    return escaping;
+  }
+
+  set<std::pair<MemoryAccess *, Value *>> forwarded;
   EscapeType forward(MemoryAccess *m, Value *loc) {
     EscapeType escaping = NoEscape;
+    // Loops in the memory SSA graph lead back here.
+    if (!forwarded.emplace(m, loc).second)
+      return NoEscape;
     Module *mdl = m->getBlock()->getParent()->getParent();
     DataLayout td(mdl);
     PointerType *locTy = dyn_cast<PointerType>(loc->getType());
@@ -247,26 +554,10 @@ struct EscapeAnalysis {
             escaping = forward(def, loc);
           }
         } else if (auto call = dyn_cast<CallInst>(val)) {
-          auto func = call->getCalledFunction();
-          if (func) {
-            if (func->isDeclaration()) {
-              escaping = NoEscape; // TODO
-            } else {
-              for (auto &arg : func->args()) {
-                if (auto ptr = dyn_cast<Argument>(&arg)) {
-                  PointerType *ptrTy = dyn_cast<PointerType>(ptr->getType());
-                  auto ar = aa().alias(
-                      ptr, td.getTypeAllocSize(ptrTy->getElementType()), loc,
-                      td.getTypeAllocSize(locTy->getElementType()));
-                  if (ar != NoAlias) {
-                    escaping = resultFor(call, ptr);
-                  }
-                }
-              }
-            }
-          } else {
-            escaping = GlobalEscape;
-          }
+          escaping = forwardCall(call, loc);
+          // The call may leave `loc' alone, so later reads still see it.
+          if (escaping != GlobalEscape)
+            escaping = min(escaping, forward(def, loc));
         } else {
           TRACE(errs() << "ERROR! UNKNOWN MEMORYDEF INST.\n");
           TRACE(val->print(errs()));
@@ -280,12 +571,12 @@ struct EscapeAnalysis {
     return escaping;
   }
 
-  set<InstId> trackList;
+  set<Value *> trackList;
   static set<Context> analyzing;
   EscapeType track(Value *inst, bool isRoot = false) {
     EscapeType escaping = NoEscape;
     if (isRoot) {
-      const auto &r = trackList.emplace(getId(inst));
+      const auto &r = trackList.emplace(inst);
       // already exists
       if (!r.second) {
         TRACE(errs() << "LOOP BACK\n");
@@ -294,17 +585,17 @@ struct EscapeAnalysis {
     }
     for (auto user : inst->users()) {
       if (auto bitcast = dyn_cast<BitCastInst>(user)) {
-        TRACE(errs() << "bitcast " << bitcast->getName() << "\n");
+        TRACE(errs() << "bitcast " << ids.get(bitcast) << "\n");
         escaping = track(bitcast);
       } else if (auto gep = dyn_cast<GetElementPtrInst>(user)) {
-        TRACE(errs() << "gep " << gep->getName() << "\n");
+        TRACE(errs() << "gep " << ids.get(gep) << "\n");
         escaping = track(gep);
       } else if (auto phi = dyn_cast<PHINode>(inst)) {
         escaping = track(phi);
       } else if (auto store = dyn_cast<StoreInst>(user)) {
         TRACE(store->print(errs()));
         TRACE(errs() << "\n");
-        if (getId(store->getValueOperand()) == getId(inst)) {
+        if (store->getValueOperand() == inst) {
           MemoryUseOrDef *m = mssa().getMemoryAccess(store);
           escaping = backward(m);
           if (escaping == NoEscape) {
@@ -313,14 +604,15 @@ struct EscapeAnalysis {
           }
         }
       } else if (auto load = dyn_cast<LoadInst>(user)) {
-        TRACE(errs() << "load " << load->getName() << "\n");
-        return NoEscape;
+        TRACE(errs() << "load " << ids.get(load) << "\n");
+        escaping = NoEscape;
       } else if (auto iv = dyn_cast<InsertValueInst>(user)) {
-        TRACE(errs() << "insertvalue " << iv->getName() << "\n");
+        TRACE(errs() << "insertvalue " << ids.get(iv) << "\n");
         escaping = track(iv);
       } else if (auto ev = dyn_cast<ExtractValueInst>(user)) {
-        TRACE(errs() << "extractvalue " << ev->getName() << "\n");
-        escaping = track(ev);
+        TRACE(errs() << "extractvalue " << ids.get(ev) << "\n");
+        if (mayHoldPointer(ev->getType()))
+          escaping = track(ev);
       } else if (auto op = dyn_cast<ICmpInst>(user)) {
         escaping = NoEscape;
       } else if (auto call = dyn_cast<CallInst>(user)) {
@@ -333,36 +625,508 @@ struct EscapeAnalysis {
         break;
     }
     if (isRoot) {
-      trackList.erase(getId(inst));
+      trackList.erase(inst);
     }
     return escaping;
   }
 
+  // Returns the common header of a constant type descriptor, or null.
+  static ConstantStruct *getCommonType(Value *desc) {
+    auto ty = dyn_cast<GlobalVariable>(desc->stripPointerCasts());
+    if (!ty || !ty->hasDefinitiveInitializer())
+      return nullptr;
+    auto init = dyn_cast<ConstantStruct>(ty->getInitializer());
+    if (!init || init->getNumOperands() == 0)
+      return nullptr;
+    return dyn_cast<ConstantStruct>(init->getOperand(0));
+  }
+
+  // Reads the element size out of the slice type descriptor passed to
+  // __go_make_slice2. Returns 0 if the descriptor is not a constant.
+  static uint64_t getElementSize(Value *desc) {
+    auto sliceTy = dyn_cast<GlobalVariable>(desc->stripPointerCasts());
+    if (!sliceTy || !sliceTy->hasDefinitiveInitializer())
+      return 0;
+    auto sliceInit = dyn_cast<ConstantStruct>(sliceTy->getInitializer());
+    if (!sliceInit || sliceInit->getNumOperands() <= GO_SLICE_ELEM_FIELD)
+      return 0;
+    auto common = getCommonType(sliceInit->getOperand(GO_SLICE_ELEM_FIELD));
+    if (!common || common->getNumOperands() <= GO_TYPE_SIZE_FIELD)
+      return 0;
+    auto size = dyn_cast<ConstantInt>(common->getOperand(GO_TYPE_SIZE_FIELD));
+    return size ? size->getZExtValue() : 0;
+  }
+
+  // Returns true if the constant type descriptor `desc' is of a type without
+  // pointers, whose objects the collector does not scan.
+  static bool isPointerFree(Value *desc) {
+    auto common = getCommonType(desc);
+    if (!common)
+      return false;
+    auto kind = dyn_cast<ConstantInt>(common->getOperand(GO_TYPE_KIND_FIELD));
+    return kind && (kind->getZExtValue() & GO_KIND_NO_POINTERS);
+  }
+
+  // Creates a zero-initialized stack slot in the entry block and returns
+  // it as a pointer of type ptrTy at the position of the call.
+  static Value *createStackSlot(CallInst *call, uint64_t size, Type *ptrTy) {
+    Function *F = call->getFunction();
+    IRBuilder<> entry(&*F->getEntryBlock().getFirstInsertionPt());
+    Type *ty = ArrayType::get(entry.getInt8Ty(), size);
+    AllocaInst *slot = entry.CreateAlloca(ty, nullptr);
+    if (call->hasName())
+      slot->setName(call->getName() + ".stack");
+    slot->setAlignment(GO_MAX_ALIGN);
+    IRBuilder<> builder(call);
+    Value *ptr = builder.CreatePointerCast(slot, ptrTy);
+    builder.CreateMemSet(ptr, builder.getInt8(0), size, GO_MAX_ALIGN);
+    return ptr;
+  }
+
+  // Returns the number of stack bytes that promoting the allocation takes,
+  // or 0 if it cannot be promoted. __go_new needs a constant size, and
+  // __go_make_slice2 a constant length and capacity and a constant type
+  // descriptor.
+  static uint64_t getPromotedSize(CallInst *call) {
+    if (call->getCalledFunction()->getName() == GO_HEAP_CALL) {
+      auto size = dyn_cast<ConstantInt>(
+          call->getArgOperand(call->getNumArgOperands() - 1));
+      return size ? size->getZExtValue() : 0;
+    }
+    if (call->getNumArgOperands() != 3)
+      return 0;
+    auto len = dyn_cast<ConstantInt>(call->getArgOperand(1));
+    auto cap = dyn_cast<ConstantInt>(call->getArgOperand(2));
+    uint64_t elemSize = getElementSize(call->getArgOperand(0));
+    auto sliceTy = dyn_cast<StructType>(call->getType());
+    if (!len || !cap || !elemSize || !sliceTy ||
+        sliceTy->getNumElements() != 3 ||
+        len->getZExtValue() > cap->getZExtValue())
+      return 0;
+    return cap->getZExtValue() * elemSize;
+  }
+
+  // Replaces a non-escaping allocation with a stack slot of `size' bytes.
+  // For __go_make_slice2 the slice header is rebuilt around the slot.
+  static void promote(CallInst *call, uint64_t size) {
+    Value *result = nullptr;
+    if (call->getCalledFunction()->getName() == GO_HEAP_CALL) {
+      result = createStackSlot(call, size, call->getType());
+    } else {
+      auto sliceTy = cast<StructType>(call->getType());
+      auto len = cast<ConstantInt>(call->getArgOperand(1));
+      auto cap = cast<ConstantInt>(call->getArgOperand(2));
+      Value *ptr = createStackSlot(call, size, sliceTy->getElementType(0));
+      IRBuilder<> builder(call);
+      result = UndefValue::get(sliceTy);
+      result = builder.CreateInsertValue(result, ptr, 0);
+      result = builder.CreateInsertValue(
+          result, ConstantInt::get(sliceTy->getElementType(1),
+                                   len->getZExtValue()),
+          1);
+      result = builder.CreateInsertValue(
+          result, ConstantInt::get(sliceTy->getElementType(2),
+                                   cap->getZExtValue()),
+          2);
+    }
+    result->takeName(call);
+    call->replaceAllUsesWith(result);
+    call->eraseFromParent();
+  }
+
+  // Lets BasicAA, LICM and DSE treat the object like a non-captured alloca.
+  // A local object may still be stored into other local memory or handed to
+  // a callee, which !noescape does not allow, so only objects that
+  // CaptureTracking also finds uncaptured are annotated.
+  static bool annotate(CallInst *call) {
+    if (!call->getType()->isPointerTy() ||
+        PointerMayBeCaptured(call, /*ReturnCaptures=*/true,
+                             /*StoreCaptures=*/true))
+      return false;
+    call->setMetadata(LLVMContext::MD_noescape,
+                      MDNode::get(call->getContext(), None));
+    return true;
+  }
+
+  // Returns true if no address derived from `val' is kept anywhere, so an
+  // allocation made in a loop is dead by the time its block runs again and
+  // every iteration can reuse the same stack slot.
+  static bool staysInIteration(Value *val) {
+    for (auto user : val->users()) {
+      if (isa<ExtractValueInst>(user) && !mayHoldPointer(user->getType()))
+        continue;
+      if (isa<BitCastInst>(user) || isa<GetElementPtrInst>(user) ||
+          isa<ExtractValueInst>(user)) {
+        if (!staysInIteration(user))
+          return false;
+      } else if (auto store = dyn_cast<StoreInst>(user)) {
+        if (store->getValueOperand() == val)
+          return false;
+      } else if (auto call = dyn_cast<CallInst>(user)) {
+        if (!isNonRetainingCall(call))
+          return false;
+      } else if (!isa<LoadInst>(user) && !isa<ICmpInst>(user)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Size of the static allocas of F's entry block, before promotion.
+  static uint64_t getFrameSize(Function *F) {
+    const DataLayout &dl = F->getParent()->getDataLayout();
+    uint64_t frame = 0;
+    for (auto &i : F->getEntryBlock()) {
+      auto alloca = dyn_cast<AllocaInst>(&i);
+      if (!alloca || !alloca->isStaticAlloca())
+        continue;
+      auto count = cast<ConstantInt>(alloca->getArraySize());
+      frame += alignTo(dl.getTypeAllocSize(alloca->getAllocatedType()) *
+                           count->getZExtValue(),
+                       GO_MAX_ALIGN);
+    }
+    return frame;
+  }
+
+  static bool callsItself(Function *F) {
+    for (auto &bb : *F) {
+      for (auto &i : bb) {
+        auto call = dyn_cast<CallInst>(&i);
+        if (call && call->getCalledFunction() == F)
+          return true;
+      }
+    }
+    return false;
+  }
+
+  // Promotes local allocations, hottest first, while the frame growth fits
+  // the budgets. A split-stack function whose frame is small enough for the
+  // prologue's fast path keeps it, and a recursive function draws from the
+  // budget of its SCC, since every active frame of the recursion carries
+  // the promoted slots. An allocation in a loop is only promoted if it dies
+  // within the iteration, since all iterations share its slot. The remaining
+  // allocations are annotated instead.
+  void promoteLocals(Function *F, vector<CallInst *> &locals) {
+    if (!EscapePromote) {
+      if (EscapeAnnotate) {
+        for (auto call : locals)
+          changed |= annotate(call);
+      }
+      return;
+    }
+    uint64_t frame = getFrameSize(F);
+    uint64_t budget = EscapeFrameBudget;
+    if (F->hasFnAttribute("split-stack") && frame <= EscapeSplitStackLimit)
+      budget = min<uint64_t>(budget, EscapeSplitStackLimit - frame);
+    uint64_t selfUsed = 0;
+    uint64_t *recursiveUsed = nullptr;
+    if (cache) {
+      auto it = cache->sccs.find(Context(F));
+      if (it != cache->sccs.end())
+        recursiveUsed = &cache->sccUsed[it->second];
+    } else if (callsItself(F)) {
+      recursiveUsed = &selfUsed;
+    }
+    BlockFrequencyInfo &freq = bfi();
+    std::stable_sort(locals.begin(), locals.end(),
+                     [&](CallInst *a, CallInst *b) {
+                       return freq.getBlockFreq(a->getParent()) >
+                              freq.getBlockFreq(b->getParent());
+                     });
+    uint64_t used = 0;
+    for (auto call : locals) {
+      if (isInCycle(call->getParent()) && !staysInIteration(call)) {
+        TRACE(errs() << "outlives its iteration: " << ids.get(call) << "\n");
+        changed |= annotate(call);
+        continue;
+      }
+      uint64_t size = getPromotedSize(call);
+      uint64_t growth = alignTo(size, GO_MAX_ALIGN);
+      bool fits = size && used + growth <= budget &&
+                  (!recursiveUsed ||
+                   *recursiveUsed + growth <= EscapeRecursiveBudget);
+      if (!fits) {
+        TRACE(errs() << "over frame budget: " << ids.get(call) << "\n");
+        changed |= annotate(call);
+        continue;
+      }
+      promote(call, size);
+      used += growth;
+      if (recursiveUsed)
+        *recursiveUsed += growth;
+      changed = true;
+    }
+  }
+
+  // Returns true if `val' can only be reached through memory of the group:
+  // it is loaded from, stored to, compared or stored into a group member,
+  // and used in no other way.
+  static bool isOwnedBy(Value *val, const set<Value *> &group,
+                        const DataLayout &dl) {
+    for (auto user : val->users()) {
+      if (isa<BitCastInst>(user) || isa<GetElementPtrInst>(user) ||
+          isa<InsertValueInst>(user) || isa<ExtractValueInst>(user)) {
+        if (!isOwnedBy(user, group, dl))
+          return false;
+      } else if (auto store = dyn_cast<StoreInst>(user)) {
+        if (store->getValueOperand() == val &&
+            !group.count(GetUnderlyingObject(store->getPointerOperand(), dl)))
+          return false;
+      } else if (!isa<LoadInst>(user) && !isa<ICmpInst>(user)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Carves the allocations of `calls', given in block order, out of one
+  // allocation made by the first of them. At most one member may be
+  // reachable from outside the group, so no member outlives the others.
+  static bool mergeGroup(vector<CallInst *> calls, const DataLayout &dl) {
+    set<Value *> group(calls.begin(), calls.end());
+    while (true) {
+      vector<CallInst *> roots;
+      for (auto call : calls) {
+        if (!isOwnedBy(call, group, dl))
+          roots.push_back(call);
+      }
+      if (roots.size() <= 1)
+        break;
+      for (size_t k = 1; k < roots.size(); k++) {
+        group.erase(roots[k]);
+        calls.erase(std::find(calls.begin(), calls.end(), roots[k]));
+      }
+    }
+    if (calls.size() < 2)
+      return false;
+    CallInst *leader = calls.front();
+    unsigned sizeArg = leader->getNumArgOperands() - 1;
+    uint64_t total = 0;
+    vector<uint64_t> offsets;
+    for (auto call : calls) {
+      offsets.push_back(total);
+      auto size = cast<ConstantInt>(call->getArgOperand(sizeArg));
+      total += alignTo(size->getZExtValue(), GO_MAX_ALIGN);
+    }
+    for (size_t k = 1; k < calls.size(); k++) {
+      CallInst *call = calls[k];
+      IRBuilder<> builder(call);
+      Value *base = builder.CreatePointerCast(leader, builder.getInt8PtrTy());
+      Value *ptr = builder.CreateConstInBoundsGEP1_64(builder.getInt8Ty(),
+                                                      base, offsets[k]);
+      ptr = builder.CreatePointerCast(ptr, call->getType());
+      ptr->takeName(call);
+      call->replaceAllUsesWith(ptr);
+      call->eraseFromParent();
+    }
+    Type *sizeTy = leader->getArgOperand(sizeArg)->getType();
+    leader->setArgOperand(sizeArg, ConstantInt::get(sizeTy, total));
+    return true;
+  }
+
+  // Groups the heap allocations of each block. The merged object is larger
+  // than the type descriptor passed for it says, which the collector only
+  // tolerates for objects it does not scan, so members of a group call
+  // __go_new with the same descriptor of a pointer-free type. Local
+  // allocations are left to promotion.
+  static bool mergeAllocations(Function *F) {
+    const DataLayout &dl = F->getParent()->getDataLayout();
+    bool merged = false;
+    for (auto &bb : *F) {
+      map<vector<Value *>, vector<CallInst *>> buckets;
+      for (auto &i : bb) {
+        auto call = dyn_cast<CallInst>(&i);
+        if (!call || call->getMetadata(LLVMContext::MD_noescape))
+          continue;
+        auto func = call->getCalledFunction();
+        if (!func || func->getName() != GO_HEAP_CALL)
+          continue;
+        unsigned n = call->getNumArgOperands();
+        if (n < 2 || !isa<ConstantInt>(call->getArgOperand(n - 1)) ||
+            !isPointerFree(call->getArgOperand(0)))
+          continue;
+        vector<Value *> key(call->arg_begin(), call->arg_end() - 1);
+        buckets[key].push_back(call);
+      }
+      for (auto &bucket : buckets)
+        merged |= mergeGroup(bucket.second, dl);
+    }
+    return merged;
+  }
+
+  // Runtime calls that only read a string operand while they run: string
+  // comparisons and map lookups that do not insert the key.
+  static bool isReadOnlyStringCall(CallInst *call) {
+    auto func = call->getCalledFunction();
+    if (!func)
+      return false;
+    if (func->getName() == GO_STRCMP_CALL)
+      return true;
+    if (func->getName() == GO_MAP_INDEX_CALL) {
+      auto insert = dyn_cast<ConstantInt>(
+          call->getArgOperand(call->getNumArgOperands() - 1));
+      return insert && insert->isZero();
+    }
+    return false;
+  }
+
+  // Collects the instructions reading the result of a conversion, and
+  // returns false unless every use only reads it. The result may be split
+  // up, compared, loaded from, handed to a read-only runtime call, or kept
+  // in a stack temporary (a `holder', such as a map key slot) whose own
+  // uses obey the same rules.
+  static bool collectReaders(Value *val, bool holder,
+                             vector<Instruction *> &readers) {
+    for (auto user : val->users()) {
+      auto inst = cast<Instruction>(user);
+      if (isa<ExtractValueInst>(inst) || isa<InsertValueInst>(inst) ||
+          isa<BitCastInst>(inst) || isa<GetElementPtrInst>(inst)) {
+        if (!collectReaders(inst, holder, readers))
+          return false;
+      } else if (auto load = dyn_cast<LoadInst>(inst)) {
+        readers.push_back(load);
+        if (holder && mayHoldPointer(load->getType()) &&
+            !collectReaders(load, false, readers))
+          return false;
+      } else if (auto store = dyn_cast<StoreInst>(inst)) {
+        if (store->getValueOperand() == val) {
+          auto slot = dyn_cast<AllocaInst>(
+              store->getPointerOperand()->stripPointerCasts());
+          if (!slot || !collectReaders(slot, true, readers))
+            return false;
+        } else if (!holder) {
+          return false;
+        }
+        readers.push_back(store);
+      } else if (auto call = dyn_cast<CallInst>(inst)) {
+        if (!isReadOnlyStringCall(call))
+          return false;
+        readers.push_back(call);
+      } else if (!isa<ICmpInst>(inst)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns the data pointer and length operands of a conversion call,
+  // whether the runtime takes them as two scalars or as one aggregate built
+  // in the function.
+  static bool getBufferOperands(CallInst *call, Value *&ptr, Value *&len) {
+    if (call->getNumArgOperands() == 2) {
+      ptr = call->getArgOperand(0);
+      len = call->getArgOperand(1);
+    } else if (call->getNumArgOperands() == 1 &&
+               call->getArgOperand(0)->getType()->isStructTy()) {
+      ptr = FindInsertedValue(call->getArgOperand(0), 0);
+      len = FindInsertedValue(call->getArgOperand(0), 1);
+    } else {
+      return false;
+    }
+    return ptr && len && ptr->getType()->isPointerTy() &&
+           len->getType()->isIntegerTy();
+  }
+
+  // Rewrites string(b) and []byte(s) to share the source buffer when the
+  // result is only read within the conversion's block and nothing in
+  // between may write the buffer. Strings are immutable, so sharing in the
+  // []byte direction additionally requires that the slice is never written,
+  // which collectReaders guarantees by rejecting stores through it.
+  bool elideCopies(Function *F) {
+    bool elided = false;
+    vector<CallInst *> conversions;
+    for (auto &bb : *F) {
+      for (auto &i : bb) {
+        auto call = dyn_cast<CallInst>(&i);
+        auto func = call ? call->getCalledFunction() : nullptr;
+        if (func && (func->getName() == GO_BYTES_TO_STRING_CALL ||
+                     func->getName() == GO_STRING_TO_BYTES_CALL))
+          conversions.push_back(call);
+      }
+    }
+    for (auto call : conversions) {
+      auto resultTy = dyn_cast<StructType>(call->getType());
+      bool toString =
+          call->getCalledFunction()->getName() == GO_BYTES_TO_STRING_CALL;
+      if (!resultTy || resultTy->getNumElements() != (toString ? 2 : 3))
+        continue;
+      vector<Instruction *> readers;
+      if (!collectReaders(call, false, readers))
+        continue;
+      BasicBlock *bb = call->getParent();
+      set<Instruction *> reading(readers.begin(), readers.end());
+      bool sameBlock = true;
+      for (auto reader : readers)
+        sameBlock &= reader->getParent() == bb;
+      if (!sameBlock)
+        continue;
+      Value *ptr = nullptr, *len = nullptr;
+      if (!getBufferOperands(call, ptr, len))
+        continue;
+      MemoryLocation buffer(ptr, LocationSize::unknown());
+      bool clobbered = false;
+      size_t pending = reading.size();
+      for (auto it = ++call->getIterator(); pending && it != bb->end(); ++it) {
+        if (reading.count(&*it)) {
+          pending--;
+          continue;
+        }
+        if (isModSet(aa().getModRefInfo(&*it, buffer))) {
+          clobbered = true;
+          break;
+        }
+      }
+      if (clobbered)
+        continue;
+      IRBuilder<> builder(call);
+      Value *result = UndefValue::get(resultTy);
+      result = builder.CreateInsertValue(
+          result, builder.CreatePointerCast(ptr, resultTy->getElementType(0)),
+          0);
+      for (unsigned k = 1; k < resultTy->getNumElements(); k++) {
+        result = builder.CreateInsertValue(
+            result,
+            builder.CreateZExtOrTrunc(len, resultTy->getElementType(k)), k);
+      }
+      result->takeName(call);
+      call->replaceAllUsesWith(result);
+      call->eraseFromParent();
+      elided = true;
+    }
+    return elided;
+  }
+
+  bool changed = false;
+  ValueIds ids;
   void transform(Function *F) {
     current = F;
+    ids.reset(F);
+    vector<CallInst *> locals;
     analyzing.emplace(F);
     Summary summary(F->arg_size());
     int i = 0;
     for (auto &arg : F->args()) {
+      forwarded.clear();
       summary.args[i++] = track(&arg, true);
     }
     for (auto bb = F->begin(), e = F->end(); bb != e; ++bb) {
       for (auto i = bb->begin(), e = bb->end(); i != e; ++i) {
-        InstId id = getId(&*i);
         Instruction *inst = &*i;
         if (auto call = dyn_cast<CallInst>(inst)) {
           Function *func = call->getCalledFunction();
-          if (func && func->getName() == GO_HEAP_CALL) {
+          if (isAllocation(func)) {
             trackList.clear();
+            forwarded.clear();
             string var;
             for (auto user : i->users()) {
-              var = user->getName();
+              var = ids.get(user);
               break;
             }
             EscapeType res = track(inst, true);
-            errs() << "%" << i->getName() << "(" << var << ")";
+            errs() << "%" << ids.get(inst) << "(" << var << ")";
             if (res == NoEscape) {
               errs() << " is local.\n";
+              locals.push_back(call);
             } else if (res == LocalEscape) {
               errs() << " locally escapes.\n";
             } else {
@@ -372,7 +1136,13 @@ struct EscapeAnalysis {
         }
       }
     }
-    cache->putSummary(Context(F), summary);
+    promoteLocals(F, locals);
+    if (EscapeMerge)
+      changed |= mergeAllocations(F);
+    if (EscapeElideCopies)
+      changed |= elideCopies(F);
+    if (cache)
+      cache->putSummary(Context(F), summary);
     analyzing.erase(F);
   }
 };
@@ -389,7 +1159,11 @@ struct Escape : public FunctionPass {
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequiredTransitive<AAResultsWrapperPass>();
     AU.addRequiredTransitive<MemorySSAWrapperPass>();
-    AU.setPreservesAll();
+    if (EscapePromote)
+      AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    if (!EscapePromote && !EscapeAnnotate && !EscapeMerge &&
+        !EscapeElideCopies)
+      AU.setPreservesAll();
   }
 
   bool runOnFunction(Function &F) override {
@@ -400,7 +1174,7 @@ struct Escape : public FunctionPass {
     errs().write_escaped(F.getName()) << '\n';
     EscapeAnalysis analysis(*this);
     analysis.transform(&F);
-    return false;
+    return analysis.changed;
   }
 };
 } // namespace
@@ -425,10 +1199,12 @@ struct Try : public FunctionPass {
     errs() << "Escape: ";
     errs().write_escaped(F.getName()) << '\n';
     auto &aa = getAnalysis<AAResultsWrapperPass>().getAAResults();
+    ValueIds ids;
+    ids.reset(&F);
     for (auto bb = F.begin(), e = F.end(); bb != e; ++bb) {
       for (auto i = bb->begin(), e = bb->end(); i != e; ++i) {
         for (auto j = bb->begin(), ej = bb->end(); j != ej; ++j) {
-          errs() << i->getName() << " " << j->getName() << ": ";
+          errs() << ids.get(&*i) << " " << ids.get(&*j) << ": ";
           auto ar = aa.alias(&*i, 8, &*j, 8);
           if (ar == NoAlias) {
             errs() << "NoAlias";
@@ -460,12 +1236,30 @@ struct EscapeModule : public ModulePass {
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequiredTransitive<AAResultsWrapperPass>();
     AU.addRequiredTransitive<MemorySSAWrapperPass>();
-    AU.setPreservesAll();
+    if (EscapePromote) {
+      AU.addRequired<BlockFrequencyInfoWrapperPass>();
+      AU.addRequired<CallGraphWrapperPass>();
+    }
+    if (!EscapePromote && !EscapeAnnotate && !EscapeMerge &&
+        !EscapeElideCopies)
+      AU.setPreservesAll();
   }
 
   deque<Context> workList;
   bool runOnModule(Module &M) override {
     EscapeCache cache;
+    if (EscapePromote) {
+      CallGraph &cg = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+      for (auto scc = scc_begin(&cg); !scc.isAtEnd(); ++scc) {
+        if (!scc.hasLoop())
+          continue;
+        for (CallGraphNode *node : *scc) {
+          if (Function *f = node->getFunction())
+            cache.sccs.emplace(Context(f), cache.sccUsed.size());
+        }
+        cache.sccUsed.push_back(0);
+      }
+    }
     EscapeAnalysis analysis(*this, &cache);
     static const string PREFIX = "main.";
     for (auto it = M.begin(), e = M.end(); it != e; ++it) {
@@ -476,7 +1270,7 @@ struct EscapeModule : public ModulePass {
       analysis.transform(&*it);
     }
 
-    return false;
+    return analysis.changed;
   }
 };
 } // namespace
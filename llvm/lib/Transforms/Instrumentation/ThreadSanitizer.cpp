@@ -395,11 +395,14 @@ void ThreadSanitizer::chooseInstructionsToInstrument(
     Value *Addr = isa<StoreInst>(*I)
         ? cast<StoreInst>(I)->getPointerOperand()
         : cast<LoadInst>(I)->getPointerOperand();
-    if (isa<AllocaInst>(GetUnderlyingObject(Addr, DL)) &&
+    Value *Object = GetUnderlyingObject(Addr, DL);
+    if ((isa<AllocaInst>(Object) || isNoEscapeAllocation(Object)) &&
         !PointerMayBeCaptured(Addr, true, true)) {
       // The variable is addressable but not captured, so it cannot be
       // referenced from a different thread and participate in a data race
-      // (see llvm/Analysis/CaptureTracking.h for details).
+      // (see llvm/Analysis/CaptureTracking.h for details). Allocations marked
+      // !noescape promise that their address is never stored or passed to a
+      // call that may keep it, so they are treated like allocas.
       NumOmittedNonCaptured++;
       continue;
     }
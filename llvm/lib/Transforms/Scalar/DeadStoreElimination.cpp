@@ -763,7 +763,8 @@ static bool handleEndBlock(BasicBlock &BB, AliasAnalysis *AA,
 
     // Okay, so these are dead heap objects, but if the pointer never escapes
     // then it's leaked by this function anyways.
-    else if (isAllocLikeFn(&I, TLI) && !PointerMayBeCaptured(&I, true, true))
+    else if ((isAllocLikeFn(&I, TLI) || isNoEscapeAllocation(&I)) &&
+             !PointerMayBeCaptured(&I, true, true))
       DeadStackObjects.insert(&I);
   }
 
@@ -837,7 +838,7 @@ static bool handleEndBlock(BasicBlock &BB, AliasAnalysis *AA,
     if (auto *Call = dyn_cast<CallBase>(&*BBI)) {
       // Remove allocation function calls from the list of dead stack objects;
       // there can't be any references before the definition.
-      if (isAllocLikeFn(&*BBI, TLI))
+      if (isAllocLikeFn(&*BBI, TLI) || isNoEscapeAllocation(&*BBI))
         DeadStackObjects.remove(&*BBI);
 
       // If this call does not access memory, it can't be loading any of our
@@ -1163,7 +1164,8 @@ static bool eliminateDeadStores(BasicBlock &BB, AliasAnalysis *AA,
             // where the allocation doesn't escape before the last
             // throwing instruction; PointerMayBeCaptured
             // reasonably fast approximation.
-            IsStoreDeadOnUnwind = isAllocLikeFn(Underlying, TLI) &&
+            IsStoreDeadOnUnwind = (isAllocLikeFn(Underlying, TLI) ||
+                                   isNoEscapeAllocation(Underlying)) &&
                 !PointerMayBeCaptured(Underlying, false, true);
         }
         if (!IsStoreDeadOnUnwind)
@@ -1817,8 +1817,8 @@ bool isKnownNonEscaping(Value *Object, const TargetLibraryInfo *TLI) {
   //   2) Object can't have been captured at definition site.  For this, we
   //      need to know the return value is noalias.  At the moment, we use a
   //      weaker condition and handle only AllocLikeFunctions (which are
-  //      known to be noalias).  TODO
-  return isAllocLikeFn(Object, TLI) &&
+  //      known to be noalias) and allocations marked !noescape.  TODO
+  return (isAllocLikeFn(Object, TLI) || isNoEscapeAllocation(Object)) &&
     !PointerMayBeCaptured(Object, true, true);
 }
 
@@ -2044,7 +2044,8 @@ bool llvm::promoteLoopAccessesToScalars(
     else {
       Value *Object = GetUnderlyingObject(SomePtr, MDL);
       SafeToInsertStore =
-          (isAllocLikeFn(Object, TLI) || isa<AllocaInst>(Object)) &&
+          (isAllocLikeFn(Object, TLI) || isa<AllocaInst>(Object) ||
+           isNoEscapeAllocation(Object)) &&
           !PointerMayBeCaptured(Object, true, true);
     }
   }
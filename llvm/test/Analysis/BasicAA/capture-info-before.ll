@@ -0,0 +1,50 @@
+; RUN: opt < %s -basicaa -gvn -S | FileCheck %s --check-prefix=NOCACHE
+; RUN: opt < %s -capture-info -basicaa -gvn -S | FileCheck %s --check-prefix=CACHE
+; RUN: opt < %s -aa-pipeline=basic-aa -passes='require<capture-info>,gvn' -S | FileCheck %s --check-prefix=CACHE
+
+; %obj is only captured after the call to @f, so @f cannot write it and the
+; stored value can be forwarded to the load. Telling that needs a walk over
+; more uses than a single PointerMayBeCapturedBefore query explores.
+
+declare void @f()
+declare void @capture(i32*)
+
+; NOCACHE-LABEL: @capture_after(
+; NOCACHE: %v = load i32, i32* %obj
+; NOCACHE: ret i32 %v
+; CACHE-LABEL: @capture_after(
+; CACHE-NOT: load
+; CACHE: ret i32 1
+define i32 @capture_after() {
+  %obj = alloca i32
+  store i32 0, i32* %obj
+  store i32 1, i32* %obj
+  store i32 2, i32* %obj
+  store i32 3, i32* %obj
+  store i32 4, i32* %obj
+  store i32 5, i32* %obj
+  store i32 6, i32* %obj
+  store i32 7, i32* %obj
+  store i32 8, i32* %obj
+  store i32 9, i32* %obj
+  store i32 10, i32* %obj
+  store i32 11, i32* %obj
+  store i32 12, i32* %obj
+  store i32 13, i32* %obj
+  store i32 14, i32* %obj
+  store i32 15, i32* %obj
+  store i32 16, i32* %obj
+  store i32 17, i32* %obj
+  store i32 18, i32* %obj
+  store i32 19, i32* %obj
+  store i32 20, i32* %obj
+  store i32 21, i32* %obj
+  store i32 22, i32* %obj
+  store i32 23, i32* %obj
+  store i32 24, i32* %obj
+  store i32 1, i32* %obj
+  call void @f()
+  %v = load i32, i32* %obj
+  call void @capture(i32* %obj)
+  ret i32 %v
+}
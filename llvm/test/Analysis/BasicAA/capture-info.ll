@@ -0,0 +1,42 @@
+; RUN: opt < %s -basicaa -aa-eval -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s --check-prefix=NOCACHE
+; RUN: opt < %s -capture-info -basicaa -aa-eval -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s --check-prefix=CACHE
+; RUN: opt < %s -aa-pipeline=basic-aa -passes='require<capture-info>,aa-eval' -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s --check-prefix=CACHE
+
+; %obj has more uses than a single PointerMayBeCaptured query explores. The
+; cached capture walk can afford to look at all of them.
+
+@g = external global i32*
+
+; NOCACHE: MayAlias: i32* %obj, i32* %p
+; CACHE: NoAlias: i32* %obj, i32* %p
+define void @many_uses() {
+  %obj = alloca i32
+  %p = load i32*, i32** @g
+  store i32 0, i32* %obj
+  store i32 1, i32* %obj
+  store i32 2, i32* %obj
+  store i32 3, i32* %obj
+  store i32 4, i32* %obj
+  store i32 5, i32* %obj
+  store i32 6, i32* %obj
+  store i32 7, i32* %obj
+  store i32 8, i32* %obj
+  store i32 9, i32* %obj
+  store i32 10, i32* %obj
+  store i32 11, i32* %obj
+  store i32 12, i32* %obj
+  store i32 13, i32* %obj
+  store i32 14, i32* %obj
+  store i32 15, i32* %obj
+  store i32 16, i32* %obj
+  store i32 17, i32* %obj
+  store i32 18, i32* %obj
+  store i32 19, i32* %obj
+  store i32 20, i32* %obj
+  store i32 21, i32* %obj
+  store i32 22, i32* %obj
+  store i32 23, i32* %obj
+  store i32 24, i32* %obj
+  store i32 -1, i32* %p
+  ret void
+}
@@ -0,0 +1,64 @@
+; RUN: opt < %s -basicaa -aa-eval -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s
+
+; A local object that is only stored into non-escaping local memory can't be
+; returned by a load of non-local memory.
+
+@g = external global i32*
+@h = external global i32*
+
+declare void @use(i32**)
+
+; CHECK-LABEL: Function: stored_in_local
+; CHECK-DAG: NoAlias: i32* %obj, i32* %p
+define void @stored_in_local() {
+  %obj = alloca i32
+  %box = alloca { i32*, i64 }
+  %field = getelementptr { i32*, i64 }, { i32*, i64 }* %box, i32 0, i32 0
+  store i32* %obj, i32** %field
+  %p = load i32*, i32** @g
+  store i32 1, i32* %p
+  store i32 0, i32* %obj
+  ret void
+}
+
+; CHECK-LABEL: Function: loaded_back
+; CHECK-DAG: MayAlias: i32* %obj, i32* %q
+; CHECK-DAG: NoAlias: i32* %obj, i32* %p
+define void @loaded_back() {
+  %obj = alloca i32
+  %box = alloca i32*
+  store i32* %obj, i32** %box
+  %q = load i32*, i32** %box
+  store i32 1, i32* %q
+  %p = load i32*, i32** @g
+  store i32 2, i32* %p
+  store i32 0, i32* %obj
+  ret void
+}
+
+; CHECK-LABEL: Function: box_escapes
+; CHECK-DAG: MayAlias: i32* %obj, i32* %p
+define void @box_escapes() {
+  %obj = alloca i32
+  %box = alloca i32*
+  store i32* %obj, i32** %box
+  call void @use(i32** %box)
+  %p = load i32*, i32** @g
+  store i32 2, i32* %p
+  store i32 0, i32* %obj
+  ret void
+}
+
+; CHECK-LABEL: Function: loaded_and_captured
+; CHECK-DAG: MayAlias: i32* %obj, i32* %p
+define void @loaded_and_captured() {
+  %obj = alloca i32
+  %box = alloca i32*
+  store i32* %obj, i32** %box
+  %q = load i32*, i32** %box
+  store i32* %q, i32** @h
+  %p = load i32*, i32** @g
+  store i32 2, i32* %p
+  store i32 0, i32* %obj
+  ret void
+}
@@ -0,0 +1,124 @@
+; This testcase ensures that the module-wide CFL-Steensgaard analysis unifies
+; formals with actuals, and that formals of internal functions whose callers are
+; all known are not treated as coming from an unknown caller.
+
+; RUN: opt < %s -disable-basicaa -cfl-steens-module-aa -aa-eval -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s
+; RUN: opt < %s -aa-pipeline=cfl-steens-module-aa -passes='require<cfl-steens-module-aa>,function(aa-eval)' -print-all-alias-modref-info -disable-output 2>&1 | FileCheck %s
+
+@g = global i32* null
+
+; CHECK-LABEL: Function: get_internal
+; CHECK: NoAlias: i32* %v, i32** @g
+define internal i32* @get_internal(i32** %pp) {
+  %v = load i32*, i32** %pp
+  store i32* null, i32** @g
+  ret i32* %v
+}
+
+; CHECK-LABEL: Function: get_external
+; CHECK: MayAlias: i32* %v, i32** @g
+define i32* @get_external(i32** %pp) {
+  %v = load i32*, i32** %pp
+  store i32* null, i32** @g
+  ret i32* %v
+}
+
+; CHECK-LABEL: Function: test_internal
+; CHECK: MayAlias: i32* %a, i32* %r
+; CHECK: NoAlias: i32* %b, i32* %r
+; CHECK: NoAlias: i32* %r, i32** %slot
+define void @test_internal() {
+  %a = alloca i32
+  %b = alloca i32
+  %slot = alloca i32*
+  store i32* %a, i32** %slot
+  %r = call i32* @get_internal(i32** %slot)
+  ret void
+}
+
+; CHECK-LABEL: Function: test_external
+; CHECK: MayAlias: i32* %a, i32* %r
+; CHECK: NoAlias: i32* %b, i32* %r
+define void @test_external() {
+  %a = alloca i32
+  %b = alloca i32
+  %slot = alloca i32*
+  store i32* %a, i32** %slot
+  %r = call i32* @get_external(i32** %slot)
+  ret void
+}
+
+; CHECK-LABEL: Function: get_address_taken
+; CHECK: MayAlias: i32* %v, i32** @g
+define internal i32* @get_address_taken(i32** %pp) {
+  %v = load i32*, i32** %pp
+  store i32* null, i32** @g
+  ret i32* %v
+}
+
+@fptr = global i32* (i32**)* @get_address_taken
+
+define void @test_address_taken() {
+  %a = alloca i32
+  %slot = alloca i32*
+  store i32* %a, i32** %slot
+  %r = call i32* @get_address_taken(i32** %slot)
+  ret void
+}
+
+; Aggregate formals have their fields unified with the values inserted into
+; the actuals.
+
+%slice = type { i32*, i64, i64 }
+
+; CHECK-LABEL: Function: first_internal
+; CHECK: NoAlias: i32* %p, i32** @g
+define internal i32* @first_internal(%slice %s) {
+  %p = extractvalue %slice %s, 0
+  store i32* null, i32** @g
+  ret i32* %p
+}
+
+; CHECK-LABEL: Function: first_external
+; CHECK: MayAlias: i32* %p, i32** @g
+define i32* @first_external(%slice %s) {
+  %p = extractvalue %slice %s, 0
+  store i32* null, i32** @g
+  ret i32* %p
+}
+
+; CHECK-LABEL: Function: test_slice
+; CHECK: MayAlias: i32* %a, i32* %r
+; CHECK: NoAlias: i32* %b, i32* %r
+; CHECK: MayAlias: i32* %b, i32* %e
+; CHECK: NoAlias: i32* %e, i32* %r
+define void @test_slice() {
+  %a = alloca i32
+  %b = alloca i32
+  %s0 = insertvalue %slice undef, i32* %a, 0
+  %s1 = insertvalue %slice %s0, i64 1, 1
+  %r = call i32* @first_internal(%slice %s1)
+  %t = insertvalue %slice undef, i32* %b, 0
+  %e = call i32* @first_external(%slice %t)
+  ret void
+}
+
+; A formal whose fields are not all taken out with extractvalue comes from an
+; unknown caller.
+
+; CHECK-LABEL: Function: first_stored
+; CHECK: MayAlias: i32* %p, i32** @g
+define internal i32* @first_stored(%slice %s, %slice* %out) {
+  store %slice %s, %slice* %out
+  %p = extractvalue %slice %s, 0
+  store i32* null, i32** @g
+  ret i32* %p
+}
+
+define void @test_stored() {
+  %a = alloca i32
+  %out = alloca %slice
+  %s = insertvalue %slice undef, i32* %a, 0
+  %r = call i32* @first_stored(%slice %s, %slice* %out)
+  ret void
+}
@@ -0,0 +1,87 @@
+; Check that printing function bodies on several threads gives the same text
+; as printing them on one, including the slots of unnamed values, metadata
+; and attribute groups that are numbered while the functions are printed.
+
+; RUN: llvm-as < %s | llvm-dis > %t.ll
+; RUN: llvm-as < %s | llvm-dis -asm-writer-threads=3 > %t.threads.ll
+; RUN: diff %t.ll %t.threads.ll
+; RUN: FileCheck %s < %t.threads.ll
+
+@0 = global i32 0
+@addr = global i8* blockaddress(@f, %4)
+
+; CHECK: declare !custom !{{[0-9]+}} void @decl()
+declare !custom !8 void @decl()
+
+; CHECK: define i32 @f(i32) !dbg
+define i32 @f(i32) !dbg !4 {
+  %2 = load i32, i32* @0, !dbg !6
+  %3 = add i32 %2, %0, !dbg !6
+  call void @llvm.dbg.value(metadata i32 %3, metadata !7, metadata !DIExpression()), !dbg !6
+  br label %4
+
+; CHECK: {{^}}4:{{ +}}; preds = %1
+  %5 = phi i32 [ %3, %1 ]
+  ret i32 %5, !dbg !6
+}
+
+; CHECK: define void @g(float)
+; CHECK: call void @decl() #2
+define void @g(float) {
+  %2 = fadd float %0, 1.500000e+00
+  call void @decl() #1
+  ret void
+}
+
+; CHECK: define void @h() #0
+; CHECK: call void @decl() #3
+define void @h() #0 {
+entry:
+  call void @decl() #2
+  br label %loop
+
+; CHECK: loop:{{ +}}; preds = %loop, %entry
+loop:
+  br i1 undef, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; Elements of data arrays and vectors are printed without creating constants
+; for them.
+; CHECK: define <2 x double> @data(<4 x i32>, [3 x i16]*, <2 x half>*)
+; CHECK: add <4 x i32> %0, <i32 1, i32 -2, i32 3, i32 2147483647>
+; CHECK: store [3 x i16] [i16 -1, i16 0, i16 7], [3 x i16]* %1
+; CHECK: store <2 x half> <half 0xH3C00, half 0xH8000>, <2 x half>* %2
+; CHECK: ret <2 x double> <double 1.500000e+00, double 0x7FF8000000000000>
+define <2 x double> @data(<4 x i32>, [3 x i16]*, <2 x half>*) {
+  %4 = add <4 x i32> %0, <i32 1, i32 -2, i32 3, i32 2147483647>
+  store [3 x i16] [i16 -1, i16 0, i16 7], [3 x i16]* %1
+  store <2 x half> <half 0xH3C00, half 0xH8000>, <2 x half>* %2
+  ret <2 x double> <double 1.500000e+00, double 0x7FF8000000000000>
+}
+
+declare void @llvm.dbg.value(metadata, metadata, metadata)
+
+; CHECK: attributes #0 = { nounwind }
+; CHECK: attributes #1 = { nounwind readnone speculatable }
+; CHECK: attributes #2 = { cold }
+; CHECK: attributes #3 = { noinline }
+attributes #0 = { nounwind }
+attributes #1 = { cold }
+attributes #2 = { noinline }
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "t.c", directory: "/")
+!2 = !{}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 1, type: !5, spFlags: DISPFlagDefinition, unit: !0)
+!5 = !DISubroutineType(types: !2)
+!6 = !DILocation(line: 1, scope: !4)
+!7 = !DILocalVariable(name: "a", scope: !4, file: !1, line: 1, type: !9)
+!8 = !{!"decl"}
+!9 = !DIBasicType(name: "int", size: 32, encoding: DW_ATE_signed)
@@ -0,0 +1,63 @@
+; Check that parsing function bodies after the rest of the module gives the
+; same module.
+
+; RUN: llvm-as < %s | llvm-dis > %t.ll
+; RUN: llvm-as -ll-defer-function-bodies < %s | llvm-dis > %t.deferred.ll
+; RUN: diff %t.ll %t.deferred.ll
+; RUN: FileCheck %s < %t.deferred.ll
+
+@addr = global i8* blockaddress(@f, %target)
+
+; CHECK: @addr.after = global i8* blockaddress(@f, %target)
+; CHECK: define i32 @f(i32 %x) !dbg [[DBG:![0-9]+]]
+define i32 @f(i32 %x) !dbg !2 {
+entry:
+  ; CHECK: load i32, i32* @later
+  %v = load i32, i32* @later
+  ; CHECK: call i32 @0(i32 %v)
+  %r = call i32 @0(i32 %v)
+  br label %target
+
+target:
+  ; CHECK: call void @g({ i32, i8 } { i32 1, i8 2 })
+  call void @g({ i32, i8 } { i32 1, i8 2 })
+  ret i32 %r
+}
+
+; CHECK: define internal i32 @0(i32 %y)
+define internal i32 @0(i32 %y) {
+  %z = add i32 %y, 1
+  ret i32 %z
+}
+
+define void @g({ i32, i8 }) {
+  ret void
+}
+
+@later = global i32 0
+
+; Block addresses of deferred bodies may follow the definition, or appear in
+; another deferred body.
+@addr.after = global i8* blockaddress(@f, %target)
+
+; CHECK: define i8* @h()
+; CHECK: ret i8* blockaddress(@k, %next)
+define i8* @h() {
+  ret i8* blockaddress(@k, %next)
+}
+
+define void @k() {
+entry:
+  br label %next
+
+next:
+  ret void
+}
+
+!llvm.dbg.cu = !{!1}
+!llvm.module.flags = !{!0}
+!0 = !{i32 2, !"Debug Info Version", i32 3}
+!1 = distinct !DICompileUnit(language: DW_LANG_C99, file: !3, emissionKind: FullDebug)
+; CHECK: [[DBG]] = distinct !DISubprogram(name: "f"
+!2 = distinct !DISubprogram(name: "f", scope: null, unit: !1, spFlags: DISPFlagDefinition)
+!3 = !DIFile(filename: "t.c", directory: "/")
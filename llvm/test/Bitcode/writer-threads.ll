@@ -0,0 +1,49 @@
+; Check that encoding function blocks on several threads gives the same bytes
+; as encoding them on one.
+
+; RUN: llvm-as < %s -o %t.bc
+; RUN: llvm-as -bitcode-writer-threads=3 < %s -o %t.threads.bc
+; RUN: cmp %t.bc %t.threads.bc
+; RUN: llvm-dis < %t.threads.bc | FileCheck %s
+
+@g = global i32 0
+@addr = global i8* blockaddress(@f, %target)
+
+; CHECK: define i32 @f(i32 %x) !dbg
+define i32 @f(i32 %x) !dbg !4 {
+entry:
+  %v = load i32, i32* @g, !dbg !6
+  %s = add i32 %v, %x, !dbg !6
+  br label %target
+
+target:
+  ret i32 %s, !dbg !6
+}
+
+; CHECK: define void @g2(float %a)
+define void @g2(float %a) {
+  %c = fadd float %a, 1.500000e+00
+  call void @llvm.dbg.value(metadata float %c, metadata !7, metadata !DIExpression()), !dbg !6
+  ret void
+}
+
+; CHECK: define { i32, i8 } @h()
+define { i32, i8 } @h() {
+  ret { i32, i8 } { i32 1, i8 2 }
+}
+
+declare void @llvm.dbg.value(metadata, metadata, metadata)
+
+define i8* @i() {
+  ret i8* bitcast (i32* @g to i8*)
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "t.c", directory: "/")
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 1, type: !5, unit: !0, spFlags: DISPFlagDefinition)
+!5 = !DISubroutineType(types: !{})
+!6 = !DILocation(line: 2, scope: !4)
+!7 = !DILocalVariable(name: "c", scope: !4, file: !1, line: 3, type: null)
@@ -0,0 +1,38 @@
+; RUN: opt < %s -tsan -S | FileCheck %s
+
+; Heap objects that an escape analysis marked !noescape are never visible to
+; another thread, so accesses to them are not instrumented.
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+declare i8* @__go_new(i8*, i64)
+
+define i32 @notcaptured(i8* %type) nounwind uwtable sanitize_thread {
+entry:
+  %mem = call i8* @__go_new(i8* %type, i64 8), !noescape !0
+  %ptr = bitcast i8* %mem to i32*
+  %field = getelementptr i32, i32* %ptr, i64 1
+  store i32 42, i32* %ptr, align 4
+  store i32 7, i32* %field, align 4
+  %val = load i32, i32* %ptr, align 4
+  ret i32 %val
+}
+; CHECK-LABEL: define i32 @notcaptured
+; CHECK-NOT: __tsan_write
+; CHECK-NOT: __tsan_read
+; CHECK: ret i32
+
+define i32 @unknown(i8* %type) nounwind uwtable sanitize_thread {
+entry:
+  %mem = call i8* @__go_new(i8* %type, i64 8)
+  %ptr = bitcast i8* %mem to i32*
+  store i32 42, i32* %ptr, align 4
+  %val = load i32, i32* %ptr, align 4
+  ret i32 %val
+}
+; CHECK-LABEL: define i32 @unknown
+; CHECK: __tsan_write
+; CHECK: __tsan_read
+; CHECK: ret i32
+
+!0 = !{}
@@ -0,0 +1,83 @@
+; Check that running the vectorization and unrolling passes of the -O
+; pipelines on several threads gives the same module as running them on one.
+
+; RUN: opt -O2 -force-vector-width=4 -S < %s > %t.serial.ll
+; RUN: opt -O2 -force-vector-width=4 -opt-threads=4 -opt-threads-grain=1 -S \
+; RUN:   < %s > %t.parallel.ll
+; RUN: diff %t.serial.ll %t.parallel.ll
+; RUN: FileCheck %s < %t.parallel.ll
+
+; Below the grain, the passes run on one thread.
+; RUN: opt -O2 -force-vector-width=4 -opt-threads=2 -S < %s > %t.small.ll
+; RUN: diff %t.serial.ll %t.small.ll
+
+@table = internal constant [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+@counter = global i32 0
+
+define internal i32 @lookup(i32 %i) {
+entry:
+  %slot = alloca i32
+  store i32 %i, i32* %slot
+  %idx = load i32, i32* %slot
+  %p = getelementptr [4 x i32], [4 x i32]* @table, i32 0, i32 %idx
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+; CHECK-LABEL: define i32 @first(
+; CHECK: ret i32 1
+define i32 @first() {
+entry:
+  %p = getelementptr [4 x i32], [4 x i32]* @table, i32 0, i32 0
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+define void @bump(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %c = load i32, i32* @counter
+  %c.next = add i32 %c, 1
+  store i32 %c.next, i32* @counter
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: define i32 @use(
+; CHECK: call i32 @strlen_like(
+define i32 @use(i32 %i) {
+entry:
+  %v = call i32 @lookup(i32 %i)
+  call void @bump(i32 %v)
+  %s = call i32 @strlen_like(i8* null)
+  ret i32 %s
+}
+
+; CHECK-LABEL: define void @scale(
+; CHECK: mul <4 x i32>
+define void @scale(i32* noalias %a, i32 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p
+  %m = mul i32 %v, %k
+  store i32 %m, i32* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 1024
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+declare i32 @strlen_like(i8*)
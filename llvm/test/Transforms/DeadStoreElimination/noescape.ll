@@ -0,0 +1,31 @@
+; RUN: opt < %s -basicaa -dse -S | FileCheck %s
+
+; Stores to an allocation marked !noescape are dead at the end of the
+; function, just like stores to an alloca.
+
+declare i8* @__go_new(i8*, i64)
+declare void @opaque()
+
+define void @test1(i8* %type) {
+; CHECK-LABEL: @test1(
+; CHECK-NOT: store
+; CHECK: ret void
+  %mem = call i8* @__go_new(i8* %type, i64 8), !noescape !0
+  %p = bitcast i8* %mem to i64*
+  store i64 1, i64* %p, align 8
+  call void @opaque()
+  store i64 2, i64* %p, align 8
+  ret void
+}
+
+define void @test2(i8* %type) {
+; CHECK-LABEL: @test2(
+; CHECK: store i64 2, i64* %p, align 8
+; CHECK: ret void
+  %mem = call i8* @__go_new(i8* %type, i64 8)
+  %p = bitcast i8* %mem to i64*
+  store i64 2, i64* %p, align 8
+  ret void
+}
+
+!0 = !{}
@@ -0,0 +1,48 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -escape-annotate -S 2>/dev/null | FileCheck %s
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -S 2>/dev/null | FileCheck %s --check-prefix=NOANNOTATE
+; REQUIRES: loadable_module
+
+; !noescape promises that the object is never captured, so a local object
+; whose address is stored, even into other local memory, is not annotated.
+
+declare i8* @__go_new(i8*, i64)
+declare void @ext_retain(i8*)
+declare void @ext_modify()
+
+@type = external global i8
+
+; CHECK-LABEL: @main.fields(
+; CHECK: %p = call i8* @__go_new(i8* @type, i64 8), !noescape !0
+; NOANNOTATE-NOT: !noescape
+define i64 @main.fields() {
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  %q = bitcast i8* %p to i64*
+  store i64 1, i64* %q
+  %v = load i64, i64* %q
+  ret i64 %v
+}
+
+; CHECK-LABEL: @main.held(
+; CHECK: %p = call i8* @__go_new(i8* @type, i64 8){{$}}
+define i8* @main.held() {
+  %holder = alloca i8*
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  store i8* %p, i8** %holder
+  %v = load i8*, i8** %holder
+  ret i8* null
+}
+
+; An external callee may keep the pointer and write the object later.
+; CHECK-LABEL: @main.retained(
+; CHECK: %p = call i8* @__go_new(i8* @type, i64 8){{$}}
+define i64 @main.retained() {
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  %q = bitcast i8* %p to i64*
+  store i64 1, i64* %q
+  call void @ext_retain(i8* %p)
+  call void @ext_modify()
+  %v = load i64, i64* %q
+  ret i64 %v
+}
@@ -0,0 +1,45 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape-module \
+; RUN:   -disable-output 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; Callee summaries describe what happens to the arguments themselves, not to
+; the memory they reach, so a value stored into memory a defined callee can
+; read is at least a local escape.
+
+declare i8* @__go_new(i8*, i64)
+
+@type = external global i8
+@main.g = global i8* null
+
+define void @main.publish(i8** %h) {
+  %v = load i8*, i8** %h
+  store i8* %v, i8** @main.g
+  ret void
+}
+
+define void @main.keep(i8** %h) {
+  ret void
+}
+
+; CHECK: %p({{.*}}) locally escapes.
+define void @main.caller() {
+  %slot = alloca [2 x i8*]
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  %second = getelementptr [2 x i8*], [2 x i8*]* %slot, i64 0, i64 1
+  store i8* %p, i8** %second
+  %first = getelementptr [2 x i8*], [2 x i8*]* %slot, i64 0, i64 0
+  call void @main.publish(i8** %first)
+  ret void
+}
+
+; Reads after a call that may write the memory still see the value.
+; CHECK: %p({{.*}}) globally escapes.
+define void @main.after() {
+  %slot = alloca i8*
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  store i8* %p, i8** %slot
+  call void @main.keep(i8** %slot)
+  %v = load i8*, i8** %slot
+  store i8* %v, i8** @main.g
+  ret void
+}
@@ -0,0 +1,79 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape-module \
+; RUN:   -disable-output 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; A closure is called through the function pointer in the first word of its
+; context. When the context is built in the caller, the call goes to the
+; function stored there, and the context is as local as that function keeps
+; its `nest' parameter.
+
+declare i8* @__go_new(i8*, i64)
+declare void @__go_go(i8*, i8*)
+
+@type = external global i8
+@main.g = global i8* null
+
+define i64 @main.read$1(i8* nest %ctx) {
+  %words = bitcast i8* %ctx to i64*
+  %slot = getelementptr i64, i64* %words, i64 1
+  %x = load i64, i64* %slot
+  ret i64 %x
+}
+
+define i64 @main.keep$1(i8* nest %ctx) {
+  store i8* %ctx, i8** @main.g
+  ret i64 0
+}
+
+; CHECK: %ctx({{.*}}) is local.
+define i64 @main.apply() {
+  %ctx = call i8* @__go_new(i8* @type, i64 16)
+  %fnslot = bitcast i8* %ctx to i64 (i8*)**
+  store i64 (i8*)* @main.read$1, i64 (i8*)** %fnslot
+  %fn = load i64 (i8*)*, i64 (i8*)** %fnslot
+  %r = call i64 %fn(i8* nest %ctx)
+  ret i64 %r
+}
+
+; CHECK: %ctx({{.*}}) globally escapes.
+define i64 @main.retained() {
+  %ctx = call i8* @__go_new(i8* @type, i64 16)
+  %fnslot = bitcast i8* %ctx to i64 (i8*)**
+  store i64 (i8*)* @main.keep$1, i64 (i8*)** %fnslot
+  %fn = load i64 (i8*)*, i64 (i8*)** %fnslot
+  %r = call i64 %fn(i8* nest %ctx)
+  ret i64 %r
+}
+
+; Either function may be called, so both must keep the context local.
+; CHECK: %ctx({{.*}}) globally escapes.
+define i64 @main.either(i1 %c) {
+  %ctx = call i8* @__go_new(i8* @type, i64 16)
+  %fnslot = bitcast i8* %ctx to i64 (i8*)**
+  br i1 %c, label %read, label %keep
+
+read:
+  store i64 (i8*)* @main.read$1, i64 (i8*)** %fnslot
+  br label %call
+
+keep:
+  store i64 (i8*)* @main.keep$1, i64 (i8*)** %fnslot
+  br label %call
+
+call:
+  %fn = load i64 (i8*)*, i64 (i8*)** %fnslot
+  %r = call i64 %fn(i8* nest %ctx)
+  ret i64 %r
+}
+
+; A goroutine runs concurrently with its parent, so a closure it is started
+; with stays on the heap.
+; CHECK: %ctx({{.*}}) globally escapes.
+define void @main.spawn() {
+  %ctx = call i8* @__go_new(i8* @type, i64 16)
+  %fnslot = bitcast i8* %ctx to i64 (i8*)**
+  store i64 (i8*)* @main.read$1, i64 (i8*)** %fnslot
+  %fn = bitcast i64 (i8*)* @main.read$1 to i8*
+  call void @__go_go(i8* %fn, i8* %ctx)
+  ret void
+}
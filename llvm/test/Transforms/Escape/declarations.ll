@@ -0,0 +1,68 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -disable-output 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; Objects passed to external functions escape, unless the callee is known
+; not to keep its arguments.
+
+declare i8* @__go_new(i8*, i64)
+declare void @__go_print_pointer(i8*)
+declare i32 @__go_strcmp({ i8*, i64 }, { i8*, i64 })
+declare void @ext_retain(i8*)
+declare void @ext_read(i8**)
+declare void @llvm.memset.p0i8.i64(i8* nocapture writeonly, i8, i64, i1)
+
+@type = external global i8
+
+; CHECK-LABEL: Escape: main.retained
+; CHECK: %p({{.*}}) globally escapes.
+define void @main.retained() {
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  %q = bitcast i8* %p to i64*
+  store i64 1, i64* %q
+  call void @ext_retain(i8* %p)
+  ret void
+}
+
+; CHECK-LABEL: Escape: main.allowlisted
+; CHECK: %p({{.*}}) is local.
+define i32 @main.allowlisted() {
+  %p = call i8* @__go_new(i8* @type, i64 16)
+  call void @llvm.memset.p0i8.i64(i8* %p, i8 0, i64 16, i1 false)
+  call void @__go_print_pointer(i8* %p)
+  %s0 = insertvalue { i8*, i64 } undef, i8* %p, 0
+  %s1 = insertvalue { i8*, i64 } %s0, i64 16, 1
+  %c = call i32 @__go_strcmp({ i8*, i64 } %s1, { i8*, i64 } %s1)
+  ret i32 %c
+}
+
+; The contents of a stack slot that an external call reads escape.
+; CHECK-LABEL: Escape: main.contents
+; CHECK: %p({{.*}}) globally escapes.
+define void @main.contents() {
+  %slot = alloca i8*
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  store i8* %p, i8** %slot
+  call void @ext_read(i8** %slot)
+  ret void
+}
+
+; Closure contexts go through the callee like any other argument: a call
+; to a function that is not known may keep its `nest' argument.
+; CHECK-LABEL: Escape: main.closure
+; CHECK: %ctx({{.*}}) globally escapes.
+define void @main.closure(void (i8*)* %fn) {
+  %ctx = call i8* @__go_new(i8* @type, i64 8)
+  call void %fn(i8* nest %ctx)
+  ret void
+}
+
+; Values stored through a pointer loaded from memory may land anywhere.
+; CHECK-LABEL: Escape: main.loaded
+; CHECK: %p({{.*}}) globally escapes.
+define void @main.loaded(i8*** %pp) {
+  %slot = load i8**, i8*** %pp
+  %p = call i8* @__go_new(i8* @type, i64 8)
+  store i8* %p, i8** %slot
+  ret void
+}
@@ -0,0 +1,42 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -escape-merge -S 2>/dev/null | FileCheck %s
+; REQUIRES: loadable_module
+
+; A merged allocation is larger than the type descriptor passed for it, so
+; only objects the collector does not scan are merged: the kind byte of the
+; common header has the no-pointers bit (1 << 7) set.
+
+%commonType = type { i8, i8, i8, i64, i32, i8*, i8*, i8*, i8*, i8*, i8* }
+
+; struct { X, Y int }
+@__go_tdn_main.Point = constant { %commonType } { %commonType { i8 153, i8 8, i8 8, i64 16, i32 0, i8* null, i8* null, i8* null, i8* null, i8* null, i8* null } }
+; struct { Next *Node; X int }
+@__go_tdn_main.Node = constant { %commonType } { %commonType { i8 25, i8 8, i8 8, i64 16, i32 0, i8* null, i8* null, i8* null, i8* null, i8* null, i8* null } }
+
+declare i8* @__go_new(i8*, i64)
+
+; CHECK-LABEL: @main.offset(
+; CHECK: %a = call i8* @__go_new(i8* {{.*}}@__go_tdn_main.Point{{.*}}, i64 32)
+; CHECK-NOT: @__go_new
+; CHECK: ret i8* %a
+define i8* @main.offset() {
+  %a = call i8* @__go_new(i8* bitcast ({ %commonType }* @__go_tdn_main.Point to i8*), i64 16)
+  %b = call i8* @__go_new(i8* bitcast ({ %commonType }* @__go_tdn_main.Point to i8*), i64 16)
+  %ax = bitcast i8* %a to i64*
+  %bx = bitcast i8* %b to i64*
+  store i64 3, i64* %bx
+  %x = load i64, i64* %bx
+  store i64 %x, i64* %ax
+  ret i8* %a
+}
+
+; CHECK-LABEL: @main.pair(
+; CHECK: %a = call i8* @__go_new(i8* {{.*}}@__go_tdn_main.Node{{.*}}, i64 16)
+; CHECK: %b = call i8* @__go_new(i8* {{.*}}@__go_tdn_main.Node{{.*}}, i64 16)
+define i8* @main.pair() {
+  %a = call i8* @__go_new(i8* bitcast ({ %commonType }* @__go_tdn_main.Node to i8*), i64 16)
+  %b = call i8* @__go_new(i8* bitcast ({ %commonType }* @__go_tdn_main.Node to i8*), i64 16)
+  %next = bitcast i8* %a to i8**
+  store i8* %b, i8** %next
+  ret i8* %a
+}
@@ -0,0 +1,66 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -escape-promote -S 2>/dev/null | FileCheck %s
+; REQUIRES: loadable_module
+
+; Every iteration of a loop shares the stack slot of a promoted allocation,
+; so only allocations that die within their iteration are promoted.
+
+declare i8* @__go_new(i8*, i64)
+
+@type = external global i8
+
+; The nodes are linked through a local list head and stay reachable after
+; their iteration.
+; CHECK-LABEL: @main.list(
+; CHECK-NOT: alloca [16 x i8]
+; CHECK: %node = call i8* @__go_new(i8* @type, i64 16)
+define i64 @main.list(i64 %n) {
+entry:
+  %head = alloca i8*
+  store i8* null, i8** %head
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %node = call i8* @__go_new(i8* @type, i64 16)
+  %next = bitcast i8* %node to i8**
+  %old = load i8*, i8** %head
+  store i8* %old, i8** %next
+  store i8* %node, i8** %head
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %first = load i8*, i8** %head
+  %second.slot = bitcast i8* %first to i8**
+  %second = load i8*, i8** %second.slot
+  %same = icmp eq i8* %first, %second
+  %r = zext i1 %same to i64
+  ret i64 %r
+}
+
+; A scratch object that is only used within the iteration.
+; CHECK-LABEL: @main.scratch(
+; CHECK: %tmp.stack = alloca [16 x i8], align 8
+; CHECK-NOT: call i8* @__go_new
+; CHECK: ret i64
+define i64 @main.scratch(i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i64 [ 0, %entry ], [ %sum.next, %loop ]
+  %tmp = call i8* @__go_new(i8* @type, i64 16)
+  %field = bitcast i8* %tmp to i64*
+  store i64 %i, i64* %field
+  %val = load i64, i64* %field
+  %sum.next = add i64 %sum, %val
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i64 %sum.next
+}
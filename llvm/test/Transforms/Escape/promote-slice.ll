@@ -0,0 +1,44 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -escape-promote -S 2>/dev/null | FileCheck %s
+; REQUIRES: loadable_module
+
+; The size of a promoted make([]T, n, m) comes from the type descriptors:
+; the common header keeps the type size in field 3, and a slice descriptor
+; follows the header with its element descriptor in field 1.
+
+%commonType = type { i8, i8, i8, i64, i32, i8*, i8*, i8*, i8*, i8*, i8* }
+%sliceType = type { %commonType, %commonType* }
+%slice = type { i8*, i64, i64 }
+
+@__go_tdn_int64 = constant { %commonType } { %commonType { i8 2, i8 8, i8 8, i64 8, i32 0, i8* null, i8* null, i8* null, i8* null, i8* null, i8* null } }
+@__go_td_AIe1e = constant %sliceType { %commonType { i8 23, i8 8, i8 8, i64 24, i32 0, i8* null, i8* null, i8* null, i8* null, i8* null, i8* null }, %commonType* getelementptr ({ %commonType }, { %commonType }* @__go_tdn_int64, i32 0, i32 0) }
+
+@main.keep = global %slice zeroinitializer
+
+declare %slice @__go_make_slice2(i8*, i64, i64)
+declare %slice @__go_append(%slice, i8*, i64, i64)
+
+; Four int64 elements take 32 bytes.
+; CHECK-LABEL: @main.local(
+; CHECK: %s.stack = alloca [32 x i8], align 8
+; CHECK-NOT: call %slice @__go_make_slice2
+define i64 @main.local() {
+  %s = call %slice @__go_make_slice2(i8* bitcast (%sliceType* @__go_td_AIe1e to i8*), i64 2, i64 4)
+  %p = extractvalue %slice %s, 0
+  %q = bitcast i8* %p to i64*
+  store i64 1, i64* %q
+  %v = load i64, i64* %q
+  ret i64 %v
+}
+
+; The result of append may share the backing array of its argument, so
+; storing it to a global keeps the array on the heap.
+; CHECK-LABEL: @main.appended(
+; CHECK-NOT: alloca
+; CHECK: %s = call %slice @__go_make_slice2
+define void @main.appended(i8* %elems) {
+  %s = call %slice @__go_make_slice2(i8* bitcast (%sliceType* @__go_td_AIe1e to i8*), i64 2, i64 4)
+  %t = call %slice @__go_append(%slice %s, i8* %elems, i64 1, i64 8)
+  store %slice %t, %slice* @main.keep
+  ret void
+}
@@ -0,0 +1,38 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMEscape%shlibext -escape \
+; RUN:   -escape-annotate 2>/dev/null | opt -tsan -S | FileCheck %s
+; REQUIRES: loadable_module
+
+; ThreadSanitizer skips objects the escape pass marks !noescape, so objects
+; another thread may reach must keep their instrumentation.
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+declare i8* @__go_new(i8*, i64)
+declare void @ext_retain(i8*)
+
+@type = external global i8
+
+; CHECK-LABEL: define i32 @main.local(
+; CHECK-NOT: __tsan_write
+; CHECK-NOT: __tsan_read
+; CHECK: ret i32
+define i32 @main.local() sanitize_thread {
+  %mem = call i8* @__go_new(i8* @type, i64 8)
+  %ptr = bitcast i8* %mem to i32*
+  store i32 42, i32* %ptr, align 4
+  %val = load i32, i32* %ptr, align 4
+  ret i32 %val
+}
+
+; CHECK-LABEL: define i32 @main.retained(
+; CHECK: __tsan_write4
+; CHECK: __tsan_read4
+; CHECK: ret i32
+define i32 @main.retained() sanitize_thread {
+  %mem = call i8* @__go_new(i8* @type, i64 8)
+  %ptr = bitcast i8* %mem to i32*
+  store i32 42, i32* %ptr, align 4
+  call void @ext_retain(i8* %mem)
+  %val = load i32, i32* %ptr, align 4
+  ret i32 %val
+}
@@ -0,0 +1,105 @@
+; RUN: opt -basicaa -licm -S < %s | FileCheck %s
+; RUN: opt -aa-pipeline=basic-aa -passes='require<aa>,require<targetir>,require<scalar-evolution>,require<opt-remark-emit>,loop(licm)' -S %s | FileCheck %s
+
+; Allocations marked !noescape are never captured, so calls in the loop can't
+; access them and stores may be inserted on paths that didn't have them.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i8* @__go_new(i8*, i64)
+declare void @opaque()
+
+; CHECK-LABEL: @accumulate
+define i64 @accumulate(i8* %type, i64 %n) {
+entry:
+  %mem = call i8* @__go_new(i8* %type, i64 16), !noescape !0
+  %sum = bitcast i8* %mem to i64*
+  br label %loop.ph
+
+loop.ph:
+; CHECK-LABEL: loop.ph:
+; CHECK-NEXT: %sum.promoted = load i64, i64* %sum, align 8
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %loop.ph ], [ %inc, %loop ]
+  %old = load i64, i64* %sum, align 8
+  %new = add i64 %old, %i
+  store i64 %new, i64* %sum, align 8
+  call void @opaque()
+  %inc = add nuw i64 %i, 1
+  %cmp = icmp ult i64 %inc, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+; CHECK-LABEL: exit:
+; CHECK: store i64 %new.lcssa, i64* %sum, align 8
+  %res = load i64, i64* %sum, align 8
+  ret i64 %res
+}
+
+; CHECK-LABEL: @accumulate_early_exit
+define i64 @accumulate_early_exit(i8* %type, i8** %flag, i64 %n) {
+entry:
+  %mem = call i8* @__go_new(i8* %type, i64 16), !noescape !0
+  %sum = bitcast i8* %mem to i64*
+  br label %loop.ph
+
+loop.ph:
+; CHECK-LABEL: loop.ph:
+; CHECK-NEXT: %sum.promoted = load i64, i64* %sum, align 8
+  br label %loop.header
+
+loop.header:
+  %i = phi i64 [ 0, %loop.ph ], [ %inc, %loop.body ]
+  %old = load i64, i64* %sum, align 8
+  %guard = load atomic i8*, i8** %flag monotonic, align 8
+  %exitcmp = icmp eq i8* %guard, null
+  br i1 %exitcmp, label %loop.body, label %early.exit
+
+early.exit:
+; CHECK-LABEL: early.exit:
+; CHECK: store i64 %new1.lcssa, i64* %sum, align 8
+  ret i64 0
+
+loop.body:
+  %new = add i64 %old, 1
+  store i64 %new, i64* %sum, align 8
+  %inc = add nuw i64 %i, 1
+  %cmp = icmp ult i64 %inc, %n
+  br i1 %cmp, label %loop.header, label %exit
+
+exit:
+; CHECK-LABEL: exit:
+; CHECK: store i64 %new.lcssa, i64* %sum, align 8
+  ret i64 1
+}
+
+; Without the metadata the call may read or write the object.
+; CHECK-LABEL: @accumulate_unknown
+define i64 @accumulate_unknown(i8* %type, i64 %n) {
+entry:
+  %mem = call i8* @__go_new(i8* %type, i64 16)
+  %sum = bitcast i8* %mem to i64*
+  br label %loop
+
+; CHECK-LABEL: loop:
+; CHECK: load i64, i64* %sum, align 8
+; CHECK: store i64 %new, i64* %sum, align 8
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %old = load i64, i64* %sum, align 8
+  %new = add i64 %old, %i
+  store i64 %new, i64* %sum, align 8
+  call void @opaque()
+  %inc = add nuw i64 %i, 1
+  %cmp = icmp ult i64 %inc, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %res = load i64, i64* %sum, align 8
+  ret i64 %res
+}
+
+!0 = !{}
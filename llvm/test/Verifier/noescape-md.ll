@@ -0,0 +1,19 @@
+; RUN: not llvm-as < %s -o /dev/null 2>&1 | FileCheck %s
+
+declare i64 @bar()
+
+define void @f1() {
+entry:
+  call i64 @bar(), !noescape !{}
+  ret void
+}
+; CHECK: noescape applies only to pointer types
+; CHECK-NEXT: call i64 @bar()
+
+define i8* @f2(i8** %x) {
+entry:
+  %y = load i8*, i8** %x, !noescape !{}
+  ret i8* %y
+}
+; CHECK: noescape applies only to call and invoke instructions
+; CHECK-NEXT: load i8*, i8** %x
@@ -0,0 +1,29 @@
+; Check that a compile unit reached only from a function that another thread
+; verified still has to be listed in llvm.dbg.cu.
+
+; RUN: llvm-as -disable-output < %s 2> %t.serial
+; RUN: llvm-as -disable-output -verify-threads=2 < %s 2> %t.threads
+; RUN: diff %t.serial %t.threads
+; RUN: FileCheck %s < %t.threads
+
+define void @f() !dbg !4 {
+  ret void
+}
+
+define void @g() !dbg !5 {
+  ret void
+}
+
+; CHECK: DICompileUnit not listed in llvm.dbg.cu
+; CHECK-NEXT: !{{[0-9]+}} = distinct !DICompileUnit(language: DW_LANG_C99, file: !{{[0-9]+}}
+; CHECK: warning: ignoring invalid debug info
+!llvm.module.flags = !{!0}
+!0 = !{i32 2, !"Debug Info Version", i32 3}
+
+!llvm.dbg.cu = !{!1}
+!1 = distinct !DICompileUnit(language: DW_LANG_C99, file: !2)
+!2 = !DIFile(filename: "a.c", directory: "/")
+!3 = distinct !DICompileUnit(language: DW_LANG_C99, file: !6)
+!4 = distinct !DISubprogram(name: "f", scope: !2, file: !2, spFlags: DISPFlagDefinition, unit: !1)
+!5 = distinct !DISubprogram(name: "g", scope: !6, file: !6, spFlags: DISPFlagDefinition, unit: !3)
+!6 = !DIFile(filename: "b.c", directory: "/")
@@ -0,0 +1,23 @@
+; Check that problems which only show up across functions verified by
+; different threads are reported, and reported as on one thread.
+
+; RUN: not llvm-as -disable-output < %s 2> %t.serial
+; RUN: not llvm-as -disable-output -verify-threads=4 < %s 2> %t.threads
+; RUN: diff %t.serial %t.threads
+; RUN: FileCheck %s < %t.threads
+
+declare void @llvm.localescape(...)
+declare i8* @llvm.localrecover(i8*, i8*, i32)
+
+; CHECK: all indices passed to llvm.localrecover must be less than the number of arguments passed to llvm.localescape in the parent function
+; CHECK-NEXT: void ()* @parent
+define void @parent() {
+  %a = alloca i8
+  call void (...) @llvm.localescape(i8* %a)
+  ret void
+}
+
+define i8* @child(i8* %fp) {
+  %a = call i8* @llvm.localrecover(i8* bitcast (void ()* @parent to i8*), i8* %fp, i32 1)
+  ret i8* %a
+}
@@ -0,0 +1,26 @@
+; Check that a subprogram attached to two functions verified by different
+; threads, and a compile unit only reached from the second of them, are
+; reported as on one thread.
+
+; RUN: llvm-as -disable-output < %s 2> %t.serial
+; RUN: llvm-as -disable-output -verify-threads=2 < %s 2> %t.threads
+; RUN: diff %t.serial %t.threads
+; RUN: FileCheck %s < %t.threads
+
+; CHECK: DISubprogram attached to more than one function
+define void @f() !dbg !4 {
+  ret void
+}
+
+define void @g() !dbg !4 {
+  ret void
+}
+
+; CHECK: warning: ignoring invalid debug info
+!llvm.module.flags = !{!0}
+!0 = !{i32 2, !"Debug Info Version", i32 3}
+
+!llvm.dbg.cu = !{!1}
+!1 = distinct !DICompileUnit(language: DW_LANG_C99, file: !2)
+!2 = !DIFile(filename: "t.c", directory: "/")
+!4 = distinct !DISubprogram(name: "f", scope: !2, file: !2, spFlags: DISPFlagDefinition, unit: !1)
@@ -0,0 +1,47 @@
+; Check that a valid module whose functions share debug info and frame
+; escapes verifies on several threads without complaint.
+
+; RUN: llvm-as -disable-output -verify-threads=4 < %s 2>&1 | count 0
+; RUN: llvm-as -verify-threads=4 < %s | llvm-dis | FileCheck %s
+
+declare void @llvm.localescape(...)
+declare i8* @llvm.localrecover(i8*, i8*, i32)
+
+; CHECK: define void @parent() !dbg [[PARENT:![0-9]+]]
+define void @parent() !dbg !4 {
+  %a = alloca i8
+  %b = alloca i8
+  call void (...) @llvm.localescape(i8* %a, i8* %b)
+  ret void, !dbg !7
+}
+
+; CHECK: define i8* @child(i8* %fp) !dbg [[CHILD:![0-9]+]]
+define i8* @child(i8* %fp) !dbg !5 {
+  %b = call i8* @llvm.localrecover(i8* bitcast (void ()* @parent to i8*), i8* %fp, i32 1), !dbg !8
+  ret i8* %b
+}
+
+; CHECK: define void @other() !dbg [[OTHER:![0-9]+]]
+define void @other() !dbg !6 {
+  ret void, !dbg !9
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 2, !"Debug Info Version", i32 3}
+
+; The first two functions are in one compile unit, the last in another.
+!llvm.dbg.cu = !{!1, !10}
+!1 = distinct !DICompileUnit(language: DW_LANG_C99, file: !2)
+!2 = !DIFile(filename: "a.c", directory: "/")
+!3 = !DISubroutineType(types: !{})
+; CHECK-DAG: [[PARENT]] = distinct !DISubprogram(name: "parent"
+; CHECK-DAG: [[CHILD]] = distinct !DISubprogram(name: "child"
+; CHECK-DAG: [[OTHER]] = distinct !DISubprogram(name: "other"
+!4 = distinct !DISubprogram(name: "parent", scope: !2, file: !2, type: !3, spFlags: DISPFlagDefinition, unit: !1)
+!5 = distinct !DISubprogram(name: "child", scope: !2, file: !2, type: !3, spFlags: DISPFlagDefinition, unit: !1)
+!6 = distinct !DISubprogram(name: "other", scope: !11, file: !11, type: !3, spFlags: DISPFlagDefinition, unit: !10)
+!7 = !DILocation(line: 1, scope: !4)
+!8 = !DILocation(line: 2, scope: !5)
+!9 = !DILocation(line: 3, scope: !6)
+!10 = distinct !DICompileUnit(language: DW_LANG_C99, file: !11)
+!11 = !DIFile(filename: "b.c", directory: "/")
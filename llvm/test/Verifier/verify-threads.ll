@@ -0,0 +1,38 @@
+; Check that verifying functions on several threads reports problems the same
+; way, in the same order, as verifying them on one.
+
+; RUN: not llvm-as -disable-output < %s 2> %t.serial
+; RUN: not llvm-as -disable-output -verify-threads=4 < %s 2> %t.threads
+; RUN: diff %t.serial %t.threads
+; RUN: FileCheck %s < %t.threads
+
+define i32 @ok1(i32 %x) {
+  %y = add i32 %x, 1
+  ret i32 %y
+}
+
+; CHECK: Instruction does not dominate all uses!
+; CHECK-NEXT: %y = add i32 %x, 1
+define i32 @broken1(i32 %x) {
+entry:
+  br label %next
+dead:
+  %y = add i32 %x, 1
+  br label %next
+next:
+  ret i32 %y
+}
+
+define void @ok2() {
+  ret void
+}
+
+; CHECK: Wrong types for attribute:
+define void @broken2(i32 nonnull %x) {
+  ret void
+}
+
+define i32 @ok3(i32* %p) {
+  %v = load i32, i32* %p
+  ret i32 %v
+}
@@ -15,13 +15,20 @@
 #include "Debugify.h"
 #include "NewPMDriver.h"
 #include "PassPrinters.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
+#include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/RegionPass.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/CodeGen/CommandFlags.inc"
 #include "llvm/CodeGen/TargetPassConfig.h"
@@ -34,8 +41,10 @@
 #include "llvm/IR/LegacyPassNameParser.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/RemarkStreamer.h"
+#include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/IRMover.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/LinkAllIR.h"
 #include "llvm/LinkAllPasses.h"
@@ -48,6 +57,7 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/YAMLTraits.h"
@@ -193,6 +203,18 @@ static cl::opt<bool> EmitSummaryIndex("module-summary",
 static cl::opt<bool> EmitModuleHash("module-hash", cl::desc("Emit module hash"),
                                     cl::init(false));
 
+static cl::opt<unsigned> OptThreads(
+    "opt-threads",
+    cl::desc("Number of threads running the vectorization and unrolling "
+             "passes of the -O<n> pipelines (default = 1)"),
+    cl::init(1));
+
+static cl::opt<unsigned> OptThreadsGrain(
+    "opt-threads-grain", cl::Hidden,
+    cl::desc("Number of instructions each thread of -opt-threads gets at "
+             "least (default = 20000)"),
+    cl::init(20000));
+
 static cl::opt<bool>
 DisableSimplifyLibCalls("disable-simplify-libcalls",
                         cl::desc("Disable simplify-libcalls"));
@@ -356,28 +378,14 @@ static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
     PM.add(createVerifierPass());
 }
 
-/// This routine adds optimization passes based on selected optimization level,
-/// OptLevel.
-///
-/// OptLevel - Optimization Level
-static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
-                                  legacy::FunctionPassManager &FPM,
-                                  TargetMachine *TM, unsigned OptLevel,
-                                  unsigned SizeLevel) {
-  if (!NoVerify || VerifyEach)
-    FPM.add(createVerifierPass()); // Verify that input is correct
-
-  PassManagerBuilder Builder;
+/// This routine sets up \p Builder for the selected optimization level,
+/// OptLevel, as far as the command line options go. The inliner is left to
+/// the caller.
+static void ConfigureBuilder(PassManagerBuilder &Builder, TargetMachine *TM,
+                             unsigned OptLevel, unsigned SizeLevel) {
   Builder.OptLevel = OptLevel;
   Builder.SizeLevel = SizeLevel;
 
-  if (DisableInline) {
-    // No inlining pass
-  } else if (OptLevel > 1) {
-    Builder.Inliner = createFunctionInliningPass(OptLevel, SizeLevel, false);
-  } else {
-    Builder.Inliner = createAlwaysInlinerLegacyPass();
-  }
   Builder.DisableUnrollLoops = (DisableLoopUnrolling.getNumOccurrences() > 0) ?
                                DisableLoopUnrolling : OptLevel == 0;
 
@@ -423,6 +431,32 @@ static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
   default:
     break;
   }
+}
+
+/// This routine adds optimization passes based on selected optimization level,
+/// OptLevel.
+///
+/// OptLevel - Optimization Level
+/// FunctionOptimizer - Pass to run the function passes that follow inlining,
+/// or null to add them to MPM
+static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
+                                  legacy::FunctionPassManager &FPM,
+                                  TargetMachine *TM, unsigned OptLevel,
+                                  unsigned SizeLevel, Pass *FunctionOptimizer) {
+  if (!NoVerify || VerifyEach)
+    FPM.add(createVerifierPass()); // Verify that input is correct
+
+  PassManagerBuilder Builder;
+  ConfigureBuilder(Builder, TM, OptLevel, SizeLevel);
+
+  if (DisableInline) {
+    // No inlining pass
+  } else if (OptLevel > 1) {
+    Builder.Inliner = createFunctionInliningPass(OptLevel, SizeLevel, false);
+  } else {
+    Builder.Inliner = createAlwaysInlinerLegacyPass();
+  }
+  Builder.FunctionOptimizer = FunctionOptimizer;
 
   Builder.populateFunctionPassManager(FPM);
   Builder.populateModulePassManager(MPM);
@@ -472,6 +506,301 @@ static TargetMachine* GetTargetMachine(Triple TheTriple, StringRef CPUStr,
                                         getCodeModel(), GetCodeGenOptLevel());
 }
 
+//===----------------------------------------------------------------------===//
+// Parallel function optimization passes.
+//
+
+/// Records \p Owner as the user of the distinct nodes reachable from \p MD,
+/// and returns false if one of them already has another.
+static bool claimDistinctNodes(const Metadata *MD, const Function *Owner,
+                               DenseMap<const MDNode *, const Function *> &Owners,
+                               SmallPtrSetImpl<const MDNode *> &Visited) {
+  SmallVector<const MDNode *, 16> Worklist;
+  if (auto *N = dyn_cast_or_null<MDNode>(MD))
+    if (Visited.insert(N).second)
+      Worklist.push_back(N);
+  while (!Worklist.empty()) {
+    const MDNode *N = Worklist.pop_back_val();
+    if (N->isDistinct()) {
+      auto It = Owners.try_emplace(N, Owner).first;
+      if (It->second != Owner)
+        return false;
+    }
+    for (const MDOperand &Op : N->operands())
+      if (auto *OpN = dyn_cast_or_null<MDNode>(Op.get()))
+        if (Visited.insert(OpN).second)
+          Worklist.push_back(OpN);
+  }
+  return true;
+}
+
+/// Returns true if the functions of \p M can be optimized in copies of the
+/// module living in other contexts and then moved back unchanged.
+static bool canRunFunctionPassesInParallel(const Module &M) {
+  // Moving a body to another module copies the distinct nodes it references,
+  // such as compile units and loop IDs. This only keeps their identity if no
+  // other function and no module-level metadata refers to them.
+  DenseMap<const MDNode *, const Function *> Owners;
+  SmallPtrSet<const MDNode *, 32> Visited;
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  for (const NamedMDNode &NMD : M.named_metadata())
+    for (const MDNode *N : NMD.operands())
+      if (!claimDistinctNodes(N, nullptr, Owners, Visited))
+        return false;
+  for (const GlobalVariable &GV : M.globals()) {
+    GV.getAllMetadata(MDs);
+    for (const auto &MD : MDs)
+      if (!claimDistinctNodes(MD.second, nullptr, Owners, Visited))
+        return false;
+  }
+  for (const Function &F : M) {
+    Visited.clear();
+    F.getAllMetadata(MDs);
+    for (const auto &MD : MDs)
+      if (!claimDistinctNodes(MD.second, &F, Owners, Visited))
+        return false;
+    for (const BasicBlock &BB : F)
+      for (const Instruction &I : BB) {
+        I.getAllMetadata(MDs);
+        for (const auto &MD : MDs)
+          if (!claimDistinctNodes(MD.second, &F, Owners, Visited))
+            return false;
+        for (const Value *Op : I.operands())
+          if (auto *MAV = dyn_cast<MetadataAsValue>(Op))
+            if (!claimDistinctNodes(MAV->getMetadata(), &F, Owners, Visited))
+              return false;
+      }
+  }
+  // Bodies are matched with their originals by name.
+  for (const GlobalValue &GV : M.global_values())
+    if (!GV.hasName())
+      return false;
+  // A blockaddress can't refer to a function defined in another partition.
+  for (const Function &F : M)
+    for (const BasicBlock &BB : F)
+      if (BB.hasAddressTaken())
+        return false;
+  return true;
+}
+
+/// Runs the passes of PassManagerBuilder::populateFunctionOptimizationPasses
+/// for one -O<n> level over \p Functions of \p M. GlobalsAA results for the
+/// whole module are computed first, as the module pipeline does.
+static void runFunctionOptimizationPasses(Module &M,
+                                          ArrayRef<Function *> Functions,
+                                          unsigned OptLevel, unsigned SizeLevel,
+                                          const TargetLibraryInfoImpl &TLII,
+                                          TargetMachine *TM) {
+  TargetLibraryInfo TLI(TLII);
+  CallGraph CG(M);
+  GlobalsAAResult GlobalsAA = GlobalsAAResult::analyzeModule(M, TLI, CG);
+
+  legacy::FunctionPassManager FPM(&M);
+  FPM.add(new TargetLibraryInfoWrapperPass(TLII));
+  FPM.add(createTargetTransformInfoWrapperPass(
+      TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
+  FPM.add(createExternalAAWrapperPass(
+      [&](Pass &, Function &, AAResults &AAR) { AAR.addAAResult(GlobalsAA); }));
+  PassManagerBuilder Builder;
+  ConfigureBuilder(Builder, TM, OptLevel, SizeLevel);
+  Builder.populateFunctionOptimizationPasses(FPM);
+
+  FPM.doInitialization();
+  for (Function *F : Functions)
+    FPM.run(*F);
+  FPM.doFinalization();
+}
+
+namespace {
+/// Runs the function passes that follow inlining in the -O<n> pipeline of one
+/// level, on -opt-threads threads. They only change the function they run on,
+/// so the defined functions are split into contiguous chunks of about the same
+/// size. Each thread reads the module into its own LLVMContext and optimizes
+/// its chunk there. The optimized bodies are then moved back in function
+/// order, and the counters that make new value names unique are carried along
+/// both ways, so the result does not depend on the number of threads.
+class ParallelFunctionOptimizer : public ModulePass {
+  unsigned OptLevel;
+  unsigned SizeLevel;
+  const TargetLibraryInfoImpl &TLII;
+  std::function<std::unique_ptr<TargetMachine>()> CreateTM;
+
+public:
+  static char ID;
+
+  ParallelFunctionOptimizer(
+      unsigned OptLevel, unsigned SizeLevel, const TargetLibraryInfoImpl &TLII,
+      std::function<std::unique_ptr<TargetMachine>()> CreateTM)
+      : ModulePass(ID), OptLevel(OptLevel), SizeLevel(SizeLevel), TLII(TLII),
+        CreateTM(std::move(CreateTM)) {}
+
+  StringRef getPassName() const override {
+    return "Parallel function optimization";
+  }
+
+  bool runOnModule(Module &M) override;
+};
+} // end anonymous namespace
+
+char ParallelFunctionOptimizer::ID = 0;
+
+bool ParallelFunctionOptimizer::runOnModule(Module &M) {
+  std::vector<Function *> Defined;
+  uint64_t TotalSize = 0;
+  for (Function &F : M)
+    if (!F.isDeclaration()) {
+      Defined.push_back(&F);
+      TotalSize += F.getInstructionCount();
+    }
+
+  // Reading the module on each thread and moving the bodies back is serial
+  // work that only pays off for chunks of some size.
+  unsigned NumParts = std::min<uint64_t>(
+      OptThreads, TotalSize / std::max<unsigned>(OptThreadsGrain, 1));
+  if (NumParts < 2 || !canRunFunctionPassesInParallel(M)) {
+    std::unique_ptr<TargetMachine> TM = CreateTM();
+    runFunctionOptimizationPasses(M, Defined, OptLevel, SizeLevel, TLII,
+                                  TM.get());
+    return true;
+  }
+
+  // Local symbols are linked by name while the bodies move between modules.
+  std::vector<std::pair<std::string, GlobalValue::LinkageTypes>> LocalLinkages;
+  for (GlobalValue &GV : M.global_values())
+    if (GV.hasLocalLinkage()) {
+      LocalLinkages.emplace_back(GV.getName(), GV.getLinkage());
+      GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+
+  std::vector<std::string> FunctionOrder;
+  StringSet<> OriginalFunctions;
+  for (const Function &F : M) {
+    FunctionOrder.push_back(F.getName());
+    OriginalFunctions.insert(F.getName());
+  }
+
+  // The names of the functions of each chunk, and the last unique name suffix
+  // of each, to start the copies from and to take back from them.
+  std::vector<std::vector<std::string>> Parts(NumParts);
+  std::vector<std::vector<uint32_t>> LastUniques(NumParts);
+  uint64_t Size = 0;
+  unsigned Part = 0;
+  for (Function *F : Defined) {
+    Parts[Part].push_back(F->getName());
+    const ValueSymbolTable *ST = F->getValueSymbolTable();
+    LastUniques[Part].push_back(ST ? ST->getLastUnique() : 0);
+    Size += F->getInstructionCount();
+    if (Part + 1 < NumParts && Size * NumParts >= TotalSize * (Part + 1))
+      ++Part;
+  }
+  uint32_t ModuleLastUnique = M.getValueSymbolTable().getLastUnique();
+  std::vector<uint32_t> ModuleRenames(NumParts);
+
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  WriteBitcodeToFile(M, OS, /*ShouldPreserveUseListOrder=*/true);
+
+  std::vector<SmallVector<char, 0>> Results(NumParts);
+  bool DiscardNames = M.getContext().shouldDiscardValueNames();
+  ThreadPool Pool(NumParts);
+  for (unsigned I = 0; I != NumParts; ++I)
+    Pool.async([&, I]() {
+      LLVMContext Ctx;
+      Ctx.setDiscardValueNames(DiscardNames);
+      auto PartMOrErr = parseBitcodeFile(
+          MemoryBufferRef(StringRef(Buffer.data(), Buffer.size()),
+                          "<opt-threads partition>"),
+          Ctx);
+      if (!PartMOrErr)
+        report_fatal_error(toString(PartMOrErr.takeError()));
+      Module &PartM = **PartMOrErr;
+
+      std::vector<Function *> Functions;
+      for (unsigned J = 0, E = Parts[I].size(); J != E; ++J) {
+        Function *F = PartM.getFunction(Parts[I][J]);
+        if (ValueSymbolTable *ST = F->getValueSymbolTable())
+          ST->setLastUnique(LastUniques[I][J]);
+        Functions.push_back(F);
+      }
+      PartM.getValueSymbolTable().setLastUnique(ModuleLastUnique);
+
+      std::unique_ptr<TargetMachine> TM = CreateTM();
+      runFunctionOptimizationPasses(PartM, Functions, OptLevel, SizeLevel, TLII,
+                                    TM.get());
+
+      for (unsigned J = 0, E = Functions.size(); J != E; ++J)
+        if (const ValueSymbolTable *ST = Functions[J]->getValueSymbolTable())
+          LastUniques[I][J] = ST->getLastUnique();
+      ModuleRenames[I] =
+          PartM.getValueSymbolTable().getLastUnique() - ModuleLastUnique;
+
+      // Only the bodies of this chunk go back.
+      SmallPtrSet<Function *, 16> InPart(Functions.begin(), Functions.end());
+      for (Function &F : PartM)
+        if (!F.isDeclaration() && !InPart.count(&F))
+          F.deleteBody();
+      raw_svector_ostream ResultOS(Results[I]);
+      WriteBitcodeToFile(PartM, ResultOS, /*ShouldPreserveUseListOrder=*/true);
+    });
+  Pool.wait();
+
+  // Move the bodies back. Declarations the passes introduced are placed after
+  // the original functions, in the order they were created.
+  std::vector<std::string> NewFunctions;
+  IRMover Mover(M);
+  for (unsigned I = 0; I != NumParts; ++I) {
+    auto SrcMOrErr = parseBitcodeFile(
+        MemoryBufferRef(StringRef(Results[I].data(), Results[I].size()),
+                        "<opt-threads partition>"),
+        M.getContext());
+    if (!SrcMOrErr)
+      report_fatal_error(toString(SrcMOrErr.takeError()));
+    std::unique_ptr<Module> SrcM = std::move(*SrcMOrErr);
+
+    // Everything but the function bodies is already in M.
+    while (!SrcM->named_metadata_empty())
+      SrcM->eraseNamedMetadata(&*SrcM->named_metadata_begin());
+    SrcM->setModuleInlineAsm("");
+
+    std::vector<GlobalValue *> ToMove;
+    for (Function &F : *SrcM) {
+      if (!F.isDeclaration())
+        ToMove.push_back(&F);
+      else if (OriginalFunctions.insert(F.getName()).second)
+        NewFunctions.push_back(F.getName());
+    }
+    if (Error E = Mover.move(std::move(SrcM), ToMove,
+                             [](GlobalValue &, IRMover::ValueAdder) {},
+                             /*IsPerformingImport=*/false))
+      report_fatal_error(toString(std::move(E)));
+  }
+
+  auto &Functions = M.getFunctionList();
+  for (auto &Name : FunctionOrder)
+    Functions.splice(Functions.end(), Functions,
+                     M.getFunction(Name)->getIterator());
+  for (auto &Name : NewFunctions)
+    Functions.splice(Functions.end(), Functions,
+                     M.getFunction(Name)->getIterator());
+
+  for (auto &Local : LocalLinkages)
+    M.getNamedValue(Local.first)->setLinkage(Local.second);
+
+  // Moving the bodies renamed values of its own; continue from the counters
+  // the serial passes would have left.
+  for (unsigned I = 0; I != NumParts; ++I)
+    for (unsigned J = 0, E = Parts[I].size(); J != E; ++J) {
+      Function *F = M.getFunction(Parts[I][J]);
+      if (ValueSymbolTable *ST = F->getValueSymbolTable())
+        ST->setLastUnique(LastUniques[I][J]);
+    }
+  uint32_t Renames = 0;
+  for (uint32_t PartRenames : ModuleRenames)
+    Renames += PartRenames;
+  M.getValueSymbolTable().setLastUnique(ModuleLastUnique + Renames);
+  return true;
+}
+
 #ifdef LINK_POLLY_INTO_TOOLS
 namespace polly {
 void initializePollyPasses(llvm::PassRegistry &Registry);
@@ -722,6 +1051,31 @@ int main(int argc, char **argv) {
         TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
   }
 
+  // With -opt-threads, the function passes that follow inlining run on
+  // several threads, each with a target machine of its own. The passes on the
+  // threads only get the analyses of the -O<n> pipeline, so this is not done
+  // when other passes are requested.
+  bool OptimizeFunctionsInParallel = OptThreads > 1 && PassList.empty() &&
+                                     !OptRemarkFile && !DebugifyEach &&
+                                     !TimePassesIsEnabled;
+  CodeGenOpt::Level CGOptLevel = TM ? TM->getOptLevel() : CodeGenOpt::None;
+  auto CreateTM = [&]() -> std::unique_ptr<TargetMachine> {
+    if (!TM)
+      return nullptr;
+    std::unique_ptr<TargetMachine> ThreadTM(
+        GetTargetMachine(ModuleTriple, CPUStr, FeaturesStr, Options));
+    ThreadTM->setOptLevel(CGOptLevel);
+    return ThreadTM;
+  };
+  auto AddOptLevel = [&](unsigned OptLevel, unsigned SizeLevel) {
+    Pass *FunctionOptimizer = nullptr;
+    if (OptimizeFunctionsInParallel)
+      FunctionOptimizer =
+          new ParallelFunctionOptimizer(OptLevel, SizeLevel, TLII, CreateTM);
+    AddOptimizationPasses(Passes, *FPasses, TM.get(), OptLevel, SizeLevel,
+                          FunctionOptimizer);
+  };
+
   if (PrintBreakpoints) {
     // Default to standard output.
     if (!Out) {
@@ -756,32 +1110,32 @@ int main(int argc, char **argv) {
     }
 
     if (OptLevelO0 && OptLevelO0.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 0, 0);
+      AddOptLevel(0, 0);
       OptLevelO0 = false;
     }
 
     if (OptLevelO1 && OptLevelO1.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 1, 0);
+      AddOptLevel(1, 0);
       OptLevelO1 = false;
     }
 
     if (OptLevelO2 && OptLevelO2.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 0);
+      AddOptLevel(2, 0);
       OptLevelO2 = false;
     }
 
     if (OptLevelOs && OptLevelOs.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 1);
+      AddOptLevel(2, 1);
       OptLevelOs = false;
     }
 
     if (OptLevelOz && OptLevelOz.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 2);
+      AddOptLevel(2, 2);
       OptLevelOz = false;
     }
 
     if (OptLevelO3 && OptLevelO3.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, TM.get(), 3, 0);
+      AddOptLevel(3, 0);
       OptLevelO3 = false;
     }
 
@@ -831,22 +1185,22 @@ int main(int argc, char **argv) {
   }
 
   if (OptLevelO0)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 0, 0);
+    AddOptLevel(0, 0);
 
   if (OptLevelO1)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 1, 0);
+    AddOptLevel(1, 0);
 
   if (OptLevelO2)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 0);
+    AddOptLevel(2, 0);
 
   if (OptLevelOs)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 1);
+    AddOptLevel(2, 1);
 
   if (OptLevelOz)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 2, 2);
+    AddOptLevel(2, 2);
 
   if (OptLevelO3)
-    AddOptimizationPasses(Passes, *FPasses, TM.get(), 3, 0);
+    AddOptLevel(3, 0);
 
   if (FPasses) {
     FPasses->doInitialization();
@@ -999,6 +999,48 @@ TEST_F(MemorySSATest, RemovingDefInvalidatesCache) {
       << "(DefX1 = " << DefX1 << ")";
 }
 
+TEST_F(MemorySSATest, InsertingDefInvalidatesLocationCache) {
+  // Create:
+  //   %x = alloca i8
+  //   %y = alloca i8
+  //   ; 1 = MemoryDef(liveOnEntry)
+  //   store i8 0, i8* %x
+  //   ; 2 = MemoryDef(1)
+  //   store i8 0, i8* %y
+  //
+  // Query the clobber of %x above def `2`, which the walker caches, then insert
+  // a new store to %x between `1` and `2` and be sure the query sees it.
+  F = Function::Create(FunctionType::get(B.getVoidTy(), {}, false),
+                       GlobalValue::ExternalLinkage, "F", &M);
+  B.SetInsertPoint(BasicBlock::Create(C, "", F));
+  Value *X = B.CreateAlloca(B.getInt8Ty());
+  Value *Y = B.CreateAlloca(B.getInt8Ty());
+  StoreInst *StoreX = B.CreateStore(B.getInt8(0), X);
+  StoreInst *StoreY = B.CreateStore(B.getInt8(0), Y);
+
+  setupAnalyses();
+  MemorySSA &MSSA = *Analyses->MSSA;
+  MemorySSAWalker *Walker = Analyses->Walker;
+  MemorySSAUpdater Updater(&MSSA);
+
+  auto *DefX = cast<MemoryDef>(MSSA.getMemoryAccess(StoreX));
+  auto *DefY = cast<MemoryDef>(MSSA.getMemoryAccess(StoreY));
+  MemoryLocation XLoc = MemoryLocation::get(StoreX);
+
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(DefY, XLoc), DefX);
+  // Answered from the cache this time.
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(DefY, XLoc), DefX);
+
+  B.SetInsertPoint(StoreY);
+  StoreInst *NewStoreX = B.CreateStore(B.getInt8(1), X);
+  auto *NewDefX = cast<MemoryDef>(
+      Updater.createMemoryAccessBefore(NewStoreX, DefX, DefY));
+  Updater.insertDef(NewDefX);
+
+  EXPECT_EQ(DefY->getDefiningAccess(), NewDefX);
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(DefY, XLoc), NewDefX);
+}
+
 // Test Must alias for optimized uses
 TEST_F(MemorySSATest, TestLoadMustAlias) {
   F = Function::Create(FunctionType::get(B.getVoidTy(), {}, false),
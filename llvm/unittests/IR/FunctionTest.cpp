@@ -7,6 +7,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Module.h"
 #include "gtest/gtest.h"
 using namespace llvm;
@@ -154,4 +156,50 @@ TEST(FunctionTest, GetPointerAlignment) {
   EXPECT_EQ(4U, Func->getPointerAlignment(DataLayout("Fn32")));
 }
 
+TEST(FunctionTest, InstructionArena) {
+  LLVMContext C;
+  Module M("test", C);
+  Type *I32 = Type::getInt32Ty(C);
+  FunctionType *FTy = FunctionType::get(I32, {I32}, false);
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, "F", &M);
+  Function *G = Function::Create(FTy, GlobalValue::ExternalLinkage, "G", &M);
+  BasicBlock *GEntry = BasicBlock::Create(C, "entry", G);
+  IRBuilder<>(GEntry).CreateRet(G->arg_begin());
+
+  F->enableInstructionArena();
+  InstructionArena *Arena = F->getInstructionArena();
+  ASSERT_NE(nullptr, Arena);
+  Instruction *Moved;
+  {
+    InstructionArena::Scope ArenaScope(*F);
+    BasicBlock *Entry = BasicBlock::Create(C, "entry", F);
+    BasicBlock *Exit = BasicBlock::Create(C, "exit", F);
+    IRBuilder<> B(Entry);
+    Value *X = F->arg_begin();
+    Moved = cast<Instruction>(B.CreateAdd(X, X));
+    B.CreateBr(Exit);
+    B.SetInsertPoint(Exit);
+    // Growing the phi moves its operands to a new list in the arena.
+    PHINode *Phi = B.CreatePHI(I32, 1);
+    for (unsigned I = 0; I != 8; ++I)
+      Phi->addIncoming(X, Entry);
+    B.CreateRet(Phi);
+  }
+  EXPECT_NE(0u, Arena->getBytesAllocated());
+
+  // Instructions created outside the scope come from the heap.
+  Instruction *Extra = BinaryOperator::CreateMul(Moved, Moved);
+  Extra->deleteValue();
+
+  // An instruction moved out of the function keeps the arena alive after the
+  // function itself is deleted.
+  Moved->moveBefore(GEntry->getTerminator());
+  Moved->setOperand(0, G->arg_begin());
+  Moved->setOperand(1, G->arg_begin());
+  F->eraseFromParent();
+  EXPECT_EQ(Moved, &GEntry->front());
+  EXPECT_EQ(G->arg_begin(), Moved->getOperand(0));
+  Moved->eraseFromParent();
+}
+
 } // end namespace
@@ -0,0 +1,40 @@
+package main;
+
+var sink interface{}
+
+type Point struct {
+	X int
+	Y int
+}
+
+func describe(v interface{}) int {
+	if p, ok := v.(Point); ok {
+		return p.X + p.Y
+	}
+	return 0
+}
+
+func keep(v interface{}) {
+	sink = v
+}
+
+func boxLocal() int {
+	p := Point{1, 2}
+	return describe(p)
+}
+
+func boxEscape() {
+	p := Point{3, 4}
+	keep(p)
+}
+
+func boxGlobal() {
+	p := Point{5, 6}
+	sink = p
+}
+
+func main() {
+	println(boxLocal())
+	boxEscape()
+	boxGlobal()
+}
@@ -0,0 +1,48 @@
+package main;
+
+type Point struct {
+	X int
+	Y int
+}
+
+func apply(f func(int) int, x int) int {
+	return f(x)
+}
+
+func closureLocal() int {
+	a := &Point{1, 2}
+	add := func(x int) int {
+		return x + a.X
+	}
+	return add(3)
+}
+
+func closureEscape() func(int) int {
+	a := &Point{1, 2}
+	return func(x int) int {
+		return x + a.Y
+	}
+}
+
+func closureArg() int {
+	n := 4
+	return apply(func(x int) int {
+		return x * n
+	}, 5)
+}
+
+func closureGo(done chan int) {
+	a := &Point{1, 2}
+	go func() {
+		done <- a.X
+	}()
+}
+
+func main() {
+	println(closureLocal())
+	println(closureEscape()(1))
+	println(closureArg())
+	done := make(chan int)
+	closureGo(done)
+	println(<-done)
+}
@@ -0,0 +1,35 @@
+package main;
+
+var counts = map[string]int{"GET": 1, "PUT": 2}
+
+func lookup(b []byte) int {
+	return counts[string(b)]
+}
+
+func equal(b []byte) bool {
+	return string(b) == "GET"
+}
+
+func insert(b []byte) {
+	counts[string(b)] = 3
+}
+
+func firstByte(s string) byte {
+	b := []byte(s)
+	return b[0]
+}
+
+func mutate(s string) []byte {
+	b := []byte(s)
+	b[0] = 'x'
+	return b
+}
+
+func main() {
+	buf := []byte("GET")
+	println(lookup(buf))
+	println(equal(buf))
+	insert(buf)
+	println(firstByte("PUT"))
+	println(string(mutate("PUT")))
+}
@@ -0,0 +1,55 @@
+package main;
+
+type Mutex struct {
+	locked bool
+}
+
+func (m *Mutex) Lock() {
+	m.locked = true
+}
+
+func (m *Mutex) Unlock() {
+	m.locked = false
+}
+
+var mu Mutex
+
+func handler(n int) int {
+	mu.Lock()
+	defer mu.Unlock()
+	return n * 2
+}
+
+func deferLoop(n int) int {
+	sum := 0
+	for i := 0; i < n; i++ {
+		defer func(x int) {
+			sum += x
+		}(i)
+	}
+	return sum
+}
+
+type Error struct {
+	Msg string
+}
+
+func fail() {
+	panic(&Error{"failed"})
+}
+
+func recovered() (msg string) {
+	defer func() {
+		if r := recover(); r != nil {
+			msg = r.(*Error).Msg
+		}
+	}()
+	fail()
+	return ""
+}
+
+func main() {
+	println(handler(21))
+	println(deferLoop(3))
+	println(recovered())
+}
@@ -0,0 +1,40 @@
+package main;
+
+type Node struct {
+	Next *Node
+	X    int
+}
+
+type Point struct {
+	X, Y int
+}
+
+func pair() *Node {
+	a := &Node{X: 1}
+	b := &Node{X: 2}
+	a.Next = b
+	return a
+}
+
+func offset() *Point {
+	a := &Point{X: 1, Y: 2}
+	b := &Point{X: 3, Y: 4}
+	a.X += b.X
+	a.Y += b.Y
+	return a
+}
+
+var global *Point
+
+func separate() *Point {
+	a := &Point{X: 1}
+	b := &Point{X: 2}
+	global = b
+	return a
+}
+
+func main() {
+	println(pair().Next.X)
+	println(offset().X)
+	println(separate().X)
+}
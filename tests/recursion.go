@@ -0,0 +1,33 @@
+package main;
+
+type Point struct {
+	X int
+	Y int
+}
+
+type Big struct {
+	A [64]int
+}
+
+func depth(n int) int {
+	p := &Point{n, n}
+	if n == 0 {
+		return p.X
+	}
+	return depth(n - 1) + p.Y
+}
+
+func big() int {
+	a := &Big{}
+	b := &Big{}
+	for i := 0; i < 64; i++ {
+		a.A[i] = i
+		b.A[i] = a.A[i] * 2
+	}
+	return b.A[63]
+}
+
+func main() {
+	println(depth(10))
+	println(big())
+}
@@ -0,0 +1,44 @@
+package main;
+
+type T1 struct {
+	X, Y, Z int
+}
+
+func sliceLocal() int {
+	v := []T1{{X: 1, Z: 2}}
+	v[0].Y = 3
+	return v[0].X + v[0].Y
+}
+
+func sliceIndex(i int) int {
+	v := []int{1, 2, 3, 4}
+	v[i] = 5
+	return v[(i + 1) % 4] + len(v)
+}
+
+func sliceMake() int {
+	v := make([]int, 4, 8)
+	for i := range v {
+		v[i] = i
+	}
+	return v[3] + cap(v)
+}
+
+var global []int
+
+func sliceEscape() {
+	v := make([]int, 4)
+	global = v
+}
+
+func sliceReturn() []T1 {
+	return []T1{{X: 1}}
+}
+
+func main() {
+	println(sliceLocal())
+	println(sliceIndex(1))
+	println(sliceMake())
+	sliceEscape()
+	println(len(sliceReturn()))
+}